@@ -67,6 +67,11 @@ public:
 	  */
 	bool isHiddenStartup() const;
 
+	/** Exit after parsing the command line (don't start emulation),
+	  * e.g. because the option already did all its work while parsing.
+	  */
+	void exitAfterParsing() { parseStatus = EXIT; }
+
 private:
 	struct OptionData {
 		CLIOption* option;
@@ -42,6 +42,15 @@ GlobalSettings::GlobalSettings(GlobalCommandController& commandController_)
 			{"hq",   ResampledSoundDevice::RESAMPLE_HQ},
 			{"fast", ResampledSoundDevice::RESAMPLE_LQ},
 			{"blip", ResampledSoundDevice::RESAMPLE_BLIP}})
+	, reverseMemoryBudgetSetting(commandController, "reverse_memory_budget",
+		"maximum amount of memory (in MB) used per machine to store the reverse history",
+#if PLATFORM_DINGUX || PLATFORM_ANDROID
+		// these typically have little memory
+		32,
+#else
+		256,
+#endif
+		1, 1024 * 1024)
 	, throttleManager(commandController)
 {
 	deadzoneSettings = to_vector(
@@ -431,6 +431,12 @@ const byte* MSXDevice::getReadCacheLine(word /*start*/) const
 	return nullptr; // uncacheable
 }
 
+const byte* MSXDevice::getReadCacheLinePartial(
+	word start, std::bitset<CacheLine::SIZE>& /*exceptions*/) const
+{
+	return getReadCacheLine(start);
+}
+
 void MSXDevice::writeMem(word /*address*/, byte /*value*/,
                          EmuTime::param /*time*/)
 {
@@ -449,6 +455,11 @@ byte MSXDevice::peekMem(word address, EmuTime::param /*time*/) const
 	}
 }
 
+int MSXDevice::getMemorySegment(word /*address*/) const
+{
+	return -1;
+}
+
 void MSXDevice::globalWrite(word /*address*/, byte /*value*/,
                             EmuTime::param /*time*/)
 {
@@ -523,6 +534,16 @@ void MSXDevice::fillDeviceWCache(unsigned start, unsigned size, byte* wData)
 	clip(start, size, [&](auto... args) { getCPUInterface().fillWCache(args...); }, wData);
 }
 
+bool MSXDevice::switchDeviceRCache(unsigned start, unsigned size,
+                                   unsigned oldConfig, unsigned newConfig)
+{
+	bool result = true;
+	clip(start, size, [&](auto... args) {
+		result &= getCPUInterface().switchRCache(args...);
+	}, oldConfig, newConfig);
+	return result;
+}
+
 template<typename Archive>
 void MSXDevice::serialize(Archive& ar, unsigned /*version*/)
 {
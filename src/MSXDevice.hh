@@ -1,10 +1,12 @@
 #ifndef MSXDEVICE_HH
 #define MSXDEVICE_HH
 
+#include "CacheLine.hh"
 #include "DeviceConfig.hh"
 #include "EmuTime.hh"
 #include "openmsx.hh"
 #include "serialize_meta.hh"
+#include <bitset>
 #include <string>
 #include <vector>
 #include <utility> // for pair
@@ -159,6 +161,18 @@ public:
 	 */
 	virtual const byte* getReadCacheLine(word start) const;
 
+	/**
+	 * Used for lines where getReadCacheLine() returns a null pointer
+	 * because only some addresses in that line are not cacheable (e.g. a
+	 * register). Returns a buffer like getReadCacheLine(), and sets the
+	 * bits in 'exceptions' (the other bits must be left unchanged) of the
+	 * addresses that must still go via readMem(). The same cache
+	 * invalidation rules apply as for getReadCacheLine().
+	 * The default implementation returns getReadCacheLine(start).
+	 */
+	virtual const byte* getReadCacheLinePartial(
+		word start, std::bitset<CacheLine::SIZE>& exceptions) const;
+
 	/**
 	 * Test that the memory in the interval [start, start +
 	 * CacheLine::SIZE) is cacheable for writing. If it is, a pointer to a
@@ -186,6 +200,14 @@ public:
 	 */
 	virtual byte peekMem(word address, EmuTime::param time) const;
 
+	/**
+	 * The segment (ROM block or RAM segment) that is currently selected
+	 * at the given address, for devices with a mapper. Used by the
+	 * profiler to tell apart code at the same address in different
+	 * segments. The default implementation returns -1: no segments.
+	 */
+	[[nodiscard]] virtual int getMemorySegment(word address) const;
+
 	/** Global writes.
 	  * Some devices violate the MSX standard by ignoring the SLOT-SELECT
 	  * signal; they react to writes to a certain address in _any_ slot.
@@ -220,6 +242,14 @@ public:
 	void fillDeviceRCache (unsigned start, unsigned size, const byte* rData);
 	void fillDeviceWCache (unsigned start, unsigned size, byte* wData);
 
+	/** Calls MSXCPUInterface::switchRCache() for the specific (part of)
+	  * the slot that this device is located in. Returns false when (part
+	  * of) the lines could not be restored, then the caller must still
+	  * invalidate or fill that range.
+	  */
+	[[nodiscard]] bool switchDeviceRCache(unsigned start, unsigned size,
+	                                      unsigned oldConfig, unsigned newConfig);
+
 	/** Get the mother board this device belongs to
 	  */
 	MSXMotherBoard& getMotherBoard() const;
@@ -41,6 +41,7 @@
 #include "serialize.hh"
 #include "serialize_stl.hh"
 #include "ScopedAssign.hh"
+#include "sha1.hh"
 #include "ranges.hh"
 #include "stl.hh"
 #include "unreachable.hh"
@@ -1047,6 +1048,36 @@ void SettingObserver::update(const Setting& setting)
 
 
 // serialize
+template<typename T>
+static Sha1Sum hashSerialized(const char* tag, T& t)
+{
+	LastDeltaBlocks lastDeltaBlocks;
+	std::vector<std::shared_ptr<DeltaBlock>> deltaBlocks;
+	MemOutputArchive out(lastDeltaBlocks, deltaBlocks, false);
+	out.setInlineBlobs(); // hash all data, including large blocks
+	out.serialize(tag, t);
+	size_t size;
+	auto buf = out.releaseBuffer(size);
+	return SHA1::calc(buf.data(), size);
+}
+
+Sha1Sum MSXMotherBoard::getStateHash()
+{
+	return hashSerialized("machine", *this);
+}
+
+std::vector<std::pair<std::string, Sha1Sum>> MSXMotherBoard::getDeviceStateHashes()
+{
+	std::vector<std::pair<std::string, Sha1Sum>> result;
+	result.emplace_back("cpu", hashSerialized("cpu", getCPU()));
+	for (auto* device : availableDevices) {
+		// serialize via pointer, so that the actual device type is used
+		result.emplace_back(device->getName(), hashSerialized("device", device));
+	}
+	ranges::sort(result, [](auto& x, auto& y) { return x.first < y.first; });
+	return result;
+}
+
 // version 1: initial version
 // version 2: added reRecordCount
 // version 3: removed reRecordCount (moved to ReverseManager)
@@ -10,7 +10,9 @@
 #include "RecordedCommand.hh"
 #include <cassert>
 #include <memory>
+#include <string>
 #include <string_view>
+#include <utility>
 #include <vector>
 
 namespace openmsx {
@@ -54,6 +56,7 @@ class ResetCmd;
 class ReverseManager;
 class SettingObserver;
 class Scheduler;
+class Sha1Sum;
 class StateChangeDistributor;
 
 class MSXMotherBoard final
@@ -197,6 +200,17 @@ public:
 	std::string getUserName(const std::string& hwName);
 	void freeUserName(const std::string& hwName, const std::string& userName);
 
+	/** Hash of the complete (serialized) machine state. Machines that are
+	  * in the same state have the same hash. E.g. used to check that
+	  * replaying a replay gives the same result with different builds.
+	  */
+	Sha1Sum getStateHash();
+
+	/** Like getStateHash(), but one hash per MSXDevice (plus one for the
+	  * CPU), sorted on name. Tells which part of the state differs.
+	  */
+	std::vector<std::pair<std::string, Sha1Sum>> getDeviceStateHashes();
+
 	template<typename Archive>
 	void serialize(Archive& ar, unsigned version);
 
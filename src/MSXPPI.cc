@@ -27,10 +27,12 @@ MSXPPI::MSXPPI(const DeviceConfig& config)
 	, selectedRow(0)
 {
 	reset(getCurrentTime());
+	getCPUInterface().registerFastIO(*this);
 }
 
 MSXPPI::~MSXPPI()
 {
+	getCPUInterface().unregisterFastIO(*this);
 	powerDown(EmuTime::dummy());
 }
 
@@ -1,6 +1,15 @@
 #include "ReplayCLI.hh"
 #include "CommandLineParser.hh"
+#include "MSXException.hh"
+#include "MSXMotherBoard.hh"
+#include "Reactor.hh"
+#include "ReverseManager.hh"
 #include "TclObject.hh"
+#include "Timer.hh"
+#include "outer.hh"
+#include "sha1.hh"
+#include <cassert>
+#include <iostream>
 
 using std::string;
 
@@ -10,6 +19,7 @@ ReplayCLI::ReplayCLI(CommandLineParser& parser_)
 	: parser(parser_)
 {
 	parser.registerOption("-replay", *this);
+	parser.registerOption("-verifyreplay", verifyOption);
 	parser.registerFileType({"omr"}, *this);
 }
 
@@ -35,4 +45,44 @@ std::string_view ReplayCLI::fileTypeHelp() const
 	return "openMSX replay";
 }
 
+
+// class VerifyOption
+
+void ReplayCLI::VerifyOption::parseOption(
+	const string& option, span<string>& cmdLine)
+{
+	auto& parser = OUTER(ReplayCLI, verifyOption).parser;
+	string filename = getArgument(option, cmdLine);
+
+	// At this point the renderer is still 'none' (and it stays like that,
+	// see below) and fast forward mutes the sound. So the replay runs as
+	// fast as possible.
+	try {
+		auto start = Timer::getTime();
+		TclObject command = makeTclList("reverse", "loadreplay", "-viewonly", filename);
+		command.executeCommand(parser.getInterpreter());
+		auto* motherBoard = parser.getMotherBoard();
+		assert(motherBoard);
+		motherBoard->getReverseManager().fastForwardToEnd();
+		auto hash = motherBoard->getStateHash();
+		double emuTime = (motherBoard->getCurrentTime() - EmuTime::zero()).toDouble();
+		double realTime = (Timer::getTime() - start) / 1000000.0;
+
+		std::cout << hash.toString() << "  " << filename
+		          << "  (" << emuTime << "s in " << realTime << "s)\n";
+	} catch (MSXException& e) {
+		// Report and continue with the other replays (if any).
+		std::cout << "ERROR  " << filename << "  (" << e.getMessage() << ")\n";
+		exitCode = 1;
+	}
+
+	// Several replays can be verified at once, but don't start emulation.
+	parser.exitAfterParsing();
+}
+
+std::string_view ReplayCLI::VerifyOption::optionHelp() const
+{
+	return "Run replay till its end without video and sound, print a hash of the final machine state and exit";
+}
+
 } // namespace openmsx
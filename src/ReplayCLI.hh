@@ -20,6 +20,12 @@ public:
 
 private:
 	CommandLineParser& parser;
+
+	struct VerifyOption final : CLIOption {
+		void parseOption(const std::string& option,
+		                 span<std::string>& cmdLine) override;
+		std::string_view optionHelp() const override;
+	} verifyOption;
 };
 
 } // namespace openmsx
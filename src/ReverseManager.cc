@@ -4,6 +4,7 @@
 #include "StateChangeDistributor.hh"
 #include "Keyboard.hh"
 #include "Debugger.hh"
+#include "MSXCPU.hh"
 #include "EventDelay.hh"
 #include "MSXMixer.hh"
 #include "MSXCommandController.hh"
@@ -17,12 +18,14 @@
 #include "CliComm.hh"
 #include "Display.hh"
 #include "Reactor.hh"
+#include "GlobalSettings.hh"
 #include "CommandException.hh"
 #include "MemBuffer.hh"
 #include "ranges.hh"
 #include "serialize.hh"
 #include "serialize_meta.hh"
 #include "view.hh"
+#include <algorithm>
 #include <cassert>
 #include <cmath>
 #include <iomanip>
@@ -37,6 +40,12 @@ namespace openmsx {
 // Time between two snapshots (in seconds)
 constexpr double SNAPSHOT_PERIOD = 1.0;
 
+// When fewer snapshots than this fit in the memory budget, take them less
+// often (but at least every MAX_SNAPSHOT_PERIOD seconds). Otherwise most of
+// them would be dropped again soon after they were taken.
+constexpr double MIN_SNAPSHOTS_IN_BUDGET = 100.0;
+constexpr double MAX_SNAPSHOT_PERIOD = 10.0;
+
 // Max number of snapshots in a replay file
 constexpr unsigned MAX_NOF_SNAPSHOTS = 10;
 
@@ -54,6 +63,12 @@ constexpr const char* const REPLAY_DIR = "replays";
 // (the initial state), but can have optionally more motherboards, which are
 // merely in-between snapshots, so it is quicker to jump to a later time in the
 // event log.
+//
+// Since version 5 the times of all snapshots are stored up front. On load
+// the snapshots themselves are not yet deserialized (that is by far the most
+// expensive part of loading a replay), only the snapshot that's needed to
+// go to the requested time is. The others are deserialized when a later
+// 'reverse goto' needs them.
 
 struct Replay
 {
@@ -63,18 +78,50 @@ struct Replay
 	Reactor& reactor;
 
 	ReverseManager::Events* events;
-	std::vector<Reactor::Board> motherBoards;
+	std::vector<Reactor::Board> motherBoards; // saving, or loading version < 5
+	std::vector<EmuTime> snapshotTimes;     // version >= 5
+	std::vector<XMLElement> lazySnapshots;  // loading version >= 5
 	EmuTime currentTime;
 	// this is the amount of times the reverse goto command was used, which
 	// is interesting for the TAS community (see tasvideos.org). It's an
 	// indication of the effort it took to create the replay. Note that
 	// there is no way to verify this number.
-	unsigned reRecordCount;
+	unsigned reRecordCount = 0;
+
+	void serializeSnapshots(XmlOutputArchive& ar)
+	{
+		unsigned num = unsigned(motherBoards.size());
+		ar.serialize("numSnapshots", num);
+		for (auto& m : motherBoards) {
+			snapshotTimes.push_back(m->getCurrentTime());
+			ar.serialize("snapshotTime", snapshotTimes.back());
+		}
+		for (auto& m : motherBoards) {
+			ar.serialize("snapshot", *m);
+		}
+	}
+	void serializeSnapshots(XmlInputArchive& ar)
+	{
+		unsigned num = 0;
+		ar.serialize("numSnapshots", num);
+		for (unsigned i = 0; i < num; ++i) {
+			snapshotTimes.push_back(EmuTime::zero());
+			ar.serialize("snapshotTime", snapshotTimes.back());
+		}
+		for (unsigned i = 0; i < num; ++i) {
+			// wrap in a root element, see ReverseManager::decodeSnapshot()
+			XMLElement root;
+			root.addChild("snapshot") = ar.takeElement("snapshot");
+			lazySnapshots.push_back(move(root));
+		}
+	}
 
 	template<typename Archive>
 	void serialize(Archive& ar, unsigned version)
 	{
-		if (ar.versionAtLeast(version, 2)) {
+		if (ar.versionAtLeast(version, 5)) {
+			serializeSnapshots(ar);
+		} else if (ar.versionAtLeast(version, 2)) {
 			ar.serializeWithID("snapshots", motherBoards, std::ref(reactor));
 		} else {
 			Reactor::Board newBoard = reactor.createEmptyMotherBoard();
@@ -97,7 +144,7 @@ struct Replay
 		}
 	}
 };
-SERIALIZE_CLASS_VERSION(Replay, 4);
+SERIALIZE_CLASS_VERSION(Replay, 5);
 
 
 // struct ReverseHistory
@@ -106,6 +153,8 @@ void ReverseManager::ReverseHistory::swap(ReverseHistory& other)
 {
 	std::swap(chunks, other.chunks);
 	std::swap(events, other.events);
+	// The blocks in 'chunks' are accounted in 'lastDeltaBlocks'.
+	std::swap(lastDeltaBlocks, other.lastDeltaBlocks);
 }
 
 void ReverseManager::ReverseHistory::clear()
@@ -137,6 +186,7 @@ REGISTER_POLYMORPHIC_CLASS(StateChange, EndLogEvent, "EndLog");
 ReverseManager::ReverseManager(MSXMotherBoard& motherBoard_)
 	: syncNewSnapshot(motherBoard_.getScheduler())
 	, syncInputEvent (motherBoard_.getScheduler())
+	, syncHashLog    (motherBoard_.getScheduler())
 	, motherBoard(motherBoard_)
 	, eventDistributor(motherBoard.getReactor().getEventDistributor())
 	, reverseCmd(motherBoard.getCommandController())
@@ -146,6 +196,7 @@ ReverseManager::ReverseManager(MSXMotherBoard& motherBoard_)
 	, collecting(false)
 	, pendingTakeSnapshot(false)
 	, reRecordCount(0)
+	, avgSnapshotSize(0.0)
 {
 	eventDistributor.registerEventListener(OPENMSX_TAKE_REVERSE_SNAPSHOT, *this);
 
@@ -230,6 +281,9 @@ void ReverseManager::status(TclObject& result) const
 	}));
 	result.addDictKeyValue("snapshots", snapshots);
 
+	// in bytes (as a double, it can be larger than 4GB)
+	result.addDictKeyValue("memory", double(history.getMemoryUsage()));
+
 	auto lastEvent = rbegin(history.events);
 	if (lastEvent != rend(history.events) && dynamic_cast<const EndLogEvent*>(lastEvent->get())) {
 		++lastEvent;
@@ -309,6 +363,142 @@ void ReverseManager::goTo(EmuTime::param target, bool novideo)
 	goTo(target, novideo, history, true); // move in current time-line
 }
 
+void ReverseManager::startHashLog(Interpreter& interp, span<const TclObject> tokens)
+{
+	double interval = 1.0;
+	ArgsInfo info[] = { valueArg("-interval", interval) };
+	auto args = parseTclArgs(interp, tokens.subspan(3), info);
+	if (args.size() != 1) throw SyntaxError();
+	if (interval <= 0.0) {
+		throw CommandException("Interval must be positive.");
+	}
+
+	stopHashLog();
+	stateHashLog = std::make_unique<StateHashLog>(string(args[0].getString()));
+	hashLogInterval = EmuDuration(interval);
+	// Take the hashes at multiples of the interval. So logs that were
+	// started at a different moment can still be compared.
+	auto step = hashLogInterval.length();
+	auto now = (getCurrentTime() - EmuTime::zero()).length();
+	syncHashLog.setSyncPoint(EmuTime::makeEmuTime((now / step + 1) * step));
+}
+
+void ReverseManager::stopHashLog()
+{
+	syncHashLog.removeSyncPoint();
+	stateHashLog.reset();
+}
+
+static void reportDivergence(
+	TclObject& result, const StateHashLog::Entry& entry1,
+	const StateHashLog::Entry& entry2, const StateHashLog::Entry* lastEqual)
+{
+	result.addDictKeyValue("time", (entry1.time - EmuTime::zero()).toDouble());
+	if (lastEqual) {
+		result.addDictKeyValue("last_equal", (lastEqual->time - EmuTime::zero()).toDouble());
+	}
+	// Empty when only state outside the devices (e.g. the scheduler or
+	// the slot layout) differs.
+	TclObject devices;
+	devices.addListElements(StateHashLog::differentDevices(entry1, entry2));
+	result.addDictKeyValue("devices", devices);
+}
+
+static void compareHashLogs(span<const TclObject> tokens, TclObject& result)
+{
+	if (tokens.size() != 5) throw SyntaxError();
+	auto log1 = StateHashLog::read(string(tokens[3].getString()));
+	auto log2 = StateHashLog::read(string(tokens[4].getString()));
+	auto i = StateHashLog::firstDifference(log1, log2);
+	if (i == std::min(log1.size(), log2.size())) return; // no difference
+	reportDivergence(result, log1[i], log2[i], i ? &log1[i - 1] : nullptr);
+}
+
+// Note: going to another moment in time switches to a new MSXMotherBoard
+// (and ReverseManager), see goTo(). That's why this is a static method.
+void ReverseManager::bisectHashLog(
+	MSXMotherBoard& motherBoard, span<const TclObject> tokens, TclObject& result)
+{
+	if (tokens.size() != 4) throw SyntaxError();
+	auto& reactor = motherBoard.getReactor();
+	if (&motherBoard != reactor.getMotherBoard()) {
+		throw CommandException("Only possible for the active machine.");
+	}
+	auto& manager = motherBoard.getReverseManager();
+	if (!manager.isCollecting()) {
+		throw CommandException("Reverse was not enabled, first load a replay.");
+	}
+	if (manager.stateHashLog) {
+		throw CommandException("Stop the running hash log first.");
+	}
+	auto log = StateHashLog::read(string(tokens[3].getString()));
+
+	// Only the part of the log that's covered by the reverse history can
+	// be checked.
+	EmuTime begin = std::begin(manager.history.chunks)->second.time;
+	EmuTime end = manager.getEndTime(manager.history);
+	EmuTime currentTime = manager.getCurrentTime();
+	auto byTime = [](EmuTime::param t, const StateHashLog::Entry& e) { return t < e.time; };
+	auto first = ranges::upper_bound(log, begin, byTime);
+	auto last  = ranges::upper_bound(log, end,   byTime);
+	if (first == last) {
+		throw CommandException("The log doesn't overlap with the replay.");
+	}
+
+	// Assuming that once the state diverged it stays different, binary
+	// search the first entry that differs. Each probe only emulates from
+	// the nearest snapshot, not from the start of the replay.
+	auto lo = first;
+	auto hi = last;
+	std::optional<StateHashLog::Entry> diverged; // state at 'hi'
+	while (lo != hi) {
+		auto mid = lo + (hi - lo) / 2;
+		auto entry = probeHash(reactor, mid->time);
+		if (entry.machine == mid->machine) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+			diverged = std::move(entry);
+		}
+	}
+
+	// back to where we were
+	reactor.getMotherBoard()->getReverseManager().goTo(currentTime, false);
+
+	if (!diverged) return; // no difference
+	reportDivergence(result, *hi, *diverged, (hi != first) ? &*(hi - 1) : nullptr);
+}
+
+StateHashLog::Entry ReverseManager::probeHash(Reactor& reactor, EmuTime::param time)
+{
+	// Go to (slightly) before the requested time and let the hash be taken
+	// by the same sync point as when the log was written.
+	auto lead = EmuDuration::msec(1);
+	EmuTime target = ((time - EmuTime::zero()) > lead) ? time - lead : EmuTime::zero();
+	reactor.getMotherBoard()->getReverseManager().goTo(target, true);
+	auto* board = reactor.getMotherBoard();
+	auto& manager = board->getReverseManager();
+	manager.hashProbe.reset();
+	manager.syncHashLog.setSyncPoint(time);
+	board->fastForward(time, true);
+	if (!manager.hashProbe) {
+		manager.syncHashLog.removeSyncPoint();
+		throw CommandException("Couldn't take hash at time ",
+		                       (time - EmuTime::zero()).toDouble());
+	}
+	auto result = std::move(*manager.hashProbe);
+	manager.hashProbe.reset();
+	return result;
+}
+
+void ReverseManager::fastForwardToEnd()
+{
+	if (!isReplaying()) return;
+	syncNewSnapshot.removeSyncPoint(); // don't take snapshots on the way
+	motherBoard.fastForward(getEndTime(history), true);
+	schedule(getCurrentTime());
+}
+
 // this function is used below, but factored out, because it's already way too long
 static void reportProgress(Reactor& reactor, const EmuTime& targetTime, int percentage)
 {
@@ -358,14 +548,21 @@ void ReverseManager::goTo(
 		                  ? targetTime - preDelta
 		                  : firstTime;
 
-		// find oldest snapshot that is not newer than requested time
-		// TODO ATM we do a linear search, could be improved to do a binary search.
+		// find newest snapshot that is not newer than requested time
+		// The sequence numbers are (rounded) times, so start searching at
+		// the sequence number of the requested time. Usually at most one
+		// step is needed from there.
 		assert(it->second.time <= preTarget); // first one is not newer
 		assert(it != end(hist.chunks)); // there are snapshots
-		do {
+		it = hist.chunks.upper_bound(hist.getNextSeqNum(preTarget));
+		while ((it != begin(hist.chunks)) &&
+		       (std::prev(it)->second.time > preTarget)) {
+			--it;
+		}
+		while ((it != end(hist.chunks)) &&
+		       (it->second.time <= preTarget)) {
 			++it;
-		} while (it != end(hist.chunks) &&
-			 it->second.time <= preTarget);
+		}
 		// We found the first one that's newer, previous one is last
 		// one that's not newer (thus older or equal).
 		assert(it != begin(hist.chunks));
@@ -394,6 +591,7 @@ void ReverseManager::goTo(
 		} else {
 			// Note: we don't (anymore) erase future snapshots
 			// -- restore old snapshot --
+			decodeSnapshot(hist, chunk);
 			newBoard_ = reactor.createEmptyMotherBoard();
 			newBoard = newBoard_.get();
 			MemInputArchive in(chunk.savestate.data(),
@@ -459,7 +657,17 @@ void ReverseManager::goTo(
 			}
 			// note: fastForward does not always stop at
 			//       _exactly_ the requested time
-			if (currentTimeNewBoard >= preTarget) break;
+			if (currentTimeNewBoard >= preTarget) {
+				// Seeks are typically repeated in the same region
+				// (scrubbing along the timeline), so also keep a
+				// snapshot at the destination. A later seek nearby
+				// then only needs a short fast forward.
+				if ((currentTimeNewBoard - lastSnapshotTarget) >=
+				    EmuDuration(SNAPSHOT_PERIOD)) {
+					newBoard->getReverseManager().takeSnapshot(currentTimeNewBoard);
+				}
+				break;
+			}
 			if (currentTimeNewBoard >= nextSnapshotTarget) {
 				// NOTE: there used to be
 				//newBoard->getReactor().getEventDistributor().deliverEvents();
@@ -518,9 +726,15 @@ void ReverseManager::transferState(MSXMotherBoard& newBoard)
 	// transfer watchpoints
 	newBoard.getDebugger().transfer(motherBoard.getDebugger());
 
+	// continue the profile (if any) in the new machine
+	newBoard.getCPU().getProfiler().transfer(motherBoard.getCPU().getProfiler());
+
 	// copy rerecord count
 	newManager.reRecordCount = reRecordCount;
 
+	// the new board doesn't have a snapshot yet to measure this
+	newManager.avgSnapshotSize = avgSnapshotSize;
+
 	// transfer settings
 	const auto& oldController = motherBoard.getMSXCommandController();
 	newBoard.getMSXCommandController().transferSettings(oldController);
@@ -529,7 +743,7 @@ void ReverseManager::transferState(MSXMotherBoard& newBoard)
 void ReverseManager::saveReplay(
 	Interpreter& interp, span<const TclObject> tokens, TclObject& result)
 {
-	const auto& chunks = history.chunks;
+	auto& chunks = history.chunks;
 	if (chunks.empty()) {
 		throw CommandException("No recording...");
 	}
@@ -559,6 +773,7 @@ void ReverseManager::saveReplay(
 	replay.currentTime = getCurrentTime();
 
 	// restore first snapshot to be able to serialize it to a file
+	decodeSnapshot(history, begin(chunks)->second);
 	auto initialBoard = reactor.createEmptyMotherBoard();
 	MemInputArchive in(begin(chunks)->second.savestate.data(),
 	                   begin(chunks)->second.size,
@@ -588,6 +803,7 @@ void ReverseManager::saveReplay(
 				assert(it->second.time <= nextPartitionEnd);
 				if (it != lastAddedIt) {
 					// this is a new one, add it to the list of snapshots
+					decodeSnapshot(history, it->second);
 					Reactor::Board board = reactor.createEmptyMotherBoard();
 					MemInputArchive in2(it->second.savestate.data(),
 							    it->second.size,
@@ -699,16 +915,19 @@ void ReverseManager::loadReplay(
 	// now we can change the view only mode
 	motherBoard.getStateChangeDistributor().setViewOnlyMode(enableViewOnly);
 
-	assert(!replay.motherBoards.empty());
-	auto& newReverseManager = replay.motherBoards[0]->getReverseManager();
-	auto& newHistory = newReverseManager.history;
-
-	if (newReverseManager.reRecordCount == 0) {
-		// serialize Replay version >= 4
-		newReverseManager.reRecordCount = replay.reRecordCount;
-	} else {
-		// newReverseManager.reRecordCount is initialized via
-		// call from MSXMotherBoard to setReRecordCount()
+	if (replay.motherBoards.empty() && replay.snapshotTimes.empty()) {
+		throw CommandException("Cannot load replay: it contains no snapshots");
+	}
+	ReverseHistory newHistory;
+
+	unsigned newReRecordCount = replay.reRecordCount; // Replay version >= 4
+	if (!replay.motherBoards.empty()) {
+		auto& newReverseManager = replay.motherBoards[0]->getReverseManager();
+		if (newReverseManager.reRecordCount != 0) {
+			// newReverseManager.reRecordCount is initialized via
+			// call from MSXMotherBoard to setReRecordCount()
+			newReRecordCount = newReverseManager.reRecordCount;
+		}
 	}
 
 	// Restore event log
@@ -717,15 +936,7 @@ void ReverseManager::loadReplay(
 
 	// Restore snapshots
 	unsigned replayIdx = 0;
-	for (auto& m : replay.motherBoards) {
-		ReverseChunk newChunk;
-		newChunk.time = m->getCurrentTime();
-
-		MemOutputArchive out(newHistory.lastDeltaBlocks,
-		                     newChunk.deltaBlocks, false);
-		out.serialize("machine", *m);
-		newChunk.savestate = out.releaseBuffer(newChunk.size);
-
+	auto addChunk = [&](ReverseChunk&& newChunk) {
 		// update replayIdx
 		// TODO: should we use <= instead??
 		while (replayIdx < newEvents.size() &&
@@ -736,17 +947,56 @@ void ReverseManager::loadReplay(
 
 		newHistory.chunks[newHistory.getNextSeqNum(newChunk.time)] =
 			move(newChunk);
+	};
+	for (auto& m : replay.motherBoards) {
+		ReverseChunk newChunk;
+		newChunk.time = m->getCurrentTime();
+
+		MemOutputArchive out(newHistory.lastDeltaBlocks,
+		                     newChunk.deltaBlocks, false);
+		out.serialize("machine", *m);
+		newChunk.savestate = out.releaseBuffer(newChunk.size);
+		addChunk(move(newChunk));
+	}
+	assert(replay.lazySnapshots.size() == replay.snapshotTimes.size());
+	for (size_t i = 0; i < replay.snapshotTimes.size(); ++i) {
+		ReverseChunk newChunk;
+		newChunk.time = replay.snapshotTimes[i];
+		newChunk.size = 0;
+		newChunk.lazySnapshot = move(replay.lazySnapshots[i]);
+		addChunk(move(newChunk));
 	}
 
 	// Note: untill this point we didn't make any changes to the current
 	// ReverseManager/MSXMotherBoard yet
-	reRecordCount = newReverseManager.reRecordCount;
+	reRecordCount = newReRecordCount;
 	bool novideo = false;
 	goTo(destination, novideo, newHistory, false); // move to different time-line
 
 	result = "Loaded replay from " + filename;
 }
 
+void ReverseManager::decodeSnapshot(ReverseHistory& hist, ReverseChunk& chunk)
+{
+	if (!chunk.lazySnapshot) return;
+
+	// xml -> MSXMotherBoard -> in-memory snapshot (the same format as for
+	// snapshots that were taken during emulation)
+	auto board = motherBoard.getReactor().createEmptyMotherBoard();
+	try {
+		XmlInputArchive in(move(*chunk.lazySnapshot));
+		in.serialize("snapshot", *board);
+	} catch (XMLException& e) {
+		throw CommandException("Cannot load snapshot from replay, bad file format: ",
+		                       e.getMessage());
+	}
+	chunk.lazySnapshot.reset();
+	chunk.deltaBlocks.clear();
+	MemOutputArchive out(hist.lastDeltaBlocks, chunk.deltaBlocks, false);
+	out.serialize("machine", *board);
+	chunk.savestate = out.releaseBuffer(chunk.size);
+}
+
 void ReverseManager::transferHistory(ReverseHistory& oldHistory,
                                      unsigned oldEventCount)
 {
@@ -822,6 +1072,27 @@ void ReverseManager::execInputEvent()
 	}
 }
 
+void ReverseManager::execHashLog(EmuTime::param time)
+{
+	// Unlike snapshots, hashes are taken at exactly the requested time,
+	// possibly in the middle of a CPU instruction. The (serialized) state
+	// can't be resumed from there, but it is deterministic, that's all
+	// that's needed to compare it.
+	auto entry = StateHashLog::calc(motherBoard, time);
+	if (!stateHashLog) {
+		hashProbe = std::move(entry); // see probeHash()
+		return;
+	}
+	try {
+		stateHashLog->write(entry);
+		syncHashLog.setSyncPoint(time + hashLogInterval);
+	} catch (MSXException& e) {
+		stateHashLog.reset();
+		motherBoard.getMSXCliComm().printWarning(
+			"Stopped logging state hashes: ", e.getMessage());
+	}
+}
+
 int ReverseManager::signalEvent(const shared_ptr<const Event>& event)
 {
 	(void)event;
@@ -838,6 +1109,17 @@ int ReverseManager::signalEvent(const shared_ptr<const Event>& event)
 	return 0;
 }
 
+size_t ReverseManager::ReverseHistory::getMemoryUsage() const
+{
+	// Snapshots that are not yet decoded (see decodeSnapshot()) are not
+	// included, those only take a small fraction of this.
+	size_t result = lastDeltaBlocks.getTotalAllocSize();
+	for (const auto& [idx, chunk] : chunks) {
+		result += chunk.size;
+	}
+	return result;
+}
+
 unsigned ReverseManager::ReverseHistory::getNextSeqNum(EmuTime::param time) const
 {
 	if (chunks.empty()) {
@@ -850,11 +1132,7 @@ unsigned ReverseManager::ReverseHistory::getNextSeqNum(EmuTime::param time) cons
 
 void ReverseManager::takeSnapshot(EmuTime::param time)
 {
-	// (possibly) drop old snapshots
-	// TODO does snapshot pruning still happen correctly (often enough)
-	//      when going back/forward in time?
 	unsigned seqNum = history.getNextSeqNum(time);
-	dropOldSnapshots<25>(seqNum);
 
 	// During replay we might already have a snapshot with the current
 	// sequence number, though this snapshot does not necessarily have the
@@ -863,12 +1141,31 @@ void ReverseManager::takeSnapshot(EmuTime::param time)
 
 	// actually create new snapshot
 	ReverseChunk& newChunk = history.chunks[seqNum];
-	newChunk.deltaBlocks.clear();
+	newChunk.deltaBlocks.clear(); // of a replaced snapshot
+	bool allBlocksInFull = history.lastDeltaBlocks.empty();
+	size_t oldBlocksSize = history.lastDeltaBlocks.getTotalAllocSize();
 	MemOutputArchive out(history.lastDeltaBlocks, newChunk.deltaBlocks, true);
 	out.serialize("machine", motherBoard);
 	newChunk.time = time;
 	newChunk.savestate = out.releaseBuffer(newChunk.size);
 	newChunk.eventCount = replayIndex;
+
+	// Most snapshots only add a small delta, but every now and then a
+	// block is stored in full. So use an average. Only count what this
+	// snapshot added: not what a replaced snapshot used. This can be
+	// negative, when older blocks got compressed. The first snapshot
+	// (e.g. after a reverse goto) stores all blocks in full, that's not
+	// representative.
+	if (!allBlocksInFull) {
+		double size = double(newChunk.size) + double(ptrdiff_t(
+			history.lastDeltaBlocks.getTotalAllocSize() - oldBlocksSize));
+		if (avgSnapshotSize == 0.0) {
+			avgSnapshotSize = std::max(size, 0.0);
+		} else {
+			avgSnapshotSize += (size - avgSnapshotSize) / 16.0;
+		}
+	}
+	dropOldSnapshots(time, seqNum);
 }
 
 void ReverseManager::replayNextEvent()
@@ -923,35 +1220,65 @@ void ReverseManager::stopReplay(EmuTime::param time)
 }
 
 /* Should be called each time a new snapshot is added.
- * This function will erase zero or more earlier snapshots so that there are
- * more snapshots of recent history and less of distant history. It has the
- * following properties:
- *  - the very oldest snapshot is never deleted
- *  - it keeps the N or N+1 most recent snapshots (snapshot distance = 1)
- *  - then it keeps N or N+1 with snapshot distance 2
- *  - then N or N+1 with snapshot distance 4
- *  - ... and so on
- * @param count The index of the just added (or about to be added) element.
- *              First element should have index 1.
+ * This function will erase zero or more snapshots so that the reverse history
+ * fits in the memory budget again. It drops the snapshot that leaves the
+ * smallest gap relative to its distance to the current time. So the distance
+ * between snapshots grows with their age (or, while replaying, with how far
+ * they are in the future), but how many snapshots are kept depends on how
+ * much memory they actually use.
+ * It never drops the first snapshot (needed to save a replay), the last one,
+ * the just added one or ones that are not yet decoded (those hardly take any
+ * memory).
+ * @param time The current time.
+ * @param keepSeqNum The sequence number of the just added snapshot.
  */
-template<unsigned N>
-void ReverseManager::dropOldSnapshots(unsigned count)
+void ReverseManager::dropOldSnapshots(EmuTime::param time, unsigned keepSeqNum)
+{
+	auto& chunks = history.chunks;
+	size_t budget = getMemoryBudget();
+	size_t usage = history.getMemoryUsage();
+	double now = (time - EmuTime::zero()).toDouble();
+	while ((usage > budget) && (chunks.size() > 2)) {
+		auto victim = end(chunks);
+		double victimValue = 0.0;
+		for (auto it = std::next(begin(chunks)); it != std::prev(end(chunks)); ++it) {
+			const auto& [seqNum, chunk] = *it;
+			if ((seqNum == keepSeqNum) || chunk.lazySnapshot) continue;
+			double gap = (std::next(it)->second.time -
+			              std::prev(it)->second.time).toDouble();
+			double distance = std::abs((chunk.time - EmuTime::zero()).toDouble() - now);
+			double value = gap / std::max(distance, SNAPSHOT_PERIOD);
+			if ((victim == end(chunks)) || (value < victimValue)) {
+				victim = it;
+				victimValue = value;
+			}
+		}
+		if (victim == end(chunks)) break;
+		chunks.erase(victim); // also frees delta blocks that are no longer used
+		usage = history.getMemoryUsage();
+	}
+}
+
+size_t ReverseManager::getMemoryBudget() const
 {
-	unsigned y = (count + N) ^ (count + N + 1);
-	unsigned d = N;
-	unsigned d2 = 2 * N + 1;
-	while (true) {
-		y >>= 1;
-		if ((y == 0) || (count < d)) return;
-		history.chunks.erase(count - d);
-		d += d2;
-		d2 *= 2;
+	auto& setting = motherBoard.getReactor().getGlobalSettings().getReverseMemoryBudgetSetting();
+	return size_t(setting.getInt()) * 1024 * 1024;
+}
+
+EmuDuration ReverseManager::getSnapshotPeriod() const
+{
+	double period = SNAPSHOT_PERIOD;
+	if (avgSnapshotSize > 0.0) {
+		double fit = double(getMemoryBudget()) / avgSnapshotSize;
+		period *= std::clamp(MIN_SNAPSHOTS_IN_BUDGET / fit,
+		                     1.0, MAX_SNAPSHOT_PERIOD / SNAPSHOT_PERIOD);
 	}
+	return EmuDuration(period);
 }
 
 void ReverseManager::schedule(EmuTime::param time)
 {
-	syncNewSnapshot.setSyncPoint(time + EmuDuration(SNAPSHOT_PERIOD));
+	syncNewSnapshot.setSyncPoint(time + getSnapshotPeriod());
 }
 
 
@@ -976,6 +1303,14 @@ void ReverseManager::ReverseCmd::execute(span<const TclObject> tokens, TclObject
 		"goto",       [&]{ manager.goTo(tokens); },
 		"savereplay", [&]{ manager.saveReplay(interp, tokens, result); },
 		"loadreplay", [&]{ manager.loadReplay(interp, tokens, result); },
+		"hashlog",    [&]{
+			checkNumArgs(tokens, AtLeast{3}, "subcommand ?arg ...?");
+			executeSubCommand(tokens[2].getString(),
+				"start",   [&]{ manager.startHashLog(interp, tokens); },
+				"stop",    [&]{ manager.stopHashLog(); },
+				"compare", [&]{ compareHashLogs(tokens, result); },
+				"bisect",  [&]{ bisectHashLog(manager.motherBoard, tokens, result); });
+			},
 		"viewonlymode", [&]{
 			auto& distributor = manager.motherBoard.getStateChangeDistributor();
 			switch (tokens.size()) {
@@ -1004,7 +1339,11 @@ string ReverseManager::ReverseCmd::help(const vector<string>& /*tokens*/) const
 	       "viewonlymode <bool> switch viewonly mode on or off\n"
 	       "truncatereplay      stop replaying and remove all 'future' data\n"
 	       "savereplay [<name>] save the first snapshot and all replay data as a 'replay' (with optional name)\n"
-	       "loadreplay [-goto <begin|end|savetime|<n>>] [-viewonly] <name>   load a replay (snapshot and replay data) with given name and start replaying\n";
+	       "loadreplay [-goto <begin|end|savetime|<n>>] [-viewonly] <name>   load a replay (snapshot and replay data) with given name and start replaying\n"
+	       "hashlog start [-interval <n>] <file>   write a hash of the machine state every <n> (default 1) seconds to file\n"
+	       "hashlog stop        stop writing state hashes\n"
+	       "hashlog compare <file1> <file2>   find the first moment where two hash logs differ and which devices differ\n"
+	       "hashlog bisect <file>   find the first moment where the current replay differs from a hash log\n";
 }
 
 void ReverseManager::ReverseCmd::tabCompletion(vector<string>& tokens) const
@@ -1013,9 +1352,18 @@ void ReverseManager::ReverseCmd::tabCompletion(vector<string>& tokens) const
 		static constexpr const char* const subCommands[] = {
 			"start", "stop", "status", "goback", "goto",
 			"savereplay", "loadreplay", "viewonlymode",
-			"truncatereplay",
+			"truncatereplay", "hashlog",
 		};
 		completeString(tokens, subCommands);
+	} else if (tokens[1] == "hashlog") {
+		if (tokens.size() == 3) {
+			static constexpr const char* const hashLogCommands[] = {
+				"start", "stop", "compare", "bisect",
+			};
+			completeString(tokens, hashLogCommands);
+		} else {
+			completeFileName(tokens, userFileContext());
+		}
 	} else if ((tokens.size() == 3) || (tokens[1] == "loadreplay")) {
 		if (tokens[1] == "loadreplay" || tokens[1] == "savereplay") {
 			std::vector<const char*> cmds;
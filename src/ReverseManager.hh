@@ -8,11 +8,14 @@
 #include "EmuTime.hh"
 #include "MemBuffer.hh"
 #include "DeltaBlock.hh"
+#include "StateHashLog.hh"
+#include "XMLElement.hh"
 #include "span.hh"
 #include "outer.hh"
 #include <vector>
 #include <map>
 #include <memory>
+#include <optional>
 #include <cstdint>
 
 namespace openmsx {
@@ -23,6 +26,7 @@ class EventDelay;
 class EventDistributor;
 class TclObject;
 class Interpreter;
+class Reactor;
 
 class ReverseManager final : private EventListener, private StateChangeRecorder
 {
@@ -50,6 +54,12 @@ public:
 		reRecordCount = count;
 	}
 
+	/** Run till the end of the replay that's being replayed, as fast as
+	  * possible and without taking new snapshots. Used to verify replays
+	  * from the command line (see ReplayCLI).
+	  */
+	void fastForwardToEnd();
+
 private:
 	struct ReverseChunk {
 		ReverseChunk() : time(EmuTime::zero()) {}
@@ -63,6 +73,11 @@ private:
 		// snapshot was created. So when going back replay should
 		// start at this index.
 		unsigned eventCount;
+
+		// Snapshots loaded from a replay file are only deserialized
+		// when they're actually needed (see decodeSnapshot()). Until
+		// then 'savestate' is empty and this holds the xml document.
+		std::optional<XMLElement> lazySnapshot;
 	};
 	using Chunks = std::map<unsigned, ReverseChunk>;
 	using Events = std::vector<std::shared_ptr<StateChange>>;
@@ -71,6 +86,7 @@ private:
 		void swap(ReverseHistory& other);
 		void clear();
 		unsigned getNextSeqNum(EmuTime::param time) const;
+		size_t getMemoryUsage() const;
 
 		Chunks chunks;
 		Events events;
@@ -89,6 +105,11 @@ private:
 	                span<const TclObject> tokens, TclObject& result);
 	void loadReplay(Interpreter& interp,
 	                span<const TclObject> tokens, TclObject& result);
+	void startHashLog(Interpreter& interp, span<const TclObject> tokens);
+	void stopHashLog();
+	static void bisectHashLog(MSXMotherBoard& motherBoard,
+	                          span<const TclObject> tokens, TclObject& result);
+	static StateHashLog::Entry probeHash(Reactor& reactor, EmuTime::param time);
 
 	void signalStopReplay(EmuTime::param time);
 	EmuTime::param getEndTime(const ReverseHistory& history) const;
@@ -98,10 +119,13 @@ private:
 	void transferHistory(ReverseHistory& oldHistory,
 	                     unsigned oldEventCount);
 	void transferState(MSXMotherBoard& newBoard);
+	void decodeSnapshot(ReverseHistory& hist, ReverseChunk& chunk);
 	void takeSnapshot(EmuTime::param time);
 	void schedule(EmuTime::param time);
 	void replayNextEvent();
-	template<unsigned N> void dropOldSnapshots(unsigned count);
+	void dropOldSnapshots(EmuTime::param time, unsigned keepSeqNum);
+	size_t getMemoryBudget() const;
+	EmuDuration getSnapshotPeriod() const;
 
 	// Schedulable
 	struct SyncNewSnapshot final : Schedulable {
@@ -120,9 +144,18 @@ private:
 			rm.execInputEvent();
 		}
 	} syncInputEvent;
+	struct SyncHashLog final : Schedulable {
+		friend class ReverseManager;
+		explicit SyncHashLog(Scheduler& s) : Schedulable(s) {}
+		void executeUntil(EmuTime::param time) override {
+			auto& rm = OUTER(ReverseManager, syncHashLog);
+			rm.execHashLog(time);
+		}
+	} syncHashLog;
 
 	void execNewSnapshot();
 	void execInputEvent();
+	void execHashLog(EmuTime::param time);
 	EmuTime::param getCurrentTime() const { return syncNewSnapshot.getCurrentTime(); }
 
 	// EventListener
@@ -152,6 +185,15 @@ private:
 
 	unsigned reRecordCount;
 
+	// (moving) average of the memory used by one snapshot, in bytes
+	double avgSnapshotSize;
+
+	// 'reverse hashlog': either writing a log at regular intervals, or
+	// (without log) a single hash, used while bisecting
+	std::unique_ptr<StateHashLog> stateHashLog;
+	EmuDuration hashLogInterval;
+	std::optional<StateHashLog::Entry> hashProbe;
+
 	friend struct Replay;
 };
 
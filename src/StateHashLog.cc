@@ -0,0 +1,145 @@
+#include "StateHashLog.hh"
+#include "MSXMotherBoard.hh"
+#include "MSXException.hh"
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+
+namespace openmsx {
+
+// File format:
+//   header: the 8 characters "OMSXHSH1"
+//   per entry:
+//     uint64_t   EmuTime (in ticks)
+//     uint32_t   number of device names, 0 means same names as previous entry
+//      per name: uint32_t length + characters
+//     Sha1Sum    hash of the complete machine
+//     Sha1Sum    hash per device (in the order of the names)
+constexpr char MAGIC[8] = { 'O', 'M', 'S', 'X', 'H', 'S', 'H', '1' };
+
+static_assert(sizeof(Sha1Sum) == 20);
+static_assert(std::is_trivially_copyable_v<Sha1Sum>);
+
+StateHashLog::Entry StateHashLog::calc(MSXMotherBoard& motherBoard, EmuTime::param time)
+{
+	Entry result(time);
+	result.machine = motherBoard.getStateHash();
+	for (auto& [name, hash] : motherBoard.getDeviceStateHashes()) {
+		result.names.push_back(std::move(name));
+		result.hashes.push_back(hash);
+	}
+	return result;
+}
+
+StateHashLog::StateHashLog(const std::string& filename)
+	: file(filename, File::TRUNCATE)
+{
+	file.write(MAGIC, sizeof(MAGIC));
+}
+
+template<typename T> void StateHashLog::writeRaw(const T& t)
+{
+	file.write(&t, sizeof(t));
+}
+
+void StateHashLog::write(const Entry& entry)
+{
+	writeRaw(uint64_t((entry.time - EmuTime::zero()).length()));
+	if (entry.names == lastNames) {
+		writeRaw(uint32_t(0));
+	} else {
+		writeRaw(uint32_t(entry.names.size()));
+		for (auto& name : entry.names) {
+			writeRaw(uint32_t(name.size()));
+			file.write(name.data(), name.size());
+		}
+		lastNames = entry.names;
+	}
+	writeRaw(entry.machine);
+	file.write(entry.hashes.data(), entry.hashes.size() * sizeof(Sha1Sum));
+	file.flush(); // the log is complete, even if openMSX doesn't exit cleanly
+}
+
+std::vector<StateHashLog::Entry> StateHashLog::read(const std::string& filename)
+{
+	File file(filename);
+	auto buf = file.mmap();
+	size_t pos = 0;
+	auto get = [&](void* dst, size_t size) {
+		if ((buf.size() - pos) < size) {
+			throw MSXException("Invalid state hash log: ", filename);
+		}
+		memcpy(dst, &buf[pos], size);
+		pos += size;
+	};
+
+	char magic[sizeof(MAGIC)];
+	get(magic, sizeof(magic));
+	if (memcmp(magic, MAGIC, sizeof(MAGIC)) != 0) {
+		throw MSXException("Not a state hash log: ", filename);
+	}
+
+	std::vector<Entry> result;
+	std::vector<std::string> names;
+	while (pos != buf.size()) {
+		uint64_t ticks;
+		get(&ticks, sizeof(ticks));
+		Entry& entry = result.emplace_back(EmuTime::makeEmuTime(ticks));
+
+		uint32_t num;
+		get(&num, sizeof(num));
+		if (num != 0) {
+			names.resize(num);
+			for (auto& name : names) {
+				uint32_t len;
+				get(&len, sizeof(len));
+				name.resize(len);
+				get(name.data(), len);
+			}
+		}
+		entry.names = names;
+
+		get(&entry.machine, sizeof(Sha1Sum));
+		entry.hashes.resize(names.size());
+		get(entry.hashes.data(), names.size() * sizeof(Sha1Sum));
+	}
+	return result;
+}
+
+size_t StateHashLog::firstDifference(span<const Entry> log1, span<const Entry> log2)
+{
+	auto num = std::min(log1.size(), log2.size());
+	for (size_t i = 0; i < num; ++i) {
+		if (log1[i].time != log2[i].time) {
+			throw MSXException(
+				"The logs were not taken at the same moments in time, "
+				"use the same interval for both.");
+		}
+		if (log1[i].machine != log2[i].machine) return i;
+	}
+	return num;
+}
+
+std::vector<std::string> StateHashLog::differentDevices(
+	const Entry& entry1, const Entry& entry2)
+{
+	// both name lists are sorted
+	std::vector<std::string> result;
+	size_t i1 = 0, i2 = 0;
+	auto n1 = entry1.names.size(), n2 = entry2.names.size();
+	while ((i1 < n1) || (i2 < n2)) {
+		if ((i2 == n2) || ((i1 < n1) && (entry1.names[i1] < entry2.names[i2]))) {
+			result.push_back(entry1.names[i1++]);
+		} else if ((i1 == n1) || (entry2.names[i2] < entry1.names[i1])) {
+			result.push_back(entry2.names[i2++]);
+		} else {
+			if (entry1.hashes[i1] != entry2.hashes[i2]) {
+				result.push_back(entry1.names[i1]);
+			}
+			++i1; ++i2;
+		}
+	}
+	return result;
+}
+
+} // namespace openmsx
@@ -0,0 +1,69 @@
+#ifndef STATEHASHLOG_HH
+#define STATEHASHLOG_HH
+
+#include "EmuTime.hh"
+#include "File.hh"
+#include "sha1.hh"
+#include "span.hh"
+#include <string>
+#include <vector>
+
+namespace openmsx {
+
+class MSXMotherBoard;
+
+/** A log of hashes of the emulated machine state, taken at regular moments
+  * in EmuTime. Running the same replay twice (e.g. with two different
+  * openMSX builds) should produce identical logs. If not, comparing the
+  * logs tells when the runs started to diverge and, because there's a hash
+  * per device, also where.
+  *
+  * The log is a compact binary file. Hashes are stored in host byte order,
+  * so logs should be compared on the same kind of host.
+  */
+class StateHashLog
+{
+public:
+	struct Entry {
+		explicit Entry(EmuTime::param time_) : time(time_) {}
+
+		EmuTime time;
+		Sha1Sum machine;
+		std::vector<std::string> names; // 'cpu' + all devices, sorted
+		std::vector<Sha1Sum> hashes;    // in the same order as 'names'
+	};
+
+	/** Hash the current state of the given machine. */
+	[[nodiscard]] static Entry calc(MSXMotherBoard& motherBoard, EmuTime::param time);
+
+	/** Create (or overwrite) a log file. */
+	explicit StateHashLog(const std::string& filename);
+	void write(const Entry& entry);
+
+	/** Read a complete log file, throws MSXException on error. */
+	[[nodiscard]] static std::vector<Entry> read(const std::string& filename);
+
+	/** Index of the first entry that differs between the two logs. When
+	  * there's no difference, this is the size of the shortest log.
+	  * Throws MSXException when the entries were not taken at the same
+	  * moments in time (e.g. a different interval was used).
+	  */
+	[[nodiscard]] static size_t firstDifference(span<const Entry> log1,
+	                                            span<const Entry> log2);
+
+	/** Names of the devices that have a different hash in both entries.
+	  * Devices that are only present in one of them are also included.
+	  */
+	[[nodiscard]] static std::vector<std::string> differentDevices(
+		const Entry& entry1, const Entry& entry2);
+
+private:
+	template<typename T> void writeRaw(const T& t);
+
+	File file;
+	std::vector<std::string> lastNames;
+};
+
+} // namespace openmsx
+
+#endif
@@ -5,6 +5,7 @@
 #include "CliComm.hh"
 #include "Clock.hh"
 #include "MSXException.hh"
+#include "ranges.hh"
 #include "stl.hh"
 #include "xrange.hh"
 #include <cstring> // for memcmp
@@ -42,6 +43,9 @@ constexpr unsigned LONG_SILENCE  = OUTPUT_FREQUENCY * 2; // 2 seconds
 constexpr unsigned LONG_HEADER  = 16000 / 2;
 constexpr unsigned SHORT_HEADER =  4000 / 2;
 
+// number of output samples for one byte (start bit, 8 data bits, 2 stop bits)
+constexpr unsigned BYTE_SAMPLES = 11 * 4;
+
 // headers definitions
 constexpr byte CAS_HEADER   [ 8] = { 0x1F,0xA6,0xDE,0xBA,0xCC,0x13,0x7D,0x74 };
 constexpr byte ASCII_HEADER [10] = { 0xEA,0xEA,0xEA,0xEA,0xEA,0xEA,0xEA,0xEA,0xEA,0xEA };
@@ -94,6 +98,45 @@ float CasImage::getAmplificationFactorImpl() const
 	return 1.0f / 128;
 }
 
+// first sample at or after the given time
+static size_t getSampleNum(EmuTime::param time)
+{
+	Clock<OUTPUT_FREQUENCY> clk(EmuTime::zero());
+	size_t num = clk.getTicksTill(time);
+	clk += unsigned(num);
+	return (clk.getTime() < time) ? num + 1 : num;
+}
+
+static EmuTime getSampleTime(size_t num)
+{
+	Clock<OUTPUT_FREQUENCY> clk(EmuTime::zero());
+	clk += unsigned(num);
+	return clk.getTime();
+}
+
+bool CasImage::findNextBlock(EmuTime& pos) const
+{
+	auto sample = getSampleNum(pos);
+	auto it = ranges::find_if(blocks,
+		[&](const Block& b) { return b.dataStart >= sample; });
+	if (it == end(blocks)) return false;
+	pos = getSampleTime(it->dataStart);
+	return true;
+}
+
+std::optional<byte> CasImage::readByte(EmuTime& pos) const
+{
+	auto sample = getSampleNum(pos);
+	auto it = ranges::upper_bound(blocks, sample,
+		[](size_t s, const Block& b) { return s < b.dataStart; });
+	if (it == begin(blocks)) return {}; // before the first block
+	--it;
+	size_t idx = (sample - it->dataStart + BYTE_SAMPLES - 1) / BYTE_SAMPLES;
+	if (idx >= it->size) return {}; // past the end of this block
+	pos = getSampleTime(it->dataStart + (idx + 1) * BYTE_SAMPLES);
+	return data[it->offset + idx];
+}
+
 void CasImage::write0()
 {
 	append(output, {127, 127, -127, -127});
@@ -138,9 +181,11 @@ void CasImage::writeByte(byte b)
 // write data until a header is detected
 bool CasImage::writeData(span<byte> buf, size_t& pos)
 {
+	blocks.push_back(Block{output.size(), pos, 0});
 	bool eof = false;
 	while ((pos + 8) <= buf.size()) {
 		if (memcmp(&buf[pos], CAS_HEADER, 8) == 0) {
+			blocks.back().size = pos - blocks.back().offset;
 			return eof;
 		}
 		writeByte(buf[pos]);
@@ -152,6 +197,7 @@ bool CasImage::writeData(span<byte> buf, size_t& pos)
 	while (pos < buf.size()) {
 		writeByte(buf[pos++]);
 	}
+	blocks.back().size = pos - blocks.back().offset;
 	return false;
 }
 
@@ -159,6 +205,7 @@ void CasImage::convert(const Filename& filename, FilePool& filePool, CliComm& cl
 {
 	File file(filename);
 	auto buf = file.mmap();
+	data.assign(buf.begin(), buf.end());
 
 	// search for a header in the .cas file
 	bool issueWarning = false;
@@ -4,6 +4,7 @@
 #include "CassetteImage.hh"
 #include "openmsx.hh"
 #include "span.hh"
+#include <optional>
 #include <vector>
 
 namespace openmsx {
@@ -27,6 +28,22 @@ public:
 	void fillBuffer(unsigned pos, float** bufs, unsigned num) const override;
 	float getAmplificationFactorImpl() const override;
 
+	// Support for (optionally) emulating the BIOS tape routines, see
+	// CassettePlayer. Tape positions are expressed as EmuTime, like the
+	// other methods in this class.
+
+	/** Search the first data block that starts at or after the given
+	  * tape position (TAPION). On success 'pos' is moved to the first
+	  * byte of that block.
+	  */
+	[[nodiscard]] bool findNextBlock(EmuTime& pos) const;
+
+	/** Read the next byte of the current data block (TAPIN) and move
+	  * 'pos' to the end of that byte. Fails when 'pos' is not inside a
+	  * data block (e.g. at the end of the block).
+	  */
+	[[nodiscard]] std::optional<byte> readByte(EmuTime& pos) const;
+
 private:
 	void write0();
 	void write1();
@@ -37,6 +54,16 @@ private:
 	void convert(const Filename& filename, FilePool& filePool, CliComm& cliComm);
 
 	std::vector<signed char> output;
+
+	// The content of the CAS file and the location of its data blocks in
+	// the generated waveform.
+	struct Block {
+		size_t dataStart; // sample number of the first data byte
+		size_t offset;    // position of the first data byte in 'data'
+		size_t size;      // number of data bytes
+	};
+	std::vector<Block> blocks; // sorted on 'dataStart'
+	std::vector<byte> data;
 };
 
 } // namespace openmsx
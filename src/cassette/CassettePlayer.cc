@@ -34,10 +34,15 @@
 #include "CasImage.hh"
 #include "CliComm.hh"
 #include "MSXMotherBoard.hh"
+#include "MSXCPU.hh"
+#include "MSXCPUInterface.hh"
+#include "CPURegs.hh"
 #include "Reactor.hh"
 #include "GlobalSettings.hh"
 #include "CommandException.hh"
 #include "EventDistributor.hh"
+#include "StateChange.hh"
+#include "StateChangeDistributor.hh"
 #include "FileOperations.hh"
 #include "WavWriter.hh"
 #include "TclObject.hh"
@@ -48,6 +53,7 @@
 #include <algorithm>
 #include <cassert>
 #include <memory>
+#include <optional>
 
 using std::string;
 using std::vector;
@@ -58,6 +64,24 @@ constexpr unsigned DUMMY_INPUT_RATE = 44100; // actual rate depends on .cas/.wav
 constexpr unsigned RECORD_FREQ = 44100;
 constexpr double OUTPUT_AMP = 60.0;
 
+class FastLoadChange final : public StateChange
+{
+public:
+	FastLoadChange() = default; // for serialize
+	FastLoadChange(EmuTime::param time_, bool enable_)
+		: StateChange(time_), enable(enable_) {}
+	bool getEnable() const { return enable; }
+
+	template<typename Archive> void serialize(Archive& ar, unsigned /*version*/)
+	{
+		ar.template serializeBase<StateChange>(*this);
+		ar.serialize("enable", enable);
+	}
+private:
+	bool enable;
+};
+REGISTER_POLYMORPHIC_CLASS(StateChange, FastLoadChange, "CassetteFastLoadChange");
+
 static XMLElement createXML()
 {
 	XMLElement xml("cassetteplayer");
@@ -82,6 +106,12 @@ CassettePlayer::CassettePlayer(const HardwareConfig& hwConf)
 	, autoRunSetting(
 		motherBoard.getCommandController(),
 		"autoruncassettes", "automatically try to run cassettes", true)
+	, fastLoadSetting(
+		motherBoard.getCommandController(),
+		"fastloadcassettes", "load CAS images instantly by emulating "
+		"the BIOS tape routines (only works for programs that use "
+		"the BIOS to load)", false)
+	, fastLoad(fastLoadSetting.getBoolean())
 	, sampcnt(0)
 	, state(STOP)
 	, lastOutput(false)
@@ -96,14 +126,19 @@ CassettePlayer::CassettePlayer(const HardwareConfig& hwConf)
 	motherBoard.getReactor().getEventDistributor().registerEventListener(
 		OPENMSX_BOOT_EVENT, *this);
 	motherBoard.getMSXCliComm().update(CliComm::HARDWARE, getName(), "add");
+	fastLoadSetting.attach(*this);
+	motherBoard.getStateChangeDistributor().registerListener(*this);
 }
 
 CassettePlayer::~CassettePlayer()
 {
+	motherBoard.getStateChangeDistributor().unregisterListener(*this);
+	fastLoadSetting.detach(*this);
 	unregisterSound();
 	if (auto* c = getConnector()) {
 		c->unplug(getCurrentTime());
 	}
+	assert(fastLoadHooks.empty()); // removed on unplug
 	motherBoard.getReactor().getEventDistributor().unregisterEventListener(
 		OPENMSX_BOOT_EVENT, *this);
 	motherBoard.getMSXCliComm().update(CliComm::HARDWARE, getName(), "remove");
@@ -283,6 +318,7 @@ void CassettePlayer::setState(State newState, const Filename& newImage,
 		CliComm::STATUS, "cassetteplayer", getStateString());
 
 	updateLoadingState(time); // sets SP for tape-end detection
+	updateFastLoad(getConnector() != nullptr);
 
 	checkInvariants();
 }
@@ -300,6 +336,89 @@ void CassettePlayer::updateLoadingState(EmuTime::param time)
 	}
 }
 
+void CassettePlayer::updateFastLoad(bool plugged)
+{
+	// Hooks are only installed while the player is plugged in, this
+	// guarantees they're removed before the CPU is destroyed.
+	bool enable = plugged && fastLoad &&
+	              (getState() == PLAY) &&
+	              dynamic_cast<CasImage*>(playImage.get());
+	if (enable == !fastLoadHooks.empty()) return;
+
+	auto& cpuInterface = motherBoard.getCPUInterface();
+	if (enable) {
+		// The BIOS (in slot 0-0) has a jump table with 'JP <routine>'
+		// instructions, hook the actual routines (like the BIOS itself,
+		// BASIC doesn't always call them via the jump table).
+		auto time = getCurrentTime();
+		auto getRoutine = [&](word entry) -> std::optional<word> {
+			if (cpuInterface.peekSlottedMem(entry, time) != 0xC3) {
+				return {}; // not an MSX BIOS, e.g. SVI
+			}
+			return cpuInterface.peekSlottedMem(entry + 1, time) +
+			       256 * cpuInterface.peekSlottedMem(entry + 2, time);
+		};
+		auto tapion = getRoutine(0x00E1);
+		auto tapin  = getRoutine(0x00E4);
+		if (!tapion || !tapin) return;
+		fastLoadHooks.push_back(cpuInterface.insertCPUHook(*tapion, 0, 0,
+			[this](EmuTime::param t) { fastTapion(t); }));
+		fastLoadHooks.push_back(cpuInterface.insertCPUHook(*tapin, 0, 0,
+			[this](EmuTime::param t) { fastTapin(t); }));
+	} else {
+		for (auto id : fastLoadHooks) cpuInterface.removeCPUHook(id);
+		fastLoadHooks.clear();
+	}
+}
+
+// TAPION: search for the next header on the tape.
+void CassettePlayer::fastTapion(EmuTime::param time)
+{
+	auto& cas = static_cast<CasImage&>(*playImage);
+	sync(time);
+	EmuTime pos = tapePos;
+	bool found = cas.findNextBlock(pos);
+	if (found) setTapePos(pos, time);
+	returnFromBios(!found, time);
+}
+
+// TAPIN: read one byte from the tape.
+void CassettePlayer::fastTapin(EmuTime::param time)
+{
+	auto& cas = static_cast<CasImage&>(*playImage);
+	sync(time);
+	EmuTime pos = tapePos;
+	auto value = cas.readByte(pos);
+	if (value) {
+		setTapePos(pos, time);
+		motherBoard.getCPU().getRegisters().setA(*value);
+	}
+	returnFromBios(!value, time);
+}
+
+// Emulate the 'RET' at the end of the BIOS routine. Carry flag indicates an
+// error (the routine is aborted), this is reported as a 'Device I/O error'.
+void CassettePlayer::returnFromBios(bool error, EmuTime::param time)
+{
+	auto& regs = motherBoard.getCPU().getRegisters();
+	auto& cpuInterface = motherBoard.getCPUInterface();
+	word sp = regs.getSP();
+	regs.setPC(cpuInterface.peekMem(sp, time) +
+	           256 * cpuInterface.peekMem(word(sp + 1), time));
+	regs.setSP(word(sp + 2));
+	regs.setF(error ? 0x01 : 0x40);
+}
+
+void CassettePlayer::setTapePos(EmuTime::param newPos, EmuTime::param time)
+{
+	sync(time); // before tapePos changes
+	tapePos = newPos;
+	DynamicClock clk(EmuTime::zero());
+	clk.setFreq(playImage->getFrequency());
+	audioPos = clk.getTicksTill(tapePos);
+	updateLoadingState(time);
+}
+
 void CassettePlayer::setImageName(const Filename& newImage)
 {
 	casImage = newImage;
@@ -542,6 +661,7 @@ void CassettePlayer::plugHelper(Connector& conn, EmuTime::param time)
 {
 	sync(time);
 	lastOutput = static_cast<CassettePort&>(conn).lastOut();
+	updateFastLoad(true);
 }
 
 void CassettePlayer::unplugHelper(EmuTime::param time)
@@ -558,7 +678,13 @@ void CassettePlayer::generateChannels(float** buffers, unsigned num)
 		buffers[0] = nullptr;
 		return;
 	}
-	playImage->fillBuffer(audioPos, buffers, num);
+	if (isOutputMuted()) {
+		// Nobody listens (e.g. while fast-forwarding through a tape
+		// load), skip converting the samples.
+		buffers[0] = nullptr;
+	} else {
+		playImage->fillBuffer(audioPos, buffers, num);
+	}
 	audioPos += num;
 }
 
@@ -567,6 +693,39 @@ float CassettePlayer::getAmplificationFactorImpl() const
 	return playImage ? playImage->getAmplificationFactorImpl() : 1.0f;
 }
 
+void CassettePlayer::update(const Setting& setting)
+{
+	if (&setting == &fastLoadSetting) {
+		// The hooks change the emulation, so this is recorded (and
+		// applied in signalStateChange()).
+		if (fastLoadSetting.getBoolean() != fastLoad) {
+			motherBoard.getStateChangeDistributor().distributeNew(
+				std::make_shared<FastLoadChange>(
+					getCurrentTime(), fastLoadSetting.getBoolean()));
+		}
+	} else {
+		ResampledSoundDevice::update(setting);
+	}
+}
+
+void CassettePlayer::signalStateChange(const std::shared_ptr<StateChange>& event)
+{
+	auto* change = dynamic_cast<FastLoadChange*>(event.get());
+	if (!change) return;
+	fastLoad = change->getEnable();
+	updateFastLoad(getConnector() != nullptr);
+}
+
+void CassettePlayer::stopReplay(EmuTime::param time)
+{
+	// the setting may have changed while replaying
+	if (fastLoadSetting.getBoolean() != fastLoad) {
+		motherBoard.getStateChangeDistributor().distributeNew(
+			std::make_shared<FastLoadChange>(
+				time, fastLoadSetting.getBoolean()));
+	}
+}
+
 int CassettePlayer::signalEvent(const std::shared_ptr<const Event>& event)
 {
 	if (event->getType() == OPENMSX_BOOT_EVENT) {
@@ -839,6 +998,7 @@ SERIALIZE_ENUM(CassettePlayer::State, stateInfo);
 
 // version 1: initial version
 // version 2: added checksum
+// version 3: added fastLoad
 template<typename Archive>
 void CassettePlayer::serialize(Archive& ar, unsigned version)
 {
@@ -920,6 +1080,12 @@ void CassettePlayer::serialize(Archive& ar, unsigned version)
 	             "lastOutput",   lastOutput,
 	             "motor",        motor,
 	             "motorControl", motorControl);
+	if (ar.versionAtLeast(version, 3)) {
+		ar.serialize("fastLoad", fastLoad);
+	} else {
+		assert(ar.isLoader());
+		fastLoad = false; // older versions didn't have fast loading
+	}
 
 	if (ar.isLoader()) {
 		auto time = getCurrentTime();
@@ -947,6 +1113,7 @@ void CassettePlayer::serialize(Archive& ar, unsigned version)
 		}
 		sync(time);
 		updateLoadingState(time);
+		updateFastLoad(getConnector() != nullptr);
 	}
 }
 INSTANTIATE_SERIALIZE_METHODS(CassettePlayer);
@@ -5,6 +5,7 @@
 #include "CassetteDevice.hh"
 #include "ResampledSoundDevice.hh"
 #include "RecordedCommand.hh"
+#include "StateChangeListener.hh"
 #include "Schedulable.hh"
 #include "ThrottleManager.hh"
 #include "Filename.hh"
@@ -14,6 +15,7 @@
 #include "serialize_meta.hh"
 #include <string>
 #include <memory>
+#include <vector>
 
 namespace openmsx {
 
@@ -23,7 +25,7 @@ class MSXMotherBoard;
 class Wav8Writer;
 
 class CassettePlayer final : public CassetteDevice, public ResampledSoundDevice
-                           , private EventListener
+                           , private EventListener, private StateChangeListener
 {
 public:
 	explicit CassettePlayer(const HardwareConfig& hwConf);
@@ -107,6 +109,15 @@ private:
 	void updateTapePosition(EmuDuration::param duration, EmuTime::param time);
 	void generateRecordOutput(EmuDuration::param duration);
 
+	/** Install the CPU hooks on the BIOS tape routines iff fast loading
+	  * is enabled and a CAS image is being played.
+	  */
+	void updateFastLoad(bool plugged);
+	void fastTapion(EmuTime::param time);
+	void fastTapin(EmuTime::param time);
+	void returnFromBios(bool error, EmuTime::param time);
+	void setTapePos(EmuTime::param newPos, EmuTime::param time);
+
 	void fillBuf(size_t length, double x);
 	void flushOutput();
 	void autoRun();
@@ -114,6 +125,13 @@ private:
 	// EventListener
 	int signalEvent(const std::shared_ptr<const Event>& event) override;
 
+	// Observer<Setting> (also used by ResampledSoundDevice)
+	void update(const Setting& setting) override;
+
+	// StateChangeListener
+	void signalStateChange(const std::shared_ptr<StateChange>& event) override;
+	void stopReplay(EmuTime::param time) override;
+
 	// Schedulable
 	struct SyncEndOfTape final : Schedulable {
 		friend class CassettePlayer;
@@ -170,6 +188,12 @@ private:
 
 	LoadingIndicator loadingIndicator;
 	BooleanSetting autoRunSetting;
+	BooleanSetting fastLoadSetting;
+	std::vector<unsigned> fastLoadHooks;
+	// The fast loading mode of the emulated machine. Changes of the
+	// setting are recorded (as a StateChange) and applied via this, so
+	// that replays and reverse give the same result.
+	bool fastLoad;
 	std::unique_ptr<Wav8Writer> recordImage;
 	std::unique_ptr<CassetteImage> playImage;
 
@@ -179,7 +203,7 @@ private:
 	bool motor, motorControl;
 	bool syncScheduled;
 };
-SERIALIZE_CLASS_VERSION(CassettePlayer, 2);
+SERIALIZE_CLASS_VERSION(CassettePlayer, 3);
 
 } // namespace openmsx
 
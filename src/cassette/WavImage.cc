@@ -4,6 +4,8 @@
 #include "FilePool.hh"
 #include "Math.hh"
 #include "xrange.hh"
+#include <algorithm>
+#include <cmath>
 
 namespace openmsx {
 
@@ -16,6 +18,7 @@ public:
 		const float cuttOffFreq = 800.0f; // trial-and-error
 		R = 1.0f - ((float(2 * M_PI) * cuttOffFreq) / sampleFreq);
 	}
+	float getR() const { return R; }
 	int16_t operator()(int16_t x) {
 		float t1 = R * t0 + x;
 		int16_t y = Math::clipIntToShort(t1 - t0);
@@ -27,15 +30,75 @@ private:
 	float t0 = 0.0f;
 };
 
+// Number of samples per block, and the maximum number of blocks in memory.
+constexpr unsigned BLOCK_SIZE = 16384;
+constexpr size_t MAX_BLOCKS = 16; // 512kB
+
 // Note: type detection not implemented yet for WAV images
 WavImage::WavImage(const Filename& filename, FilePool& filePool)
-	: clock(EmuTime::zero())
+	: file(filename)
+	, raw(file.mmap())
+	, format(WavData::parseHeader(raw))
+	, clock(EmuTime::zero())
 {
-	File file(filename);
 	setSha1Sum(filePool.getSha1Sum(file));
+	clock.setFreq(format.freq);
+
+	// The influence of the DC filter state decays with a factor R per
+	// sample. So starting the filter 'warmUp' samples before the start of
+	// a block gives (within float precision) the same result as filtering
+	// from the start of the file.
+	DCFilter filter;
+	filter.setFreq(format.freq);
+	float r = std::abs(filter.getR());
+	warmUp = (r < 0.01f) ? 0
+	       : (r < 1.0f)  ? unsigned(std::ceil(std::log(1e-9f) / std::log(r)))
+	       : unsigned(-1); // filter doesn't decay, always start at 0
+}
 
-	wav = WavData(std::move(file), DCFilter{});
-	clock.setFreq(wav.getFreq());
+const WavImage::Block& WavImage::getBlock(unsigned number) const
+{
+	if (lastBlock && (lastBlock->number == number)) {
+		return *lastBlock; // fast path for sequential access
+	}
+	auto it = std::find_if(begin(blocks), end(blocks),
+		[&](const Block& b) { return b.number == number; });
+	if (it == end(blocks)) {
+		if (blocks.size() < MAX_BLOCKS) {
+			blocks.push_back(Block{MemBuffer<int16_t>(BLOCK_SIZE), 0, 0});
+			it = end(blocks) - 1;
+		} else {
+			it = std::min_element(begin(blocks), end(blocks),
+				[](const Block& x, const Block& y) {
+					return x.lastUse < y.lastUse; });
+		}
+		it->number = number;
+		decodeBlock(*it);
+	}
+	it->lastUse = ++useCounter;
+	lastBlock = &*it;
+	return *it;
+}
+
+void WavImage::decodeBlock(Block& block) const
+{
+	unsigned start = block.number * BLOCK_SIZE;
+	unsigned num = std::min(BLOCK_SIZE, format.length - start);
+	DCFilter filter;
+	filter.setFreq(format.freq);
+	unsigned first = (start > warmUp) ? (start - warmUp) : 0;
+	for (auto i : xrange(first, start)) {
+		(void)filter(WavData::convertSample(raw, format, i));
+	}
+	for (auto i : xrange(num)) {
+		block.samples[i] = filter(WavData::convertSample(raw, format, start + i));
+	}
+}
+
+int16_t WavImage::getSample(unsigned pos) const
+{
+	if (pos >= format.length) return 0;
+	return getBlock(pos / BLOCK_SIZE).samples[pos % BLOCK_SIZE];
 }
 
 int16_t WavImage::getSampleAt(EmuTime::param time)
@@ -52,10 +115,10 @@ int16_t WavImage::getSampleAt(EmuTime::param time)
 	// work in openMSX (with sample-and-hold it didn't work).
 	auto [sample, x] = clock.getTicksTillAsIntFloat(time);
 	float p[4] = {
-		float(wav.getSample(unsigned(sample) - 1)), // intentional: underflow wraps to UINT_MAX
-		float(wav.getSample(sample + 0)),
-		float(wav.getSample(sample + 1)),
-		float(wav.getSample(sample + 2))
+		float(getSample(unsigned(sample) - 1)), // intentional: underflow wraps to UINT_MAX
+		float(getSample(sample + 0)),
+		float(getSample(sample + 1)),
+		float(getSample(sample + 2))
 	};
 	return Math::clipIntToShort(int(Math::cubicHermite(p + 1, x)));
 }
@@ -63,7 +126,7 @@ int16_t WavImage::getSampleAt(EmuTime::param time)
 EmuTime WavImage::getEndTime() const
 {
 	DynamicClock clk(clock);
-	clk += wav.getSize();
+	clk += format.length;
 	return clk.getTime();
 }
 
@@ -74,9 +137,9 @@ unsigned WavImage::getFrequency() const
 
 void WavImage::fillBuffer(unsigned pos, float** bufs, unsigned num) const
 {
-	if (pos < wav.getSize()) {
+	if (pos < format.length) {
 		for (auto i : xrange(num)) {
-			bufs[0][i] = wav.getSample(pos + i);
+			bufs[0][i] = getSample(pos + i);
 		}
 	} else {
 		bufs[0] = nullptr;
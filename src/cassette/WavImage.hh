@@ -4,13 +4,22 @@
 #include "CassetteImage.hh"
 #include "WavData.hh"
 #include "DynamicClock.hh"
+#include "File.hh"
+#include "MemBuffer.hh"
 #include <cstdint>
+#include <vector>
 
 namespace openmsx {
 
 class Filename;
 class FilePool;
 
+/** Cassette image in .wav format.
+  *
+  * The file is memory-mapped and the samples are converted (DC-filtered)
+  * on demand, in blocks. Only the most recently used blocks are kept in
+  * memory, so also very long tapes can be inserted quickly.
+  */
 class WavImage final : public CassetteImage
 {
 public:
@@ -23,7 +32,23 @@ public:
 	float getAmplificationFactorImpl() const override;
 
 private:
-	WavData wav;
+	struct Block {
+		MemBuffer<int16_t> samples;
+		unsigned number;
+		uint64_t lastUse;
+	};
+
+	int16_t getSample(unsigned pos) const;
+	const Block& getBlock(unsigned number) const;
+	void decodeBlock(Block& block) const;
+
+	File file;
+	span<uint8_t> raw; // mmap()-ed content of 'file'
+	WavData::Format format;
+	unsigned warmUp; // see decodeBlock()
+	mutable std::vector<Block> blocks;
+	mutable const Block* lastBlock = nullptr;
+	mutable uint64_t useCounter = 0;
 	DynamicClock clock;
 };
 
@@ -37,6 +37,7 @@ protected:
 	EmuTime getTimeFast(int cc) const {
 		return clock.getFastAdd(limit - remaining + cc);
 	}
+	EmuDuration getPeriod() const { return clock.getPeriod(); }
 	void setTime(EmuTime::param time) { sync(); clock.reset(time); }
 	void setFreq(unsigned freq) { clock.setFreq(freq); }
 	void advanceTime(EmuTime::param time);
@@ -40,6 +40,13 @@
 // from then on this pointer is used for all further accesses to this region,
 // until the cache is invalidated again.
 //
+// Sometimes a cache line is only non-cacheable because of a few individual
+// addresses in it (e.g. the secondary slot select register at 0xFFFF or a
+// memory watchpoint). For such lines the slow path keeps a pointer plus a
+// bitmap of those exceptional addresses, so that the other addresses in that
+// line can still be accessed directly (without going via the device its
+// readMem() or writeMem() methods).
+//
 //
 // INSTRUCTION EMULATION
 // ---------------------
@@ -159,6 +166,7 @@
 // instructions too late.
 
 #include "CPUCore.hh"
+#include "CPUProfiler.hh"
 #include "MSXCPUInterface.hh"
 #include "Scheduler.hh"
 #include "MSXMotherBoard.hh"
@@ -281,7 +289,7 @@ struct CondTrue { bool operator()(byte /*f*/) const { return true; } };
 
 template<class T> CPUCore<T>::CPUCore(
 		MSXMotherBoard& motherboard_, const string& name,
-		const BooleanSetting& traceSetting_,
+		const BooleanSetting& traceSetting_, CPUProfiler& profiler_,
 		TclCallback& diHaltCallback_, EmuTime::param time)
 	: CPURegs(T::isR800())
 	, T(time, motherboard_.getScheduler())
@@ -289,6 +297,7 @@ template<class T> CPUCore<T>::CPUCore(
 	, scheduler(motherboard.getScheduler())
 	, interface(nullptr)
 	, traceSetting(traceSetting_)
+	, profiler(profiler_)
 	, diHaltCallback(diHaltCallback_)
 	, IRQStatus(motherboard.getDebugger(), name + ".pendingIRQ",
 	            "Non-zero if there are pending IRQs (thus CPU would enter "
@@ -589,6 +598,18 @@ NEVER_INLINE byte CPUCore<T>::RDMEMslow(unsigned address, unsigned cc)
 	}
 	// uncacheable
 	readCacheLine[high] = reinterpret_cast<const byte*>(1);
+	auto& partial = partialReadLine[high];
+	if (partial.generation != partialGeneration) {
+		partial.generation = partialGeneration;
+		unsigned addrBase = address & CacheLine::HIGH;
+		partial.data = interface->getReadCacheLinePartial(addrBase, partial.exceptions);
+		if (partial.data) partial.data -= addrBase;
+	}
+	if (partial.data && !partial.exceptions[address & CacheLine::LOW]) {
+		T::template PRE_MEM<PRE_PB, POST_PB>(address);
+		T::template POST_MEM<       POST_PB>(address);
+		return partial.data[address];
+	}
 	T::template PRE_MEM<PRE_PB, POST_PB>(address);
 	EmuTime time = T::getTimeFast(cc);
 	scheduler.schedule(time);
@@ -694,6 +715,19 @@ NEVER_INLINE void CPUCore<T>::WRMEMslow(unsigned address, byte value, unsigned c
 	}
 	// uncacheable
 	writeCacheLine[high] = reinterpret_cast<byte*>(1);
+	auto& partial = partialWriteLine[high];
+	if (partial.generation != partialGeneration) {
+		partial.generation = partialGeneration;
+		unsigned addrBase = address & CacheLine::HIGH;
+		partial.data = interface->getWriteCacheLinePartial(addrBase, partial.exceptions);
+		if (partial.data) partial.data -= addrBase;
+	}
+	if (partial.data && !partial.exceptions[address & CacheLine::LOW]) {
+		T::template PRE_MEM<PRE_PB, POST_PB>(address);
+		T::template POST_MEM<       POST_PB>(address);
+		partial.data[address] = value;
+		return;
+	}
 	T::template PRE_MEM<PRE_PB, POST_PB>(address);
 	EmuTime time = T::getTimeFast(cc);
 	scheduler.schedule(time);
@@ -885,6 +919,7 @@ void CPUCore<T>::executeInstructions()
 	T::add(ii.cycles); \
 	T::R800Refresh(*this); \
 	if (likely(!T::limitReached())) { \
+		profileNext(); \
 		incR(1); \
 		unsigned address = getPC(); \
 		const byte* line = readCacheLine[address >> CacheLine::BITS]; \
@@ -924,6 +959,7 @@ void CPUCore<T>::executeInstructions()
 	T::add(ii.cycles); \
 	T::R800Refresh(*this); \
 	if (likely(!T::limitReached())) { \
+		profileNext(); \
 		goto start; \
 	} \
 	return;
@@ -2436,9 +2472,11 @@ xx_cb: {
 template<class T> inline void CPUCore<T>::cpuTracePre()
 {
 	start_pc = getPC();
+	profileBegin();
 }
 template<class T> inline void CPUCore<T>::cpuTracePost()
 {
+	profileEnd(true);
 	if (unlikely(tracingEnabled)) {
 		cpuTracePost_slow();
 	}
@@ -2461,6 +2499,34 @@ template<class T> void CPUCore<T>::cpuTracePost_slow()
 	          << std::flush;
 }
 
+template<class T> inline void CPUCore<T>::profileBegin()
+{
+	if (unlikely(profilingEnabled)) {
+		profiler.beginStep(getPC(), getSP(), T::getTimeFast());
+	}
+}
+template<class T> inline void CPUCore<T>::profileEnd(bool instruction)
+{
+	if (unlikely(profilingEnabled)) {
+		profiler.endStep(getPC(), getSP(), T::getTimeFast(), T::getPeriod(),
+		                 instruction);
+	}
+}
+template<class T> inline void CPUCore<T>::profileNext()
+{
+	// Called between two instructions in executeInstructions(), so that
+	// profiling doesn't need to execute one instruction at a time. Only
+	// costs a (well predicted) test when not profiling.
+	if (unlikely(profilingEnabled)) {
+		profileNextSlow();
+	}
+}
+template<class T> void CPUCore<T>::profileNextSlow()
+{
+	// the end of one instruction is the begin of the next
+	profiler.nextStep(getPC(), getSP(), T::getTimeFast(), T::getPeriod());
+}
+
 template<class T> ExecIRQ CPUCore<T>::getExecIRQ() const
 {
 	if (unlikely(nmiEdge)) return ExecIRQ::NMI;
@@ -2472,7 +2538,9 @@ template<class T> void CPUCore<T>::executeSlow(ExecIRQ execIRQ)
 {
 	if (unlikely(execIRQ == ExecIRQ::NMI)) {
 		nmiEdge = false;
+		profileBegin();
 		nmi(); // NMI occured
+		profileEnd(false);
 	} else if (unlikely(execIRQ == ExecIRQ::IRQ)) {
 		// normal interrupt
 		if (unlikely(prevWasLDAI())) {
@@ -2497,6 +2565,7 @@ template<class T> void CPUCore<T>::executeSlow(ExecIRQ execIRQ)
 			setF(getF() & ~V_FLAG);
 		}
 		IRQAccept.signal();
+		profileBegin();
 		switch (getIM()) {
 			case 0: irq0();
 				break;
@@ -2507,9 +2576,12 @@ template<class T> void CPUCore<T>::executeSlow(ExecIRQ execIRQ)
 			default:
 				UNREACHABLE;
 		}
+		profileEnd(false);
 	} else if (unlikely(getHALT())) {
 		// in halt mode
+		profileBegin();
 		incR(T::advanceHalt(T::haltStates(), scheduler.getNext()));
+		profileEnd(false);
 		setSlowInstructions();
 	} else {
 		cpuTracePre();
@@ -2556,13 +2628,16 @@ template<class T> void CPUCore<T>::execute2(bool fastForward)
 	//       once in this method is enough.
 	scheduler.schedule(T::getTime());
 	setSlowInstructions();
+	// Starting or stopping the profiler exits the CPU loop.
+	profilingEnabled = !fastForward && profiler.isActive();
 
 	// Note: we call scheduler _after_ executing the instruction and before
 	// deciding between executeFast() and executeSlow() (because a
 	// SyncPoint could set an IRQ and then we must choose executeSlow())
-	if (fastForward ||
-	    (!interface->anyBreakPoints() && !tracingEnabled)) {
-		// fast path, no breakpoints, no tracing
+	if ((fastForward ||
+	     (!interface->anyBreakPoints() && !tracingEnabled)) &&
+	    !interface->anyCPUHooks()) {
+		// fast path, no breakpoints, no tracing, no hooks
 		do {
 			if (slowInstructions) {
 				--slowInstructions;
@@ -2573,10 +2648,12 @@ template<class T> void CPUCore<T>::execute2(bool fastForward)
 					T::enableLimit(); // does CPUClock::sync()
 					if (likely(!T::limitReached())) {
 						// multiple instructions
+						profileBegin();
 						executeInstructions();
 						// note: pipeline only shifted one
 						// step for multiple instructions
 						endInstruction();
+						profileEnd(true);
 					}
 					scheduler.schedule(T::getTimeFast());
 					if (needExitCPULoop()) return;
@@ -2631,11 +2708,17 @@ template<class T> void CPUCore<T>::execute2(bool fastForward)
 			// between emulated Z80 instructions, that means me must check for pending
 			// IRQs at the start (instead of end) of an instruction.
 			//
+			// The same holds for CPU hooks. Breakpoints are checked
+			// after the hooks (a hook may have changed PC), but not
+			// in fast-forward mode.
 			auto execIRQ = getExecIRQ();
-			if ((execIRQ == ExecIRQ::NONE) &&
-			    interface->checkBreakPoints(getPC(), motherboard)) {
-				assert(interface->isBreaked());
-				break;
+			if (execIRQ == ExecIRQ::NONE) {
+				interface->checkCPUHooks(getPC(), T::getTime());
+				if (!fastForward &&
+				    interface->checkBreakPoints(getPC(), motherboard)) {
+					assert(interface->isBreaked());
+					break;
+				}
 			}
 		} while (!needExitCPULoop());
 	}
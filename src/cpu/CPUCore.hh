@@ -11,11 +11,14 @@
 #include "openmsx.hh"
 #include "span.hh"
 #include <atomic>
+#include <bitset>
+#include <cstdint>
 #include <string>
 
 namespace openmsx {
 
 class MSXCPUInterface;
+class CPUProfiler;
 class Scheduler;
 class MSXMotherBoard;
 class TclCallback;
@@ -50,7 +53,7 @@ class CPUCore final : public CPUBase, public CPURegs, public CPU_POLICY
 {
 public:
 	CPUCore(MSXMotherBoard& motherboard, const std::string& name,
-	        const BooleanSetting& traceSetting,
+	        const BooleanSetting& traceSetting, CPUProfiler& profiler,
 	        TclCallback& diHaltCallback, EmuTime::param time);
 
 	void setInterface(MSXCPUInterface* interf) { interface = interf; }
@@ -80,6 +83,9 @@ public:
 	EmuTime waitCycles(EmuTime::param time, unsigned cycles);
 	void setNextSyncPoint(EmuTime::param time);
 	auto getCacheLines() {
+		// The caller (MSXCPU) may modify the cache lines, so the
+		// partial lines (see below) are no longer valid.
+		++partialGeneration;
 		return std::pair(readCacheLine, writeCacheLine);
 	}
 	bool isM1Cycle(unsigned address) const;
@@ -133,11 +139,27 @@ private:
 	const byte* readCacheLine[CacheLine::NUM];
 	byte* writeCacheLine[CacheLine::NUM];
 
+	// Lines that are not cacheable as a whole only because of some
+	// individual addresses (e.g. the secondary slot select register or a
+	// memory watchpoint). All other addresses in such a line are still
+	// accessed directly. Only used in the slow path, so the fast path
+	// (above) isn't affected. Entries are only valid when 'generation'
+	// matches 'partialGeneration'.
+	template<typename Ptr> struct PartialLine {
+		Ptr data = nullptr; // nullptr: (also) not partially cacheable
+		std::bitset<CacheLine::SIZE> exceptions;
+		uint64_t generation = 0;
+	};
+	PartialLine<const byte*> partialReadLine [CacheLine::NUM];
+	PartialLine<      byte*> partialWriteLine[CacheLine::NUM];
+	uint64_t partialGeneration = 1;
+
 	MSXMotherBoard& motherboard;
 	Scheduler& scheduler;
 	MSXCPUInterface* interface;
 
 	const BooleanSetting& traceSetting;
+	CPUProfiler& profiler;
 	TclCallback& diHaltCallback;
 
 	Probe<int> IRQStatus;
@@ -164,6 +186,9 @@ private:
 	/** In sync with traceSetting.getBoolean(). */
 	bool tracingEnabled;
 
+	/** Profiler active and not fast-forwarding, set in execute2(). */
+	bool profilingEnabled = false;
+
 	/** 'normal' Z80 and Z80 in a turboR behave slightly different */
 	const bool isTurboR;
 
@@ -171,6 +196,10 @@ private:
 	inline void cpuTracePre();
 	inline void cpuTracePost();
 	void cpuTracePost_slow();
+	inline void profileBegin();
+	inline void profileEnd(bool instruction);
+	inline void profileNext();
+	void profileNextSlow();
 
 	inline byte READ_PORT(unsigned port, unsigned cc);
 	inline void WRITE_PORT(unsigned port, byte value, unsigned cc);
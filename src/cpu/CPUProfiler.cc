@@ -0,0 +1,558 @@
+#include "CPUProfiler.hh"
+#include "MSXCPU.hh"
+#include "MSXCPUInterface.hh"
+#include "MSXMotherBoard.hh"
+#include "CommandException.hh"
+#include "File.hh"
+#include "FileContext.hh"
+#include "FileOperations.hh"
+#include "MSXException.hh"
+#include "StringOp.hh"
+#include "TclObject.hh"
+#include "outer.hh"
+#include "ranges.hh"
+#include "stl.hh"
+#include "strCat.hh"
+#include <fstream>
+#include <optional>
+
+namespace openmsx {
+
+// Deeper calls are considered to never return (e.g. because the routine
+// reset the stack pointer), the oldest call is then forgotten.
+constexpr size_t MAX_DEPTH = 1024;
+
+// A routine without a symbol at its entry point is named after the nearest
+// symbol before it, but only when that symbol isn't further away than this.
+constexpr unsigned MAX_SYMBOL_OFFSET = 0x100;
+
+CPUProfiler::CPUProfiler(MSXMotherBoard& motherBoard_, MSXCPU& cpu_)
+	: motherBoard(motherBoard_)
+	, cpu(cpu_)
+	, profileCmd(motherBoard.getCommandController())
+{
+	periodDivMod.setDivisor(1);
+}
+
+CPUProfiler::Region::Region(Address base_)
+	: base(base_)
+{
+	function.fill(NO_CALLER);
+}
+
+inline CPUProfiler::Region& CPUProfiler::getRegion(word address)
+{
+	auto*& region = visibleRegions[address >> REGION_BITS];
+	if (!region) region = &findRegion(address);
+	return *region;
+}
+
+CPUProfiler::Region& CPUProfiler::findRegion(word address)
+{
+	int page = address >> 14;
+	int segment = interface->getVisibleDevice(page)->getMemorySegment(address);
+	auto base = (Address(interface->getVisibleSlot(page)) << 25) |
+	            (Address(segment + 1) << 16) |
+	            (address & ~(REGION_SIZE - 1));
+	auto& region = regions[base];
+	if (!region) region = std::make_unique<Region>(base);
+	return *region;
+}
+
+CPUProfiler::Address CPUProfiler::getAddress(word address)
+{
+	return getRegion(address).base | (address & (REGION_SIZE - 1));
+}
+
+void CPUProfiler::beginStep(word pc, word sp, EmuTime::param time)
+{
+	if (!active) return;
+	beginTime = time;
+	totalTime = time;
+	beginRegion = &getRegion(pc);
+	beginPC = pc;
+	beginSP = sp;
+	inStep = true;
+	if (stack.empty()) {
+		// At the start, or after leaving the outermost call. Treat the
+		// current code as a routine that starts here.
+		stack.push_back(Frame{getAddress(pc), NO_CALLER, 0, sp, total});
+	}
+	currentFunction = stack.back().function;
+}
+
+void CPUProfiler::endStep(word pc, word sp, EmuTime::param time,
+                          EmuDuration::param period, bool instruction)
+{
+	if (!inStep) return; // started or stopped in the middle of a step
+	inStep = false;
+
+	if (period.length() != periodDivMod.getDivisor()) {
+		setPeriod(period);
+	}
+	auto index = beginPC & (REGION_SIZE - 1);
+	Address beginAddress = beginRegion->base | index;
+	uint64_t instructions = instruction ? 1 : 0;
+	auto duration = (time - beginTime).length();
+	auto& owner = beginRegion->function[index];
+	if (owner == NO_CALLER) owner = currentFunction;
+	if (owner == currentFunction) {
+		auto& self = beginRegion->cost[index];
+		self.instructions += instructions;
+		self.cycles       += duration;
+	} else {
+		auto& self = selfCosts[(uint64_t(currentFunction) << 32) | beginAddress];
+		self.instructions += instructions;
+		self.cycles       += periodDivMod.div(duration);
+	}
+	// also includes the steps counted by nextStep()
+	total.instructions += instructions;
+	total.cycles       += periodDivMod.div((time - totalTime).length());
+
+	if (word(pc - beginPC) <= 4) return; // no jump (or a repeating LDIR)
+
+	// A jump that pushed the address of (the instruction after) itself
+	// is a call. This also catches the acceptance of an interrupt.
+	bool call = false;
+	if (sp == word(beginSP - 2)) {
+		word ret = interface->peekMem(sp, time) |
+		          (interface->peekMem(word(sp + 1), time) << 8);
+		call = word(ret - beginPC) <= 4;
+	}
+
+	// Leave the calls of which the return address was popped from the
+	// stack (for a call: overwritten).
+	while (!stack.empty() &&
+	       ((stack.back().sp < sp) || (call && (stack.back().sp == sp)))) {
+		leaveCall(callCosts, stack.back());
+		stack.pop_back();
+	}
+	if (call) {
+		if (stack.size() == MAX_DEPTH) {
+			stack.erase(stack.begin());
+		}
+		stack.push_back(Frame{getAddress(pc), currentFunction, beginAddress, sp, total});
+	}
+}
+
+void CPUProfiler::nextStepSlow(word pc, word sp, EmuTime::param time,
+                               EmuDuration::param period)
+{
+	endStep(pc, sp, time, period, true);
+	beginStep(pc, sp, time);
+}
+
+void CPUProfiler::setPeriod(EmuDuration::param period)
+{
+	// E.g. the CPU frequency was changed. Convert what was counted with
+	// the old period first.
+	flushRegions();
+	total.cycles += periodDivMod.div((beginTime - totalTime).length());
+	totalTime = beginTime;
+	periodDivMod.setDivisor(period.length());
+}
+
+void CPUProfiler::flushRegions()
+{
+	// move the costs of the regions to 'selfCosts'
+	auto period = periodDivMod.getDivisor();
+	for (auto& [base, region] : regions) {
+		for (unsigned i = 0; i < REGION_SIZE; ++i) {
+			auto function = region->function[i];
+			if (function == NO_CALLER) continue;
+			auto& cost = region->cost[i];
+			auto& self = selfCosts[(uint64_t(function) << 32) | region->base | i];
+			self.instructions += cost.instructions;
+			self.cycles       += cost.cycles / period;
+			cost = Cost();
+		}
+	}
+}
+
+void CPUProfiler::leaveCall(CallCosts& costs, const Frame& frame) const
+{
+	if (frame.caller == NO_CALLER) return;
+	auto& cost = costs[CallKey{frame.caller, frame.callSite, frame.function}];
+	++cost.calls;
+	cost.inclusive.instructions += total.instructions - frame.start.instructions;
+	cost.inclusive.cycles       += total.cycles       - frame.start.cycles;
+}
+
+CPUProfiler::CallCosts CPUProfiler::getCallCosts() const
+{
+	// include the calls that are still in progress
+	auto result = callCosts;
+	for (auto& frame : stack) {
+		leaveCall(result, frame);
+	}
+	return result;
+}
+
+hash_map<uint64_t, CPUProfiler::Cost> CPUProfiler::getSelfCosts() const
+{
+	// include the costs that are counted per region, like flushRegions()
+	auto result = selfCosts;
+	auto period = periodDivMod.getDivisor();
+	for (auto& [base, region] : regions) {
+		for (unsigned i = 0; i < REGION_SIZE; ++i) {
+			auto function = region->function[i];
+			if (function == NO_CALLER) continue;
+			auto& cost = result[(uint64_t(function) << 32) | region->base | i];
+			cost.instructions += region->cost[i].instructions;
+			cost.cycles       += region->cost[i].cycles / period;
+		}
+	}
+	return result;
+}
+
+void CPUProfiler::start()
+{
+	regions.clear();
+	invalidateRegions();
+	selfCosts.clear();
+	callCosts.clear();
+	stack.clear();
+	total = Cost();
+	inStep = false;
+	interface = &motherBoard.getCPUInterface();
+	active = true;
+	cpu.exitCPULoopSync();
+}
+
+void CPUProfiler::stop()
+{
+	if (!active) return;
+	leaveAllCalls();
+	inStep = false;
+	active = false;
+	cpu.exitCPULoopSync();
+}
+
+void CPUProfiler::transfer(CPUProfiler& other)
+{
+	other.leaveAllCalls();
+	other.flushRegions(); // counted with the period of the other CPU
+	regions = std::move(other.regions);
+	invalidateRegions();
+	selfCosts = std::move(other.selfCosts);
+	callCosts = std::move(other.callCosts);
+	total = other.total;
+	symbols = std::move(other.symbols);
+	if (other.interface) {
+		interface = &motherBoard.getCPUInterface();
+	}
+	active = other.active;
+	// the CPU of the new machine isn't running yet
+}
+
+void CPUProfiler::leaveAllCalls()
+{
+	while (!stack.empty()) {
+		leaveCall(callCosts, stack.back());
+		stack.pop_back();
+	}
+}
+
+// Parse a value from a symbol file: decimal, or hexadecimal with a '0x',
+// '$' or '#' prefix or a 'h' suffix. Only values that fit in 16 bits.
+static std::optional<word> parseValue(std::string_view str)
+{
+	unsigned base = 10;
+	if (StringOp::startsWith(str, "0x") || StringOp::startsWith(str, "0X")) {
+		str.remove_prefix(2);
+		base = 16;
+	} else if (StringOp::startsWith(str, '$') || StringOp::startsWith(str, '#')) {
+		str.remove_prefix(1);
+		base = 16;
+	} else if (StringOp::endsWith(str, 'h') || StringOp::endsWith(str, 'H')) {
+		str.remove_suffix(1);
+		base = 16;
+	}
+	if (str.empty()) return {};
+	unsigned result = 0;
+	for (char c : str) {
+		unsigned digit;
+		if (('0' <= c) && (c <= '9')) {
+			digit = c - '0';
+		} else if ((base == 16) && ('a' <= c) && (c <= 'f')) {
+			digit = c - 'a' + 10;
+		} else if ((base == 16) && ('A' <= c) && (c <= 'F')) {
+			digit = c - 'A' + 10;
+		} else {
+			return {};
+		}
+		result = result * base + digit;
+		if (result > 0xFFFF) return {};
+	}
+	return word(result);
+}
+
+static std::string_view nextToken(std::string_view& line)
+{
+	StringOp::trimLeft(line, " \t");
+	auto end = line.find_first_of(" \t");
+	auto result = line.substr(0, end);
+	line.remove_prefix(result.size());
+	return result;
+}
+
+void CPUProfiler::loadSymbols(const std::string& filename)
+{
+	// Accepts lines like
+	//   name: equ 0x4010   (sjasm, sjasmplus)
+	//   name: equ 4010h    (tniasm)
+	//   name = $4010
+	// other lines (comments, non-address values) are ignored.
+	File file(userFileContext().resolve(filename));
+	auto buf = file.mmap();
+	std::string_view text(reinterpret_cast<const char*>(buf.data()), buf.size());
+	unsigned num = 0;
+	for (auto line : StringOp::split(text, '\n')) {
+		StringOp::trim(line, " \t\r");
+		if (line.empty() || (line[0] == ';')) continue;
+		auto name = nextToken(line);
+		StringOp::trimRight(name, ':');
+		auto op = nextToken(line);
+		auto value = parseValue(nextToken(line));
+		if (name.empty() || !value || !nextToken(line).empty() ||
+		    !(StringOp::casecmp()(op, "equ") || (op == "=") || (op == ":="))) {
+			continue;
+		}
+		symbols.emplace_back(*value, std::string(name));
+		++num;
+	}
+	if (num == 0) {
+		throw CommandException("No symbols found in ", filename);
+	}
+	// stable: with several names for the same address, the first is used
+	ranges::stable_sort(symbols, LessTupleElement<0>());
+}
+
+std::string CPUProfiler::getSlotName(Address address) const
+{
+	int slot = address >> 25;
+	int segment = int((address >> 16) & 0x1FF) - 1;
+	int ps = slot / 4;
+	auto result = interface->isExpanded(ps)
+	            ? strCat("slot ", ps, '-', slot % 4)
+	            : strCat("slot ", ps);
+	if (segment != -1) strAppend(result, " segment ", segment);
+	return result;
+}
+
+std::string CPUProfiler::getFunctionName(Address function) const
+{
+	auto address = word(function);
+	auto it = ranges::upper_bound(symbols, address, LessTupleElement<0>());
+	if (it != begin(symbols)) {
+		auto symbolAddress = std::prev(it)->first;
+		auto offset = unsigned(address - symbolAddress);
+		if (offset < MAX_SYMBOL_OFFSET) {
+			auto& name = ranges::lower_bound(symbols, symbolAddress, LessTupleElement<0>())->second;
+			if (offset == 0) return name;
+			return strCat(name, "+0x", hex_string<2>(offset));
+		}
+	}
+	return strCat(getSlotName(function), ":0x", hex_string<4>(address));
+}
+
+template<typename Map>
+static auto sortedCosts(const Map& map)
+{
+	std::vector<typename Map::value_type> result;
+	result.reserve(map.size());
+	for (auto& entry : map) result.push_back(entry);
+	ranges::sort(result, LessTupleElement<0>());
+	return result;
+}
+
+void CPUProfiler::getFlat(unsigned count, TclObject& result) const
+{
+	hash_map<Address, Cost> functions;
+	for (auto& [key, cost] : getSelfCosts()) {
+		auto& c = functions[Address(key >> 32)];
+		c.instructions += cost.instructions;
+		c.cycles       += cost.cycles;
+	}
+	auto sorted = sortedCosts(functions);
+	ranges::stable_sort(sorted, [](auto& x, auto& y) {
+		return x.second.cycles > y.second.cycles;
+	});
+	if (sorted.size() > count) sorted.resize(count);
+	for (auto& [function, cost] : sorted) {
+		result.addListElement(makeTclList(
+			getFunctionName(function), getSlotName(function),
+			std::to_string(cost.instructions),
+			std::to_string(cost.cycles)));
+	}
+}
+
+void CPUProfiler::getAddresses(unsigned count, TclObject& result) const
+{
+	hash_map<Address, Cost> addresses;
+	for (auto& [key, cost] : getSelfCosts()) {
+		auto& c = addresses[Address(key)];
+		c.instructions += cost.instructions;
+		c.cycles       += cost.cycles;
+	}
+	auto sorted = sortedCosts(addresses);
+	ranges::stable_sort(sorted, [](auto& x, auto& y) {
+		return x.second.cycles > y.second.cycles;
+	});
+	if (sorted.size() > count) sorted.resize(count);
+	for (auto& [address, cost] : sorted) {
+		result.addListElement(makeTclList(
+			getSlotName(address), int(word(address)),
+			std::to_string(cost.instructions),
+			std::to_string(cost.cycles)));
+	}
+}
+
+void CPUProfiler::saveCallgrind(const std::string& filename) const
+{
+	// Both sorted on function (caller) first.
+	auto self = sortedCosts(getSelfCosts());
+	auto calls = sortedCosts(getCallCosts());
+
+	std::ofstream file;
+	FileOperations::openofstream(file, filename);
+	if (!file.is_open()) {
+		throw CommandException("Couldn't open ", filename, " for writing.");
+	}
+	file << "# callgrind format\n"
+	        "version: 1\n"
+	        "creator: openMSX\n"
+	        "positions: instr\n"
+	        "events: Instructions Cycles\n"
+	     << "summary: " << total.instructions << ' ' << total.cycles << '\n';
+
+	auto position = [](Address address) {
+		return strCat("0x", hex_string<4>(word(address)));
+	};
+	std::string currentFile;
+	auto setFile = [&](Address address) {
+		auto name = getSlotName(address);
+		if (name != currentFile) {
+			file << "fi=" << name << '\n';
+			currentFile = std::move(name);
+		}
+	};
+
+	auto s = begin(self);
+	auto c = begin(calls);
+	while ((s != end(self)) || (c != end(calls))) {
+		// Every caller also has a self cost (for the call instruction),
+		// except for calls that are still in progress after 'start'.
+		auto function = (s != end(self)) ? Address(s->first >> 32)
+		                                 : c->first.caller;
+		if ((c != end(calls)) && (c->first.caller < function)) {
+			function = c->first.caller;
+		}
+		currentFile = getSlotName(function);
+		file << "\nfl=" << currentFile << '\n'
+		     << "fn=" << getFunctionName(function) << '\n';
+		for (; (s != end(self)) && (Address(s->first >> 32) == function); ++s) {
+			auto address = Address(s->first);
+			setFile(address);
+			file << position(address) << ' '
+			     << s->second.instructions << ' '
+			     << s->second.cycles << '\n';
+		}
+		for (; (c != end(calls)) && (c->first.caller == function); ++c) {
+			auto callSite = c->first.callSite;
+			auto callee   = c->first.callee;
+			auto& cost = c->second;
+			setFile(callSite);
+			file << "cfi=" << getSlotName(callee) << '\n'
+			     << "cfn=" << getFunctionName(callee) << '\n'
+			     << "calls=" << cost.calls << ' ' << position(callee) << '\n'
+			     << position(callSite) << ' '
+			     << cost.inclusive.instructions << ' '
+			     << cost.inclusive.cycles << '\n';
+		}
+	}
+	if (!file) {
+		throw CommandException("Error while writing ", filename);
+	}
+}
+
+
+// class ProfileCmd
+
+CPUProfiler::ProfileCmd::ProfileCmd(CommandController& controller)
+	: Command(controller, "profile")
+{
+}
+
+void CPUProfiler::ProfileCmd::execute(span<const TclObject> tokens, TclObject& result)
+{
+	checkNumArgs(tokens, AtLeast{2}, "subcommand ?arg ...?");
+	auto& profiler = OUTER(CPUProfiler, profileCmd);
+	auto& interp = getInterpreter();
+	auto getCount = [&] {
+		checkNumArgs(tokens, Between{2, 3}, Prefix{2}, "?count?");
+		if (tokens.size() == 2) return unsigned(-1);
+		int count = tokens[2].getInt(interp);
+		if (count < 0) throw CommandException("Count must be positive.");
+		return unsigned(count);
+	};
+	executeSubCommand(tokens[1].getString(),
+		"start",  [&]{ profiler.start(); },
+		"stop",   [&]{ profiler.stop(); },
+		"status", [&]{
+			result.addDictKeyValues(
+				"active", profiler.isActive(),
+				"instructions", std::to_string(profiler.total.instructions),
+				"cycles", std::to_string(profiler.total.cycles),
+				"symbols", unsigned(profiler.symbols.size()));
+			},
+		"flat",      [&]{ profiler.getFlat(getCount(), result); },
+		"addresses", [&]{ profiler.getAddresses(getCount(), result); },
+		"save", [&]{
+			checkNumArgs(tokens, 3, Prefix{2}, "filename");
+			if (!profiler.interface) {
+				throw CommandException("Nothing profiled yet.");
+			}
+			profiler.saveCallgrind(FileOperations::expandTilde(
+				tokens[2].getString()));
+			},
+		"loadsymbols", [&]{
+			checkNumArgs(tokens, 3, Prefix{2}, "filename");
+			try {
+				profiler.loadSymbols(std::string(tokens[2].getString()));
+			} catch (MSXException& e) {
+				throw CommandException(e.getMessage());
+			}
+			},
+		"clearsymbols", [&]{ profiler.symbols.clear(); });
+}
+
+std::string CPUProfiler::ProfileCmd::help(const std::vector<std::string>& /*tokens*/) const
+{
+	return "Profiles the emulated program: counts the executed instructions and CPU\n"
+	       "cycles per address and per routine, and which routine called which.\n"
+	       "start                start profiling, discards earlier results\n"
+	       "stop                 stop profiling, the results are kept\n"
+	       "status               show whether the profiler is active and the totals\n"
+	       "flat ?count?         list {name slot instructions cycles} per routine, most cycles first\n"
+	       "addresses ?count?    list {slot address instructions cycles} per address, most cycles first\n"
+	       "save <filename>      save the results (with call graph) in the callgrind format\n"
+	       "loadsymbols <file>   load symbols to name routines (sjasm or tniasm symbol file)\n"
+	       "clearsymbols         forget all symbols\n";
+}
+
+void CPUProfiler::ProfileCmd::tabCompletion(std::vector<std::string>& tokens) const
+{
+	if (tokens.size() == 2) {
+		static constexpr const char* const subCommands[] = {
+			"start", "stop", "status", "flat", "addresses",
+			"save", "loadsymbols", "clearsymbols",
+		};
+		completeString(tokens, subCommands);
+	} else if ((tokens.size() == 3) &&
+	           ((tokens[1] == "save") || (tokens[1] == "loadsymbols"))) {
+		completeFileName(tokens, userFileContext());
+	}
+}
+
+} // namespace openmsx
@@ -0,0 +1,216 @@
+#ifndef CPUPROFILER_HH
+#define CPUPROFILER_HH
+
+#include "Command.hh"
+#include "DivModBySame.hh"
+#include "EmuTime.hh"
+#include "hash_map.hh"
+#include "likely.hh"
+#include "openmsx.hh"
+#include "span.hh"
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace openmsx {
+
+class MSXMotherBoard;
+class MSXCPU;
+class MSXCPUInterface;
+class TclObject;
+
+/** Counts the executed instructions and CPU cycles per address of the
+  * emulated program, and which routine called which other routine.
+  *
+  * Addresses are combined with the slot they are visible in and, for ROM
+  * mappers and memory mappers, the selected segment. Calls are
+  * recognized by watching the stack: a jump that pushes the address of
+  * the next instruction is a call (this includes interrupts). A call ends
+  * at the first jump after which the stack pointer is above the pushed
+  * return address. So also routines that drop their return address are
+  * handled.
+  *
+  * The result can be written in the callgrind format and browsed with
+  * e.g. KCachegrind. Symbols (as written by assemblers like sjasm and
+  * tniasm) are used to name the routines.
+  *
+  * The bookkeeping for every executed instruction makes the CPU emulation
+  * about 2.5x slower while the profiler is running. Most instructions only
+  * update a counter in a table that is indexed on address, the hash maps
+  * are only used for jumps and for code that is shared between routines.
+  */
+class CPUProfiler
+{
+public:
+	CPUProfiler(MSXMotherBoard& motherBoard, MSXCPU& cpu);
+
+	[[nodiscard]] bool isActive() const { return active; }
+
+	/** Continue the profile of the (old) machine that is replaced by this
+	  * one, after a reverse goto. The calls that were in progress are
+	  * ended, they can't return in the new machine state.
+	  */
+	void transfer(CPUProfiler& other);
+
+	/** Called before and after each step of the CPU: an instruction,
+	  * the acceptance of an interrupt or a period in HALT state.
+	  * @param period The duration of one CPU cycle.
+	  * @param instruction Was the step an instruction?
+	  */
+	void beginStep(word pc, word sp, EmuTime::param time);
+	void endStep(word pc, word sp, EmuTime::param time,
+	             EmuDuration::param period, bool instruction);
+
+	/** Called between two instructions: the same as endStep() followed
+	  * by beginStep(). Inline for the common case, an instruction that
+	  * didn't jump and of which the address was (so far) only executed
+	  * as part of the current routine.
+	  */
+	void nextStep(word pc, word sp, EmuTime::param time,
+	              EmuDuration::param period)
+	{
+		auto index = beginPC & (REGION_SIZE - 1);
+		auto* nextRegion = visibleRegions[pc >> REGION_BITS];
+		if (likely(inStep && nextRegion && (word(pc - beginPC) <= 4) &&
+		           (beginRegion->function[index] == currentFunction) &&
+		           (period.length() == periodDivMod.getDivisor()))) {
+			auto& cost = beginRegion->cost[index];
+			++cost.instructions;
+			cost.cycles += (time - beginTime).length();
+			++total.instructions; // 'total.cycles' is updated in endStep()
+			beginTime = time;
+			beginRegion = nextRegion;
+			beginPC = pc;
+			beginSP = sp;
+		} else {
+			nextStepSlow(pc, sp, time, period);
+		}
+	}
+
+	/** Called when the memory that is visible to the CPU may have
+	  * changed: a different slot or segment is selected.
+	  */
+	void invalidateRegions() { visibleRegions.fill(nullptr); }
+
+private:
+	// slot << 25 | (segment + 1) << 16 | address, the slot is 4 * primary
+	// + secondary, the segment is -1 for memory without segments
+	using Address = uint32_t;
+	static constexpr Address NO_CALLER = Address(-1);
+
+	struct Cost {
+		uint64_t instructions = 0;
+		uint64_t cycles = 0;
+	};
+	struct CallCost {
+		uint64_t calls = 0;
+		Cost inclusive;
+	};
+	struct Frame {
+		Address function; // entry point
+		Address caller;   // function that made the call, or NO_CALLER
+		Address callSite;
+		word sp;          // stack pointer right after the call
+		Cost start;       // 'total' at the moment of the call
+	};
+	struct CallKey {
+		Address caller;
+		Address callSite;
+		Address callee;
+
+		[[nodiscard]] bool operator==(const CallKey& other) const {
+			return std::tie(caller, callSite, callee) ==
+			       std::tie(other.caller, other.callSite, other.callee);
+		}
+		[[nodiscard]] bool operator<(const CallKey& other) const {
+			return std::tie(caller, callSite, callee) <
+			       std::tie(other.caller, other.callSite, other.callee);
+		}
+	};
+	struct HashCallKey {
+		auto operator()(const CallKey& k) const {
+			std::hash<Address> subHasher;
+			return 961 * subHasher(k.caller) + 31 * subHasher(k.callSite)
+			           + subHasher(k.callee);
+		}
+	};
+	using CallCosts = hash_map<CallKey, CallCost, HashCallKey>;
+
+	// The self costs of the addresses in one region of memory (in one
+	// slot and segment). Most addresses only execute as part of a single
+	// routine, their costs are counted here. When an address also
+	// executes as part of other routines, those costs go to 'selfCosts'.
+	// To avoid a division per instruction, 'cycles' is counted here as a
+	// duration (in EmuTime units), see flushRegions().
+	static constexpr unsigned REGION_BITS = 12;
+	static constexpr unsigned REGION_SIZE = 1 << REGION_BITS;
+	struct Region {
+		explicit Region(Address base_);
+
+		Address base; // address of the first byte
+		std::array<Address, REGION_SIZE> function; // NO_CALLER: not executed
+		std::array<Cost, REGION_SIZE> cost;
+	};
+
+	void nextStepSlow(word pc, word sp, EmuTime::param time,
+	                  EmuDuration::param period);
+	void setPeriod(EmuDuration::param period);
+	void flushRegions();
+	void start();
+	void stop();
+	void leaveAllCalls();
+	void leaveCall(CallCosts& costs, const Frame& frame) const;
+	[[nodiscard]] CallCosts getCallCosts() const;
+	[[nodiscard]] hash_map<uint64_t, Cost> getSelfCosts() const;
+	[[nodiscard]] Region& getRegion(word address);
+	[[nodiscard]] Region& findRegion(word address);
+	[[nodiscard]] Address getAddress(word address);
+
+	void loadSymbols(const std::string& filename);
+	[[nodiscard]] std::string getSlotName(Address address) const;
+	[[nodiscard]] std::string getFunctionName(Address function) const;
+	void getFlat(unsigned count, TclObject& result) const;
+	void getAddresses(unsigned count, TclObject& result) const;
+	void saveCallgrind(const std::string& filename) const;
+
+	MSXMotherBoard& motherBoard;
+	MSXCPU& cpu;
+	MSXCPUInterface* interface = nullptr;
+
+	hash_map<Address, std::unique_ptr<Region>> regions; // on 'base'
+	// per REGION_SIZE addresses of the CPU, nullptr: not looked up yet
+	std::array<Region*, 0x10000 / REGION_SIZE> visibleRegions = {};
+	hash_map<uint64_t, Cost> selfCosts; // function << 32 | address
+	CallCosts callCosts;
+	std::vector<Frame> stack;
+	Cost total;
+
+	// the step in progress, see beginStep()
+	EmuTime beginTime = EmuTime::zero();
+	EmuTime totalTime = EmuTime::zero(); // 'total.cycles' is up to here
+	Region* beginRegion = nullptr;
+	word beginPC = 0;
+	Address currentFunction = NO_CALLER; // stack.back().function
+	word beginSP = 0;
+	bool inStep = false;
+	DivModBySame periodDivMod; // divides by the duration of a CPU cycle
+
+	std::vector<std::pair<word, std::string>> symbols; // sorted on address
+	bool active = false;
+
+	struct ProfileCmd final : Command {
+		explicit ProfileCmd(CommandController& controller);
+		void execute(span<const TclObject> tokens, TclObject& result) override;
+		std::string help(const std::vector<std::string>& tokens) const override;
+		void tabCompletion(std::vector<std::string>& tokens) const override;
+	} profileCmd;
+};
+
+} // namespace openmsx
+
+#endif
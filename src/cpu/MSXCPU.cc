@@ -25,15 +25,16 @@ MSXCPU::MSXCPU(MSXMotherBoard& motherboard_)
 	, traceSetting(
 		motherboard.getCommandController(), "cputrace",
 		"CPU tracing on/off", false, Setting::DONT_SAVE)
+	, profiler(motherboard, *this)
 	, diHaltCallback(
 		motherboard.getCommandController(), "di_halt_callback",
 		"Tcl proc called when the CPU executed a DI/HALT sequence")
 	, z80(std::make_unique<CPUCore<Z80TYPE>>(
-		motherboard, "z80", traceSetting,
+		motherboard, "z80", traceSetting, profiler,
 		diHaltCallback, EmuTime::zero()))
 	, r800(motherboard.isTurboR()
 		? std::make_unique<CPUCore<R800TYPE>>(
-			motherboard, "r800", traceSetting,
+			motherboard, "r800", traceSetting, profiler,
 			diHaltCallback, EmuTime::zero())
 		: nullptr)
 	, timeInfo(motherboard.getMachineInfoCommand())
@@ -153,6 +154,8 @@ void MSXCPU::setNextSyncPoint(EmuTime::param time)
 void MSXCPU::invalidateMemCacheSlot()
 {
 	ranges::fill(slots, 0);
+	forgetRCacheConfigs();
+	profiler.invalidateRegions();
 
 	// nullptr: means not a valid entry and not yet attempted to fill this entry
 	for (int i = 0; i < 16; ++i) {
@@ -177,6 +180,7 @@ void MSXCPU::updateVisiblePage(byte page, byte primarySlot, byte secondarySlot)
 	std::copy_n(&slotWriteLines[to][first], num, &cpuWriteLines       [first]);
 
 	if (r800) r800->updateVisiblePage(page, primarySlot, secondarySlot);
+	profiler.invalidateRegions();
 }
 
 void MSXCPU::invalidateAllSlotsRWCache(word start, unsigned size)
@@ -193,6 +197,18 @@ void MSXCPU::invalidateAllSlotsRWCache(word start, unsigned size)
 		std::fill_n(slotReadLines[i] + first, num, nullptr);
 		std::fill_n(slotWriteLines[i] + first, num, nullptr);
 	}
+	forgetRCacheConfigs();
+	profiler.invalidateRegions();
+}
+
+// select between 'active' or 'shadow' cache lines
+std::pair<const byte**, byte**> MSXCPU::getSlotCacheLines(int slot, unsigned page)
+{
+	if (slot == slots[page]) {
+		return z80Active ? z80->getCacheLines() : r800->getCacheLines();
+	} else {
+		return {slotReadLines[slot], slotWriteLines[slot]};
+	}
 }
 
 template<bool READ, bool WRITE, bool SUB_START>
@@ -214,17 +230,7 @@ void MSXCPU::setRWCache(unsigned start, unsigned size, const byte* rData, byte*
 	if (SUB_START && READ)  rData -= start;
 	if (SUB_START && WRITE) wData -= start;
 
-	// select between 'active' or 'shadow' cache lines
-	const byte** readLines;
-	      byte** writeLines;
-	if (slot == slots[page]) {
-		auto cache = z80Active ? z80->getCacheLines() : r800->getCacheLines();
-		readLines  = cache.first;
-		writeLines = cache.second;
-	} else {
-		readLines  = slotReadLines [slot];
-		writeLines = slotWriteLines[slot];
-	}
+	auto [readLines, writeLines] = getSlotCacheLines(slot, page);
 
 	unsigned first = start / CacheLine::SIZE;
 	readLines     += first;
@@ -238,6 +244,8 @@ void MSXCPU::setRWCache(unsigned start, unsigned size, const byte* rData, byte*
 		if (READ)  readLines [i] = disallowRead [i] ? NON_CACHEABLE : rData;
 		if (WRITE) writeLines[i] = disallowWrite[i] ? NON_CACHEABLE : wData;
 	}
+	// e.g. a mapper selected another segment
+	profiler.invalidateRegions();
 }
 
 void MSXCPU::invalidateRWCache(unsigned start, unsigned size, int ps, int ss,
@@ -272,6 +280,43 @@ void MSXCPU::fillWCache(unsigned start, unsigned size, byte* wData, int ps, int
 	setRWCache<false, true, true>(start, size, nullptr, wData, ps, ss, nullptr, disallowWrite);
 }
 
+bool MSXCPU::switchRCache(unsigned start, unsigned size, unsigned oldConfig,
+                          unsigned newConfig, int ps, int ss)
+{
+	// aligned on cache lines
+	assert((start & CacheLine::LOW) == 0);
+	assert((size  & CacheLine::LOW) == 0);
+
+	profiler.invalidateRegions();
+
+	int slot = 4 * ps + ss;
+	unsigned page = start >> 14;
+	assert(((start + size - 1) >> 14) == page); // all in same page
+	unsigned first = start / CacheLine::SIZE;
+	unsigned num = size / CacheLine::SIZE;
+	auto key = [&](unsigned config) {
+		return uint64_t(config) | (uint64_t(slot) << 32) |
+		       (uint64_t(first) << 36) | (uint64_t(num) << 44);
+	};
+	auto readLines = getSlotCacheLines(slot, page).first + first;
+
+	// Limit memory usage, a device typically only uses a few dozen
+	// configurations.
+	if (rCacheConfigs.size() >= 1024) forgetRCacheConfigs();
+	std::copy_n(readLines, num, rCacheConfigs[key(oldConfig)].data());
+
+	if (newConfig == oldConfig) return true;
+	auto* lines = lookup(rCacheConfigs, key(newConfig));
+	if (!lines) return false;
+	std::copy_n(lines->data(), num, readLines);
+	return true;
+}
+
+void MSXCPU::forgetRCacheConfigs()
+{
+	rCacheConfigs.clear();
+}
+
 void MSXCPU::raiseIRQ()
 {
 	          z80 ->raiseIRQ();
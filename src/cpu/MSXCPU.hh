@@ -1,6 +1,7 @@
 #ifndef MSXCPU_HH
 #define MSXCPU_HH
 
+#include "CPUProfiler.hh"
 #include "InfoTopic.hh"
 #include "SimpleDebuggable.hh"
 #include "Observer.hh"
@@ -11,7 +12,11 @@
 #include "serialize_meta.hh"
 #include "openmsx.hh"
 #include "span.hh"
+#include "hash_map.hh"
+#include <array>
+#include <cstdint>
 #include <memory>
+#include <utility>
 
 namespace openmsx {
 
@@ -82,6 +87,25 @@ public:
 	void fillWCache (unsigned start, unsigned size, byte* wData, int ps, int ss,
                          const byte* disallowWrite);
 
+	/** For devices that switch a region between a limited set of
+	 * configurations (e.g. the selected bank of a megaROM). The current
+	 * read cache lines of the interval [start, start + size) in the given
+	 * slot are remembered as belonging to 'oldConfig'. When lines for
+	 * 'newConfig' were remembered before, they are restored in one go
+	 * (instead of being filled again line per line) and this method
+	 * returns true. Otherwise it returns false, and the caller must still
+	 * invalidate or fill that interval itself.
+	 * The configuration number must capture all state of the device that
+	 * influences its getReadCacheLine() result in this interval.
+	 * Changes that affect the cache lines of all slots (watchpoints,
+	 * (un)registering devices, ...) forget all remembered lines.
+	 */
+	bool switchRCache(unsigned start, unsigned size, unsigned oldConfig,
+	                  unsigned newConfig, int ps, int ss);
+
+	/** Forget all lines remembered by switchRCache(). */
+	void forgetRCacheConfigs();
+
 	/** This method raises a maskable interrupt. A device may call this
 	  * method more than once. If the device wants to lower the
 	  * interrupt again it must call the lowerIRQ() method exactly as
@@ -144,6 +168,8 @@ public:
 
 	CPURegs& getRegisters();
 
+	CPUProfiler& getProfiler() { return profiler; }
+
 	template<typename Archive>
 	void serialize(Archive& ar, unsigned version);
 
@@ -164,6 +190,8 @@ private:
 	// Observer<Setting>
 	void update(const Setting& setting) override;
 
+	std::pair<const byte**, byte**> getSlotCacheLines(int slot, unsigned page);
+
 	template<bool READ, bool WRITE, bool SUB_START>
 	void setRWCache(unsigned start, unsigned size, const byte* rData, byte* wData, int ps, int ss,
 	                const byte* disallowRead, const byte* disallowWrite);
@@ -171,6 +199,7 @@ private:
 private:
 	MSXMotherBoard& motherboard;
 	BooleanSetting traceSetting;
+	CPUProfiler profiler; // shared by both CPUs
 	TclCallback diHaltCallback;
 	const std::unique_ptr<CPUCore<Z80TYPE>> z80;
 	const std::unique_ptr<CPUCore<R800TYPE>> r800; // can be nullptr
@@ -179,6 +208,11 @@ private:
 	      byte* slotWriteLines[16][CacheLine::NUM];
 	byte slots[4]; // active slot for page (= 4 * primSlot + secSlot)
 
+	// Read cache lines remembered by switchRCache(), not serialized.
+	//   key: see switchRCache(), value: at most one page of lines
+	using RCacheConfig = std::array<const byte*, 0x4000 / CacheLine::SIZE>;
+	hash_map<uint64_t, RCacheConfig> rCacheConfigs;
+
 	struct TimeInfoTopic final : InfoTopic {
 		explicit TimeInfoTopic(InfoCommand& machineInfoCommand);
 		void execute(span<const TclObject> tokens,
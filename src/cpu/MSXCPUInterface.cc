@@ -69,6 +69,7 @@ std::ostream& operator<<(std::ostream& os, EnumValueName<CacheLineCounters> evn)
 		"FillReadWrite",
 		"FillRead",
 		"FillWrite",
+		"SwitchRead",
 	};
 	return os << names[size_t(evn.e)];
 }
@@ -124,6 +125,7 @@ MSXCPUInterface::MSXCPUInterface(MSXMotherBoard& motherBoard_)
 			IO_Out[port] = delayDevice.get();
 		}
 	}
+	updateIOHandlers();
 
 	if (breakedSettingCount++ == 0) {
 		assert(!breakedSetting);
@@ -242,6 +244,48 @@ void MSXCPUInterface::writeMemSlow(word address, byte value, EmuTime::param time
 	}
 }
 
+template<typename GlobalRwInfos>
+static void calcExceptions(byte disallow, word start,
+                           const std::bitset<CacheLine::SIZE>& watchSet,
+                           const GlobalRwInfos& globals,
+                           std::bitset<CacheLine::SIZE>& exceptions)
+{
+	if (disallow & SECONDARY_SLOT_BIT) {
+		assert(start == (0xFFFF & CacheLine::HIGH));
+		exceptions.set(0xFFFF & CacheLine::LOW);
+	}
+	if (disallow & MEMORY_WATCH_BIT) {
+		exceptions |= watchSet;
+	}
+	if (disallow & GLOBAL_RW_BIT) {
+		for (auto& g : globals) {
+			if ((g.addr & CacheLine::HIGH) == start) {
+				exceptions.set(g.addr & CacheLine::LOW);
+			}
+		}
+	}
+}
+
+const byte* MSXCPUInterface::getReadCacheLinePartial(
+	word start, std::bitset<CacheLine::SIZE>& exceptions) const
+{
+	exceptions.reset();
+	unsigned line = start >> CacheLine::BITS;
+	calcExceptions(disallowReadCache[line], start, readWatchSet[line],
+	               globalReads, exceptions);
+	return visibleDevices[start >> 14]->getReadCacheLinePartial(start, exceptions);
+}
+
+byte* MSXCPUInterface::getWriteCacheLinePartial(
+	word start, std::bitset<CacheLine::SIZE>& exceptions) const
+{
+	exceptions.reset();
+	unsigned line = start >> CacheLine::BITS;
+	calcExceptions(disallowWriteCache[line], start, writeWatchSet[line],
+	               globalWrites, exceptions);
+	return visibleDevices[start >> 14]->getWriteCacheLine(start);
+}
+
 void MSXCPUInterface::setExpanded(int ps)
 {
 	if (expanded[ps] == 0) {
@@ -339,24 +383,28 @@ void MSXCPUInterface::register_IO_In(byte port, MSXDevice* device)
 {
 	MSXDevice*& devicePtr = getDevicePtr(port, true); // in
 	register_IO(port, true, devicePtr, device); // in
+	updateIOHandlers();
 }
 
 void MSXCPUInterface::unregister_IO_In(byte port, MSXDevice* device)
 {
 	MSXDevice*& devicePtr = getDevicePtr(port, true); // in
 	unregister_IO(devicePtr, device);
+	updateIOHandlers();
 }
 
 void MSXCPUInterface::register_IO_Out(byte port, MSXDevice* device)
 {
 	MSXDevice*& devicePtr = getDevicePtr(port, false); // out
 	register_IO(port, false, devicePtr, device); // out
+	updateIOHandlers();
 }
 
 void MSXCPUInterface::unregister_IO_Out(byte port, MSXDevice* device)
 {
 	MSXDevice*& devicePtr = getDevicePtr(port, false); // out
 	unregister_IO(devicePtr, device);
+	updateIOHandlers();
 }
 
 void MSXCPUInterface::register_IO(int port, bool isIn,
@@ -413,6 +461,7 @@ bool MSXCPUInterface::replace_IO_In(
 		return false;
 	}
 	devicePtr = newDevice;
+	updateIOHandlers();
 	return true;
 }
 bool MSXCPUInterface::replace_IO_Out(
@@ -424,9 +473,52 @@ bool MSXCPUInterface::replace_IO_Out(
 		return false;
 	}
 	devicePtr = newDevice;
+	updateIOHandlers();
 	return true;
 }
 
+void MSXCPUInterface::registerFastIO(
+	MSXDevice& device, IOReadHandler read, IOWriteHandler write)
+{
+	assert(ranges::none_of(fastIOHandlers,
+		[&](auto& f) { return f.device == &device; }));
+	fastIOHandlers.push_back({&device, read, write});
+	updateIOHandlers();
+}
+
+void MSXCPUInterface::unregisterFastIO(MSXDevice& device)
+{
+	move_pop_back(fastIOHandlers, rfind_if_unguarded(fastIOHandlers,
+		[&](auto& f) { return f.device == &device; }));
+	updateIOHandlers();
+}
+
+static byte readIOVirtual(MSXDevice& device, word port, EmuTime::param time)
+{
+	return device.readIO(port, time);
+}
+
+static void writeIOVirtual(MSXDevice& device, word port, byte value, EmuTime::param time)
+{
+	device.writeIO(port, value, time);
+}
+
+void MSXCPUInterface::updateIOHandlers()
+{
+	// Only called when devices or watchpoints are (un)registered, so no
+	// need to be smart about which ports actually changed.
+	for (int port = 0; port < 256; ++port) {
+		ioRead [port] = {readIOVirtual,  IO_In [port]};
+		ioWrite[port] = {writeIOVirtual, IO_Out[port]};
+	}
+	for (auto& f : fastIOHandlers) {
+		for (int port = 0; port < 256; ++port) {
+			if (IO_In [port] == f.device) ioRead [port].handler = f.read;
+			if (IO_Out[port] == f.device) ioWrite[port].handler = f.write;
+		}
+	}
+}
+
 static void reportMemOverlap(int ps, int ss, MSXDevice& dev1, MSXDevice& dev2)
 {
 	throw MSXException(
@@ -486,6 +578,7 @@ void MSXCPUInterface::registerSlot(
 		}
 	}
 	invalidateRWCache(base, size, ps, ss);
+	msxcpu.forgetRCacheConfigs(); // could belong to another device
 	updateVisible(page);
 }
 
@@ -507,6 +600,7 @@ void MSXCPUInterface::unregisterSlot(
 		slot = dummyDevice.get();
 	}
 	invalidateRWCache(base, size, ps, ss);
+	msxcpu.forgetRCacheConfigs(); // could belong to another device
 	updateVisible(page);
 }
 
@@ -645,6 +739,12 @@ void MSXCPUInterface::fillWCache(unsigned start, unsigned size, byte* wData, int
 	msxcpu.fillWCache(start, size, wData, ps, ss, disallowWriteCache);
 }
 
+bool MSXCPUInterface::switchRCache(unsigned start, unsigned size, unsigned oldConfig, unsigned newConfig, int ps, int ss)
+{
+	tick(CacheLineCounters::SwitchRead);
+	return msxcpu.switchRCache(start, size, oldConfig, newConfig, ps, ss);
+}
+
 void MSXCPUInterface::reset()
 {
 	for (int i = 0; i < 4; ++i) {
@@ -802,6 +902,37 @@ void MSXCPUInterface::removeBreakPoint(unsigned id)
 	}
 }
 
+unsigned MSXCPUInterface::insertCPUHook(word address, int ps, int ss, CPUHook hook)
+{
+	cpuHooks.push_back(CPUHookInfo{std::move(hook), ++lastCPUHookId,
+	                               address, byte(ps), byte(ss)});
+	return lastCPUHookId;
+}
+
+void MSXCPUInterface::removeCPUHook(unsigned id)
+{
+	auto it = ranges::find_if(cpuHooks,
+		[&](const CPUHookInfo& h) { return h.id == id; });
+	assert(it != end(cpuHooks));
+	cpuHooks.erase(it);
+}
+
+void MSXCPUInterface::executeCPUHooks(unsigned pc, EmuTime::param time)
+{
+	auto page = pc >> 14;
+	auto ps = primarySlotState[page];
+	auto ss = secondarySlotState[page];
+	for (auto& h : cpuHooks) {
+		if ((h.address == pc) && (h.ps == ps) &&
+		    (!isExpanded(ps) || (h.ss == ss))) {
+			// copy, the hook may remove itself
+			auto hook = h.hook;
+			hook(time);
+			return;
+		}
+	}
+}
+
 void MSXCPUInterface::checkBreakPoints(
 	std::pair<BreakPoints::const_iterator,
 	          BreakPoints::const_iterator> range,
@@ -836,9 +967,11 @@ void MSXCPUInterface::setWatchPoint(const shared_ptr<WatchPoint>& watchPoint)
 	switch (type) {
 	case WatchPoint::READ_IO:
 		registerIOWatch(*watchPoint, IO_In);
+		updateIOHandlers();
 		break;
 	case WatchPoint::WRITE_IO:
 		registerIOWatch(*watchPoint, IO_Out);
+		updateIOHandlers();
 		break;
 	case WatchPoint::READ_MEM:
 	case WatchPoint::WRITE_MEM:
@@ -862,9 +995,11 @@ void MSXCPUInterface::removeWatchPoint(shared_ptr<WatchPoint> watchPoint)
 		switch (type) {
 		case WatchPoint::READ_IO:
 			unregisterIOWatch(*watchPoint, IO_In);
+			updateIOHandlers();
 			break;
 		case WatchPoint::WRITE_IO:
 			unregisterIOWatch(*watchPoint, IO_Out);
+			updateIOHandlers();
 			break;
 		case WatchPoint::READ_MEM:
 		case WatchPoint::WRITE_MEM:
@@ -13,8 +13,10 @@
 #include "likely.hh"
 #include "ranges.hh"
 #include <bitset>
+#include <functional>
 #include <vector>
 #include <memory>
+#include <type_traits>
 
 namespace openmsx {
 
@@ -55,6 +57,7 @@ enum CacheLineCounters {
 	FillReadWrite,
 	FillRead,
 	FillWrite,
+	SwitchRead,
 	NUM // must be last
 };
 std::ostream& operator<<(std::ostream& os, EnumTypeName<CacheLineCounters>);
@@ -103,6 +106,35 @@ public:
 	bool replace_IO_In (byte port, MSXDevice* oldDevice, MSXDevice* newDevice);
 	bool replace_IO_Out(byte port, MSXDevice* oldDevice, MSXDevice* newDevice);
 
+	using IOReadHandler  = byte (*)(MSXDevice& device, word port, EmuTime::param time);
+	using IOWriteHandler = void (*)(MSXDevice& device, word port, byte value, EmuTime::param time);
+
+	/**
+	 * Devices with frequently accessed IO ports (e.g. VDP, PSG, PPI,
+	 * memory mapper) can register direct (non-virtual) handlers. These are used
+	 * for all ports where this device is the only registered device.
+	 * Ports that are shared by several devices, that have a watchpoint or
+	 * that are wrapped by another device still go via the regular
+	 * readIO()/writeIO() methods.
+	 * Typically called from the constructor and destructor of the device.
+	 */
+	void   registerFastIO(MSXDevice& device, IOReadHandler read, IOWriteHandler write);
+	void unregisterFastIO(MSXDevice& device);
+
+	/** Convenience version of the above, calls the readIO()/writeIO()
+	  * methods of the (final) class 'Device' without virtual dispatch.
+	  */
+	template<typename Device> void registerFastIO(Device& device) {
+		static_assert(std::is_final_v<Device>);
+		registerFastIO(device,
+			[](MSXDevice& d, word port, EmuTime::param time) {
+				return static_cast<Device&>(d).Device::readIO(port, time);
+			},
+			[](MSXDevice& d, word port, byte value, EmuTime::param time) {
+				static_cast<Device&>(d).Device::writeIO(port, value, time);
+			});
+	}
+
 	/**
 	 * Devices can register themself in the MSX slotstructure.
 	 * This is normally done in their constructor. Once devices
@@ -159,7 +191,8 @@ public:
 	 * @see MSXDevice::readIO()
 	 */
 	inline byte readIO(word port, EmuTime::param time) {
-		return IO_In[port & 0xFF]->readIO(port, time);
+		auto& r = ioRead[port & 0xFF];
+		return r.handler(*r.device, port, time);
 	}
 
 	/**
@@ -167,7 +200,8 @@ public:
 	 * @see MSXDevice::writeIO()
 	 */
 	inline void writeIO(word port, byte value, EmuTime::param time) {
-		IO_Out[port & 0xFF]->writeIO(port, value, time);
+		auto& w = ioWrite[port & 0xFF];
+		w.handler(*w.device, port, value, time);
 	}
 
 	/**
@@ -210,6 +244,23 @@ public:
 		return visibleDevices[start >> 14]->getWriteCacheLine(start);
 	}
 
+	/**
+	 * Used for lines where getReadCacheLine() / getWriteCacheLine()
+	 * return nullptr. Often that's only because of a few individual
+	 * addresses in that line (the secondary slot select register, memory
+	 * watchpoints, global reads/writes), or for reading because of a few
+	 * registers of the device itself (see
+	 * MSXDevice::getReadCacheLinePartial()). These methods then still
+	 * return the data of the visible device, and set the bits in
+	 * 'exceptions' for the addresses that must go via readMem() /
+	 * writeMem(). When the device itself doesn't allow caching this line,
+	 * nullptr is returned.
+	 */
+	const byte* getReadCacheLinePartial(
+		word start, std::bitset<CacheLine::SIZE>& exceptions) const;
+	byte* getWriteCacheLinePartial(
+		word start, std::bitset<CacheLine::SIZE>& exceptions) const;
+
 	/**
 	 * CPU uses this method to read 'extra' data from the databus
 	 * used in interrupt routines. In MSX this returns always 255.
@@ -232,6 +283,9 @@ public:
 	void fillRCache (unsigned start, unsigned size, const byte* rData,              int ps, int ss);
 	void fillWCache (unsigned start, unsigned size,                    byte* wData, int ps, int ss);
 
+	/** @see MSXCPU::switchRCache() */
+	bool switchRCache(unsigned start, unsigned size, unsigned oldConfig, unsigned newConfig, int ps, int ss);
+
 	/**
 	 * Peek memory location
 	 * @see MSXDevice::peekMem()
@@ -246,6 +300,16 @@ public:
 	void unsetExpanded(int ps);
 	void testUnsetExpanded(int ps, std::vector<MSXDevice*> allowed) const;
 	inline bool isExpanded(int ps) const { return expanded[ps] != 0; }
+	/** The slot (4 * primary + secondary) that is currently visible in
+	  * the given page. The secondary slot is 0 for a non-expanded slot. */
+	[[nodiscard]] int getVisibleSlot(unsigned page) const {
+		int ps = primarySlotState[page];
+		return 4 * ps + (isExpanded(ps) ? secondarySlotState[page] : 0);
+	}
+	/** The device that is currently visible in the given page. */
+	[[nodiscard]] MSXDevice* getVisibleDevice(unsigned page) const {
+		return visibleDevices[page];
+	}
 	void changeExpanded(bool newExpanded);
 
 	DummyDevice& getDummyDevice() { return *dummyDevice; }
@@ -261,6 +325,18 @@ public:
 	using WatchPoints = std::vector<std::shared_ptr<WatchPoint>>;
 	const WatchPoints& getWatchPoints() const { return watchPoints; }
 
+	/** Emulate a (ROM) routine in C++. The hook is called right before
+	  * the CPU executes the instruction at 'address', but only while that
+	  * address is mapped to the given (sub)slot. The hook can then e.g.
+	  * change the CPU registers to skip the original routine.
+	  * Unlike breakpoints, hooks are part of the emulation: they are
+	  * also executed during fast-forward (e.g. reverse or replay).
+	  * @result An id to pass to removeCPUHook().
+	  */
+	using CPUHook = std::function<void(EmuTime::param)>;
+	unsigned insertCPUHook(word address, int ps, int ss, CPUHook hook);
+	void removeCPUHook(unsigned id);
+
 	static void setCondition(DebugCondition cond);
 	static void removeCondition(const DebugCondition& cond);
 	using Conditions = std::vector<DebugCondition>;
@@ -288,6 +364,13 @@ public:
 		return isBreaked();
 	}
 
+	// CPU hook methods used by CPUCore
+	bool anyCPUHooks() const { return !cpuHooks.empty(); }
+	void checkCPUHooks(unsigned pc, EmuTime::param time)
+	{
+		if (unlikely(!cpuHooks.empty())) executeCPUHooks(pc, time);
+	}
+
 	// cleanup global variables
 	static void cleanup();
 
@@ -308,6 +391,9 @@ private:
 	void register_IO  (int port, bool isIn,
 	                   MSXDevice*& devicePtr, MSXDevice* device);
 	void unregister_IO(MSXDevice*& devicePtr, MSXDevice* device);
+	/** Recalculate ioRead/ioWrite, must be called after IO_In or IO_Out
+	  * (or the fast IO handlers) changed. */
+	void updateIOHandlers();
 	void testRegisterSlot(MSXDevice& device,
 	                      int ps, int ss, int base, int size);
 	void registerSlot(MSXDevice& device,
@@ -321,6 +407,7 @@ private:
 	                             MSXMotherBoard& motherBoard);
 	static void removeBreakPoint(unsigned id);
 	static void removeCondition(unsigned id);
+	void executeCPUHooks(unsigned pc, EmuTime::param time);
 
 	void removeAllWatchPoints();
 	void registerIOWatch  (WatchPoint& watchPoint, MSXDevice** devices);
@@ -424,6 +511,25 @@ private:
 
 	MSXDevice* IO_In [256];
 	MSXDevice* IO_Out[256];
+
+	// The actual dispatch tables for readIO()/writeIO(), derived from
+	// IO_In/IO_Out and fastIOHandlers (so not serialized).
+	struct IOReadEntry {
+		IOReadHandler handler;
+		MSXDevice* device;
+	};
+	struct IOWriteEntry {
+		IOWriteHandler handler;
+		MSXDevice* device;
+	};
+	IOReadEntry  ioRead [256];
+	IOWriteEntry ioWrite[256];
+	struct FastIOInfo {
+		MSXDevice* device;
+		IOReadHandler read;
+		IOWriteHandler write;
+	};
+	std::vector<FastIOInfo> fastIOHandlers; // installed by devices
 	MSXDevice* slotLayout[4][4][4];
 	MSXDevice* visibleDevices[4];
 	byte subSlotRegister[4];
@@ -434,6 +540,15 @@ private:
 
 	bool fastForward; // no need to serialize
 
+	struct CPUHookInfo {
+		CPUHook hook;
+		unsigned id;
+		word address;
+		byte ps, ss;
+	};
+	std::vector<CPUHookInfo> cpuHooks; // installed by devices, not serialized
+	unsigned lastCPUHookId = 0;
+
 	//  All CPUs (Z80 and R800) of all MSX machines share this state.
 	static inline BreakPoints breakPoints; // sorted on address
 	WatchPoints watchPoints; // ordered in creation order,  TODO must also be static
@@ -5,6 +5,7 @@
 #include "FilePool.hh"
 #include "likely.hh"
 #include "ranges.hh"
+#include "xrange.hh"
 #include <cassert>
 
 namespace openmsx {
@@ -59,31 +60,76 @@ DMKDiskImage::DMKDiskImage(Filename filename, std::shared_ptr<File> file_)
 	//      ideal value RawTrack::SIZE? This might indicate the disk image
 	//      was not a 3.5" DD disk image and data will be lost on either
 	//      read or write.
+
+	// From here on 'file' is only used by the loader thread, until
+	// waitForTracks() is called.
+	loading = std::async(std::launch::async,
+		[&f = *file, n = numTracks, len = dmkTrackLen, ss = singleSided] {
+			return loadTracks(f, n, len, ss);
+		});
+}
+
+DMKDiskImage::Tracks DMKDiskImage::loadTracks(
+	File& file, unsigned numTracks, unsigned dmkTrackLen, bool singleSided)
+{
+	Tracks result((singleSided ? 1 : 2) * numTracks);
+	for (auto i : xrange(result.size())) {
+		readTrackFromFile(file, unsigned(i), dmkTrackLen, result[i]);
+	}
+	return result;
+}
+
+void DMKDiskImage::waitForTracks()
+{
+	if (!loading.valid()) return;
+	try {
+		tracks = loading.get();
+		tracksLoaded = true;
+	} catch (MSXException&) {
+		// Read error, fall back to reading the tracks from the file
+		// when they're needed (so that the error is reported there).
+	}
+}
+
+unsigned DMKDiskImage::trackIndex(byte track, byte side) const
+{
+	return singleSided ? track : (2 * track + side);
 }
 
 void DMKDiskImage::seekTrack(byte track, byte side)
 {
-	unsigned t = singleSided ? track : (2 * track + side);
-	file->seek(sizeof(DmkHeader) + t * (dmkTrackLen + 128));
+	file->seek(sizeof(DmkHeader) + trackIndex(track, side) * (dmkTrackLen + 128));
 }
 
 void DMKDiskImage::readTrack(byte track, byte side, RawTrack& output)
 {
 	assert(side < 2);
-	output.clear(dmkTrackLen);
 	if ((singleSided && side) || (track >= numTracks)) {
 		// no such side/track, only clear output
+		output.clear(dmkTrackLen);
 		return;
 	}
 
-	seekTrack(track, side);
+	waitForTracks();
+	if (tracksLoaded) {
+		output = tracks[trackIndex(track, side)];
+	} else {
+		readTrackFromFile(*file, trackIndex(track, side), dmkTrackLen, output);
+	}
+}
+
+void DMKDiskImage::readTrackFromFile(
+	File& file, unsigned trackIdx, unsigned dmkTrackLen, RawTrack& output)
+{
+	output.clear(dmkTrackLen);
+	file.seek(sizeof(DmkHeader) + trackIdx * (dmkTrackLen + 128));
 
 	// Read idam data (still needs to be converted).
 	byte idamBuf[2 * 64];
-	file->read(idamBuf, sizeof(idamBuf));
+	file.read(idamBuf, sizeof(idamBuf));
 
 	// Read raw track data.
-	file->read(output.getRawBuffer(), dmkTrackLen);
+	file.read(output.getRawBuffer(), dmkTrackLen);
 
 	// Convert idam data into an easier to work with internal format.
 	int lastIdam = -1;
@@ -126,6 +172,7 @@ void DMKDiskImage::writeTrackImpl(byte track, byte side, const RawTrack& input)
 		// TODO possible enhancement:  convert to double sided
 		return;
 	}
+	waitForTracks();
 	if (unlikely(numTracks <= track)) {
 		extendImageToTrack(track);
 	}
@@ -149,6 +196,13 @@ void DMKDiskImage::doWriteTrack(byte track, byte side, const RawTrack& input)
 	// Write raw track data.
 	assert(input.getLength() == dmkTrackLen);
 	file->write(input.getRawBuffer(), dmkTrackLen);
+
+	if (tracksLoaded) {
+		auto t = trackIndex(track, side);
+		if (t >= tracks.size()) tracks.resize(t + 1);
+		// re-read to get the same idam list as when loading from file
+		readTrackFromFile(*file, t, dmkTrackLen, tracks[t]);
+	}
 }
 
 void DMKDiskImage::extendImageToTrack(byte track)
@@ -211,11 +265,14 @@ size_t DMKDiskImage::getNbSectorsImpl() const
 
 bool DMKDiskImage::isWriteProtectedImpl() const
 {
+	// Note: File::isReadOnly() doesn't access the file, so it's fine to
+	// call this while the tracks are still being loaded.
 	return writeProtected || file->isReadOnly();
 }
 
 Sha1Sum DMKDiskImage::getSha1SumImpl(FilePool& filepool)
 {
+	waitForTracks();
 	return filepool.getSha1Sum(*file);
 }
 
@@ -2,7 +2,10 @@
 #define DMKDISKIMAGE_HH
 
 #include "Disk.hh"
+#include "RawTrack.hh"
+#include <future>
 #include <memory>
+#include <vector>
 
 namespace openmsx {
 
@@ -12,6 +15,10 @@ class File;
   *   in doc/DMK-Format-Details.txt or at the original site:
   *   http://www.trs-80.com/wordpress/dsk-and-dmk-image-utilities/
   *   (at the bottom of the page)
+  *
+  * All tracks are read and parsed in a background thread when the image is
+  * opened. Afterwards reads are served from memory (the first access waits
+  * for the loader thread, so this is invisible to the emulation).
   */
 class DMKDiskImage final : public Disk
 {
@@ -31,15 +38,26 @@ public:
 private:
 	void detectGeometryFallback() override;
 
+	using Tracks = std::vector<RawTrack>;
+
+	static Tracks loadTracks(File& file, unsigned numTracks,
+	                         unsigned dmkTrackLen, bool singleSided);
+	static void readTrackFromFile(File& file, unsigned trackIdx,
+	                              unsigned dmkTrackLen, RawTrack& output);
+	void waitForTracks();
+	unsigned trackIndex(byte track, byte side) const;
 	void seekTrack(byte track, byte side);
 	void doWriteTrack(byte track, byte side, const RawTrack& input);
 	void extendImageToTrack(byte track);
 
 	std::shared_ptr<File> file;
+	Tracks tracks; // only valid when 'tracksLoaded'
 	unsigned numTracks;
 	unsigned dmkTrackLen;
 	bool singleSided;
 	bool writeProtected;
+	bool tracksLoaded = false;
+	std::future<Tracks> loading; // must be destroyed first
 };
 
 } // namespace openmsx
@@ -31,6 +31,20 @@ void DSKDiskImage::writeSectorImpl(size_t sector, const SectorBuffer& buf)
 	file->write(&buf, sizeof(buf));
 }
 
+void DSKDiskImage::readSectorsImpl(
+	size_t startSector, span<SectorBuffer> buffers)
+{
+	file->seek(startSector * sizeof(SectorBuffer));
+	file->read(buffers.data(), buffers.size_bytes());
+}
+
+void DSKDiskImage::writeSectorsImpl(
+	size_t startSector, span<const SectorBuffer> buffers)
+{
+	file->seek(startSector * sizeof(SectorBuffer));
+	file->write(buffers.data(), buffers.size_bytes());
+}
+
 bool DSKDiskImage::isWriteProtectedImpl() const
 {
 	return file->isReadOnly();
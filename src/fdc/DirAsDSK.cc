@@ -264,6 +264,7 @@ DirAsDSK::DirAsDSK(DiskChanger& diskChanger_, CliComm& cliComm_,
 	, hostDir(hostDir_.getResolved() + '/')
 	, syncMode(syncMode_)
 	, lastAccess(EmuTime::zero())
+	, watcher(hostDir)
 	, nofSectors((diskChanger_.isDoubleSidedDrive() ? 2 : 1) * SECTORS_PER_TRACK * NUM_TRACKS)
 	, nofSectorsPerFat((((3 * nofSectors) / (2 * SECTORS_PER_CLUSTER)) + SECTOR_SIZE - 1) / SECTOR_SIZE)
 	, firstSector2ndFAT(FIRST_FAT_SECTOR + nofSectorsPerFat)
@@ -318,8 +319,9 @@ DirAsDSK::DirAsDSK(DiskChanger& diskChanger_, CliComm& cliComm_,
 	// No host files are mapped to this disk yet.
 	assert(mapDirs.empty());
 
-	// Import the host filesystem.
-	syncWithHost();
+	// Import the host filesystem. (The watcher is already active, so
+	// changes made during this import are not missed.)
+	fullSyncWithHost();
 }
 
 bool DirAsDSK::isWriteProtectedImpl() const
@@ -348,7 +350,23 @@ void DirAsDSK::checkCaches()
 void DirAsDSK::readSectorImpl(size_t sector, SectorBuffer& buf)
 {
 	assert(sector < nofSectors);
+	syncBeforeRead();
 
+	// Simply return the sector from our virtual disk image.
+	memcpy(&buf, &sectors[sector], sizeof(buf));
+}
+
+void DirAsDSK::readSectorsImpl(size_t startSector, span<SectorBuffer> buffers)
+{
+	assert((startSector + buffers.size()) <= nofSectors);
+	// Only check once for changes on the host (a sync in the middle of
+	// the transfer could return an inconsistent set of sectors anyway).
+	syncBeforeRead();
+	memcpy(buffers.data(), &sectors[startSector], buffers.size_bytes());
+}
+
+void DirAsDSK::syncBeforeRead()
+{
 	// 'Peek-mode' is used to periodically calculate a sha1sum for the
 	// whole disk (used by reverse). We don't want this calculation to
 	// interfer with the access time we use for normal read/writes. So in
@@ -373,32 +391,106 @@ void DirAsDSK::readSectorImpl(size_t sector, SectorBuffer& buf)
 			diskChanger.forceDiskChange();
 		}
 	}
-
-	// Simply return the sector from our virtual disk image.
-	memcpy(&buf, &sectors[sector], sizeof(buf));
 }
 
 void DirAsDSK::syncWithHost()
+{
+	// Both ways of syncing (re)collect the host files that can't be added.
+	auto retry = std::move(failedHostFiles);
+	failedHostFiles.clear();
+
+	vector<string> changed;
+	if (watcher.getChanges(changed)) {
+		// Only look at the host files that actually changed, and at the
+		// ones that couldn't be added before (e.g. because the virtual
+		// disk was full, meanwhile there may be space).
+		if (!retry.empty()) {
+			append(changed, std::move(retry));
+			ranges::sort(changed);
+			changed.erase(ranges::unique(changed), end(changed));
+		}
+		if (!changed.empty()) syncChangedHostFiles(changed);
+	} else {
+		// No watcher (or it may have missed changes), rescan all.
+		fullSyncWithHost();
+	}
+}
+
+void DirAsDSK::fullSyncWithHost()
 {
 	// Check for removed host files. This frees up space in the virtual
 	// disk. Do this first because otherwise later actions may fail (run
 	// out of virtual disk space) for no good reason.
-	checkDeletedHostFiles();
+	checkDeletedHostFiles(mapDirs);
 
 	// Next update existing files. This may enlarge or shrink virtual
 	// files. In case not all host files fit on the virtual disk it's
 	// better to update the existing files than to (partly) add a too big
 	// new file and have no space left to enlarge the existing files.
-	checkModifiedHostFiles();
+	checkModifiedHostFiles(mapDirs);
 
 	// Last add new host files (this can only consume virtual disk space).
 	addNewHostFiles({}, firstDirSector);
 }
 
-void DirAsDSK::checkDeletedHostFiles()
+void DirAsDSK::syncChangedHostFiles(const vector<string>& changed)
+{
+	// Same steps (in the same order) as in fullSyncWithHost(), but only
+	// for the given host files. 'changed' is sorted, so a directory comes
+	// before the files in that directory.
+	MapDirs candidates;
+	for (const auto& [dirIdx, mapDir] : mapDirs) {
+		if (ranges::binary_search(changed, mapDir.hostName)) {
+			candidates.emplace(dirIdx, mapDir);
+		}
+	}
+	checkDeletedHostFiles(candidates);
+	checkModifiedHostFiles(candidates);
+
+	for (const auto& hostPath : changed) {
+		if (checkFileUsedInDSK(hostPath)) continue; // not a new file
+		try {
+			auto [hostSubDir, hostName] = StringOp::splitOnLast(hostPath, '/');
+			unsigned msxDirSector = firstDirSector;
+			string subDir;
+			if (!hostSubDir.empty()) {
+				DirIndex dirIndex = findHostFileInDSK(string(hostSubDir));
+				if (dirIndex.sector == unsigned(-1)) {
+					// Parent directory not (yet) on the virtual
+					// disk, it's added together with its parent.
+					continue;
+				}
+				unsigned cluster = msxDir(dirIndex).startCluster;
+				if (!(msxDir(dirIndex).attrib & MSXDirEntry::ATT_DIRECTORY) ||
+				    (cluster < FIRST_CLUSTER) || (cluster >= maxCluster)) {
+					continue;
+				}
+				msxDirSector = clusterToSector(cluster);
+				subDir = strCat(hostSubDir, '/');
+			}
+			string fullHostName = hostDir + hostPath;
+			FileOperations::Stat fst;
+			if (!FileOperations::getStat(fullHostName, fst)) {
+				continue; // removed again
+			}
+			if (FileOperations::isDirectory(fst)) {
+				addNewDirectory(subDir, string(hostName), msxDirSector, fst);
+			} else if (FileOperations::isRegularFile(fst)) {
+				addNewHostFile(subDir, string(hostName), msxDirSector, fst);
+			} else {
+				throw MSXException("Not a regular file: ", fullHostName);
+			}
+		} catch (MSXException& e) {
+			cliComm.printWarning(e.getMessage());
+			failedHostFiles.push_back(hostPath);
+		}
+	}
+}
+
+void DirAsDSK::checkDeletedHostFiles(const MapDirs& candidates)
 {
 	// This handles both host files and directories.
-	auto copy = mapDirs;
+	auto copy = candidates;
 	for (const auto& [dirIdx, mapDir] : copy) {
 		if (!mapDirs.contains(dirIdx)) {
 			// While iterating over (the copy of) mapDirs we delete
@@ -491,9 +583,9 @@ void DirAsDSK::freeFATChain(unsigned cluster)
 	}
 }
 
-void DirAsDSK::checkModifiedHostFiles()
+void DirAsDSK::checkModifiedHostFiles(const MapDirs& candidates)
 {
-	auto copy = mapDirs;
+	auto copy = candidates;
 	for (const auto& [dirIdx, mapDir] : copy) {
 		if (!mapDirs.contains(dirIdx)) {
 			// See comment in checkDeletedHostFiles().
@@ -718,6 +810,7 @@ void DirAsDSK::addNewHostFiles(const string& hostSubDir, unsigned msxDirSector)
 			}
 		} catch (MSXException& e) {
 			cliComm.printWarning(e.getMessage());
+			failedHostFiles.push_back(hostSubDir + hostName);
 		}
 	}
 }
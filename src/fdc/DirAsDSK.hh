@@ -3,6 +3,7 @@
 
 #include "SectorBasedDisk.hh"
 #include "DiskImageUtils.hh"
+#include "DirWatcher.hh"
 #include "FileOperations.hh"
 #include "EmuTime.hh"
 #include "hash_map.hh"
@@ -26,6 +27,7 @@ public:
 	// SectorBasedDisk
 	void readSectorImpl (size_t sector,       SectorBuffer& buf) override;
 	void writeSectorImpl(size_t sector, const SectorBuffer& buf) override;
+	void readSectorsImpl(size_t startSector, span<SectorBuffer> buffers) override;
 	bool isWriteProtectedImpl() const override;
 	void checkCaches() override;
 
@@ -58,6 +60,7 @@ private:
 		                 // filesize, except when the host file was
 		                 // truncated.
 	};
+	using MapDirs = hash_map<DirIndex, MapDir, HashDirIndex>;
 
 	SectorBuffer* fat();
 	SectorBuffer* fat2();
@@ -68,8 +71,11 @@ private:
 	void writeDataSector(unsigned sector, const SectorBuffer& buf);
 	void writeDIREntry(DirIndex dirIndex, DirIndex dirDirIndex,
 	                   const MSXDirEntry& newEntry);
+	void syncBeforeRead();
 	void syncWithHost();
-	void checkDeletedHostFiles();
+	void fullSyncWithHost();
+	void syncChangedHostFiles(const std::vector<std::string>& changed);
+	void checkDeletedHostFiles(const MapDirs& candidates);
 	void deleteMSXFile(DirIndex dirIndex);
 	void deleteMSXFilesInDir(unsigned msxDirSector);
 	void freeFATChain(unsigned cluster);
@@ -87,7 +93,7 @@ private:
 	unsigned nextMsxDirSector(unsigned sector);
 	bool checkMSXFileExists(const std::string& msxfilename,
 	                        unsigned msxDirSector);
-	void checkModifiedHostFiles();
+	void checkModifiedHostFiles(const MapDirs& candidates);
 	void setMSXTimeStamp(DirIndex dirIndex, FileOperations::Stat& fst);
 	void importHostFile(DirIndex dirIndex, FileOperations::Stat& fst);
 	void exportToHost(DirIndex dirIndex, DirIndex dirDirIndex);
@@ -131,9 +137,16 @@ private:
 	// For each directory entry that has a mapped host file/directory we
 	// store the name, last modification time and size of the corresponding
 	// host file/dir.
-	using MapDirs = hash_map<DirIndex, MapDir, HashDirIndex>;
 	MapDirs mapDirs;
 
+	// Reports changed host files, so that (when supported) not the whole
+	// host directory has to be rescanned on each sync.
+	DirWatcher watcher;
+
+	// Host files (relative to 'hostDir') that couldn't be added to the
+	// virtual disk during the last sync. They're retried on the next sync.
+	std::vector<std::string> failedHostFiles;
+
 	// format parameters which depend on single/double sided
 	// varying root parameters
 	const unsigned nofSectors;
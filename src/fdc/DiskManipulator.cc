@@ -18,8 +18,10 @@
 #include "stl.hh"
 #include "strCat.hh"
 #include "xrange.hh"
+#include <algorithm>
 #include <cassert>
 #include <cctype>
+#include <iterator>
 #include <memory>
 #include <stdexcept>
 
@@ -337,11 +339,14 @@ void DiskManipulator::savedsk(const DriveSettings& driveData,
                               string_view filename)
 {
 	auto partition = getPartition(driveData);
-	SectorBuffer buf;
+	SectorBuffer bufs[64];
 	File file(filename, File::CREATE);
-	for (auto i : xrange(partition->getNbSectors())) {
-		partition->readSector(i, buf);
-		file.write(&buf, sizeof(buf));
+	size_t nbSectors = partition->getNbSectors();
+	for (size_t i = 0; i < nbSectors; /**/) {
+		size_t num = std::min(std::size(bufs), nbSectors - i);
+		partition->readSectors(i, span<SectorBuffer>(bufs, num));
+		file.write(bufs, num * sizeof(SectorBuffer));
+		i += num;
 	}
 }
 
@@ -58,6 +58,18 @@ void DiskPartition::writeSectorImpl(size_t sector, const SectorBuffer& buf)
 	parent.writeSector(start + sector, buf);
 }
 
+void DiskPartition::readSectorsImpl(
+	size_t startSector, span<SectorBuffer> buffers)
+{
+	parent.readSectors(start + startSector, buffers);
+}
+
+void DiskPartition::writeSectorsImpl(
+	size_t startSector, span<const SectorBuffer> buffers)
+{
+	parent.writeSectors(start + startSector, buffers);
+}
+
 bool DiskPartition::isWriteProtectedImpl() const
 {
 	return parent.isWriteProtected();
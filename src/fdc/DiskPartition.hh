@@ -27,6 +27,8 @@ public:
 private:
 	void readSectorImpl (size_t sector,       SectorBuffer& buf) override;
 	void writeSectorImpl(size_t sector, const SectorBuffer& buf) override;
+	void readSectorsImpl (size_t startSector, span<      SectorBuffer> buffers) override;
+	void writeSectorsImpl(size_t startSector, span<const SectorBuffer> buffers) override;
 	bool isWriteProtectedImpl() const override;
 
 	SectorAccessibleDisk& parent;
@@ -11,11 +11,16 @@ EmptyDiskPatch::EmptyDiskPatch(SectorAccessibleDisk& disk_)
 
 void EmptyDiskPatch::copyBlock(size_t src, byte* dst, size_t num) const
 {
-	(void)num;
-	assert(num == SectorAccessibleDisk::SECTOR_SIZE);
+	assert((num % SectorAccessibleDisk::SECTOR_SIZE) == 0);
 	assert((src % SectorAccessibleDisk::SECTOR_SIZE) == 0);
-	auto& buf = *aligned_cast<SectorBuffer*>(dst);
-	disk.readSectorImpl(src / SectorAccessibleDisk::SECTOR_SIZE, buf);
+	auto* bufs = aligned_cast<SectorBuffer*>(dst);
+	auto nbSectors = num / SectorAccessibleDisk::SECTOR_SIZE;
+	if (nbSectors == 1) {
+		disk.readSectorImpl(src / SectorAccessibleDisk::SECTOR_SIZE, *bufs);
+	} else {
+		disk.readSectorsImpl(src / SectorAccessibleDisk::SECTOR_SIZE,
+		                     span<SectorBuffer>(bufs, nbSectors));
+	}
 }
 
 size_t EmptyDiskPatch::getSize() const
@@ -147,21 +147,20 @@ MSXtar::MSXtar(SectorAccessibleDisk& sectordisk)
 	// cache complete FAT
 	fatCacheDirty = false;
 	fatBuffer.resize(sectorsPerFat);
-	for (unsigned i = 0; i < sectorsPerFat; ++i) {
-		disk.readSector(i + 1, fatBuffer[i]);
-	}
+	disk.readSectors(1, span<SectorBuffer>(fatBuffer.data(), sectorsPerFat));
+
+	clusterBuffer.resize(sectorsPerCluster);
 }
 
 MSXtar::~MSXtar()
 {
 	if (!fatCacheDirty) return;
 
-	for (unsigned i = 0; i < sectorsPerFat; ++i) {
-		try {
-			disk.writeSector(i + 1, fatBuffer[i]);
-		} catch (MSXException&) {
-			// nothing
-		}
+	try {
+		disk.writeSectors(1, span<const SectorBuffer>(
+			fatBuffer.data(), sectorsPerFat));
+	} catch (MSXException&) {
+		// nothing
 	}
 }
 
@@ -498,16 +497,16 @@ void MSXtar::alterFileInDSK(MSXDirEntry& msxDirEntry, const string& hostName)
 			break;
 		}
 
-		// fill cluster
-		unsigned logicalSector = clusterToSector(curCl);
-		for (unsigned j = 0; (j < sectorsPerCluster) && remaining; ++j) {
-			SectorBuffer buf;
-			memset(&buf, 0, sizeof(buf));
-			unsigned chunkSize = std::min(SECTOR_SIZE, remaining);
-			file.read(&buf, chunkSize);
-			writeLogicalSector(logicalSector + j, buf);
-			remaining -= chunkSize;
-		}
+		// fill cluster (data sectors are never part of the FAT, so
+		// there's no need to go via writeLogicalSector())
+		unsigned num = std::min(sectorsPerCluster,
+		                        (remaining + SECTOR_SIZE - 1) / SECTOR_SIZE);
+		unsigned chunkSize = std::min(num * SECTOR_SIZE, remaining);
+		memset(clusterBuffer.data(), 0, num * SECTOR_SIZE);
+		file.read(clusterBuffer.data(), chunkSize);
+		disk.writeSectors(clusterToSector(curCl),
+			span<const SectorBuffer>(clusterBuffer.data(), num));
+		remaining -= chunkSize;
 
 		// advance to next cluster
 		prevCl = curCl;
@@ -768,16 +767,19 @@ void MSXtar::chroot(string_view newRootDir, bool createDir)
 void MSXtar::fileExtract(const string& resultFile, const MSXDirEntry& dirEntry)
 {
 	unsigned size = dirEntry.size;
-	unsigned sector = clusterToSector(getStartCluster(dirEntry));
+	unsigned cluster = getStartCluster(dirEntry);
 
 	File file(FileOperations::expandTilde(resultFile), "wb");
-	while (size && sector) {
-		SectorBuffer buf;
-		readLogicalSector(sector, buf);
-		unsigned savesize = std::min(size, SECTOR_SIZE);
-		file.write(&buf, savesize);
+	while (size && (cluster >= 2) && (cluster != EOF_FAT)) {
+		// read (the used part of) a whole cluster at once
+		unsigned num = std::min(sectorsPerCluster,
+		                        (size + SECTOR_SIZE - 1) / SECTOR_SIZE);
+		disk.readSectors(clusterToSector(cluster),
+			span<SectorBuffer>(clusterBuffer.data(), num));
+		unsigned savesize = std::min(size, num * SECTOR_SIZE);
+		file.write(clusterBuffer.data(), savesize);
 		size -= savesize;
-		sector = getNextSector(sector);
+		cluster = readFAT(cluster);
 	}
 	// now change the access time
 	changeTime(resultFile, dirEntry);
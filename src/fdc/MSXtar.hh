@@ -69,6 +69,7 @@ private:
 
 	SectorAccessibleDisk& disk;
 	MemBuffer<SectorBuffer> fatBuffer;
+	MemBuffer<SectorBuffer> clusterBuffer; // for file import/export
 
 	unsigned maxCluster;
 	unsigned sectorsPerCluster;
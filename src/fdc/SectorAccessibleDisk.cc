@@ -4,6 +4,8 @@
 #include "DiskExceptions.hh"
 #include "sha1.hh"
 #include "xrange.hh"
+#include <algorithm>
+#include <iterator>
 #include <memory>
 
 namespace openmsx {
@@ -49,6 +51,59 @@ void SectorAccessibleDisk::writeSector(size_t sector, const SectorBuffer& buf)
 	flushCaches();
 }
 
+void SectorAccessibleDisk::readSectors(
+	size_t startSector, span<SectorBuffer> buffers)
+{
+	if (buffers.empty()) return;
+	size_t last = startSector + buffers.size() - 1;
+	if (!isDummyDisk() && (last > 1) && (getNbSectors() <= last)) {
+		// see readSector() for the exception for sector 0 and 1
+		throw NoSuchSectorException("No such sector");
+	}
+	try {
+		// in the end this calls readSectorsImpl()
+		patch->copyBlock(startSector * SECTOR_SIZE, buffers[0].raw,
+		                 buffers.size() * SECTOR_SIZE);
+	} catch (MSXException& e) {
+		throw DiskIOErrorException("Disk I/O error: ", e.getMessage());
+	}
+}
+
+void SectorAccessibleDisk::writeSectors(
+	size_t startSector, span<const SectorBuffer> buffers)
+{
+	if (buffers.empty()) return;
+	if (isWriteProtected()) {
+		throw WriteProtectedException();
+	}
+	if (!isDummyDisk() &&
+	    (getNbSectors() < (startSector + buffers.size()))) {
+		throw NoSuchSectorException("No such sector");
+	}
+	try {
+		writeSectorsImpl(startSector, buffers);
+	} catch (MSXException& e) {
+		throw DiskIOErrorException("Disk I/O error: ", e.getMessage());
+	}
+	flushCaches();
+}
+
+void SectorAccessibleDisk::readSectorsImpl(
+	size_t startSector, span<SectorBuffer> buffers)
+{
+	for (auto i : xrange(buffers.size())) {
+		readSectorImpl(startSector + i, buffers[i]);
+	}
+}
+
+void SectorAccessibleDisk::writeSectorsImpl(
+	size_t startSector, span<const SectorBuffer> buffers)
+{
+	for (auto i : xrange(buffers.size())) {
+		writeSectorImpl(startSector + i, buffers[i]);
+	}
+}
+
 size_t SectorAccessibleDisk::getNbSectors() const
 {
 	return getNbSectorsImpl();
@@ -83,10 +138,13 @@ Sha1Sum SectorAccessibleDisk::getSha1SumImpl(FilePool& /*filePool*/)
 	try {
 		setPeekMode(true);
 		SHA1 sha1;
-		for (auto i : xrange(getNbSectors())) {
-			SectorBuffer buf;
-			readSector(i, buf);
-			sha1.update(buf.raw, sizeof(buf));
+		SectorBuffer bufs[64];
+		size_t nbSectors = getNbSectors();
+		for (size_t i = 0; i < nbSectors; /**/) {
+			size_t num = std::min(std::size(bufs), nbSectors - i);
+			readSectors(i, span<SectorBuffer>(bufs, num));
+			sha1.update(bufs[0].raw, num * SECTOR_SIZE);
+			i += num;
 		}
 		setPeekMode(false);
 		return sha1.digest();
@@ -100,9 +158,7 @@ int SectorAccessibleDisk::readSectors (
 	SectorBuffer* buffers, size_t startSector, size_t nbSectors)
 {
 	try {
-		for (auto i : xrange(nbSectors)) {
-			readSector(startSector + i, buffers[i]);
-		}
+		readSectors(startSector, span<SectorBuffer>(buffers, nbSectors));
 		return 0;
 	} catch (MSXException&) {
 		return -1;
@@ -113,9 +169,7 @@ int SectorAccessibleDisk::writeSectors(
 	const SectorBuffer* buffers, size_t startSector, size_t nbSectors)
 {
 	try {
-		for (auto i : xrange(nbSectors)) {
-			writeSector(startSector + i, buffers[i]);
-		}
+		writeSectors(startSector, span<const SectorBuffer>(buffers, nbSectors));
 		return 0;
 	} catch (MSXException&) {
 		return -1;
@@ -4,6 +4,7 @@
 #include "DiskImageUtils.hh"
 #include "Filename.hh"
 #include "sha1.hh"
+#include "span.hh"
 #include <vector>
 #include <memory>
 
@@ -20,6 +21,13 @@ public:
 	// sector stuff
 	void readSector (size_t sector,       SectorBuffer& buf);
 	void writeSector(size_t sector, const SectorBuffer& buf);
+	/** Read/write a range of consecutive sectors. Same result as calling
+	  * readSector()/writeSector() for each sector, but the checks are only
+	  * done once and disk types can implement this more efficiently
+	  * (e.g. a single read from the image file).
+	  */
+	void readSectors (size_t startSector, span<      SectorBuffer> buffers);
+	void writeSectors(size_t startSector, span<const SectorBuffer> buffers);
 	size_t getNbSectors() const;
 
 	// write protected stuff
@@ -49,6 +57,8 @@ public:
 
 	// should only be called by EmptyDiskPatch
 	virtual void readSectorImpl (size_t sector, SectorBuffer& buf) = 0;
+	// default implementation calls readSectorImpl() for each sector
+	virtual void readSectorsImpl(size_t startSector, span<SectorBuffer> buffers);
 
 protected:
 	SectorAccessibleDisk();
@@ -66,6 +76,9 @@ protected:
 
 private:
 	virtual void writeSectorImpl(size_t sector, const SectorBuffer& buf) = 0;
+	// default implementation calls writeSectorImpl() for each sector
+	virtual void writeSectorsImpl(size_t startSector,
+	                              span<const SectorBuffer> buffers);
 	virtual size_t getNbSectorsImpl() const = 0;
 	virtual bool isWriteProtectedImpl() const = 0;
 
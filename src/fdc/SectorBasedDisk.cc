@@ -1,13 +1,15 @@
 #include "SectorBasedDisk.hh"
 #include "MSXException.hh"
+#include "ranges.hh"
+#include <algorithm>
 #include <cassert>
+#include <cstring>
 
 namespace openmsx {
 
 SectorBasedDisk::SectorBasedDisk(DiskName name_)
 	: Disk(std::move(name_))
 	, nbSectors(size_t(-1)) // to detect misuse
-	, cachedTrackNum(-1)
 {
 }
 
@@ -29,24 +31,60 @@ void SectorBasedDisk::writeTrackImpl(byte track, byte side, const RawTrack& inpu
 	}
 }
 
+// Number of encoded tracks that are cached (a 720kB disk has 160 tracks).
+constexpr size_t MAX_CACHED_TRACKS = 32;
+
 void SectorBasedDisk::readTrack(byte track, byte side, RawTrack& output)
 {
-	// Try to cache the last result of this method (the cache will be
-	// flushed on any write to the disk). This very simple cache mechanism
-	// will typically already have a very high hit-rate. For example during
-	// emulation of a WD2793 read sector, we also emulate the search for
-	// the correct sector. So the disk rotates from sector to sector, and
-	// each time we re-read the track data (because emutime has passed).
-	// Typically the software will also read several sectors from the same
-	// track before moving to the next.
+	// Try to cache the results of this method (the cache will be flushed
+	// on any write to the disk). For example during emulation of a WD2793
+	// read sector, we also emulate the search for the correct sector. So
+	// the disk rotates from sector to sector, and each time we re-read the
+	// track data (because emutime has passed). Typically the software will
+	// also read several sectors from the same track before moving to the
+	// next. And while loading, the head often moves back and forth between
+	// a few tracks (e.g. FAT/directory and file data, or both sides of
+	// the same cylinder), so keep several tracks.
 	checkCaches();
 	int num = track | (side << 8);
-	if (num == cachedTrackNum) {
-		output = cachedTrackData;
+	auto it = ranges::find_if(trackCache, [&](auto& c) { return c.num == num; });
+	if (it != end(trackCache)) {
+		it->lastUse = ++trackCacheCounter;
+		output = it->data;
 		return;
 	}
-	cachedTrackNum = num;
 
+	auto generation = trackCacheGeneration;
+	try {
+		encodeTrack(track, side, output);
+	} catch (MSXException& /*e*/) {
+		// There was an error while reading the actual sector data.
+		// Most likely this is because we're reading the 81th track on
+		// a disk with only 80 tracks (or similar). If you do this on a
+		// real disk, you simply read an 'empty' track. So we do the
+		// same here. (Don't cache this result.)
+		output.clear(RawTrack::STANDARD_SIZE);
+		return;
+	}
+	if (generation != trackCacheGeneration) {
+		// cache was flushed while reading the sectors (e.g. DirAsDSK
+		// synced with the host), result is possibly inconsistent
+		return;
+	}
+
+	if (trackCache.size() < MAX_CACHED_TRACKS) {
+		trackCache.push_back({num, ++trackCacheCounter, output});
+	} else {
+		auto& victim = *std::min_element(begin(trackCache), end(trackCache),
+			[](auto& x, auto& y) { return x.lastUse < y.lastUse; });
+		victim.num = num;
+		victim.lastUse = ++trackCacheCounter;
+		victim.data = output;
+	}
+}
+
+void SectorBasedDisk::encodeTrack(byte track, byte side, RawTrack& output)
+{
 	// This disk image only stores the actual sector data, not all the
 	// extra gap, sync and header information that is in reality stored
 	// in between the sectors. This function transforms the cooked sector
@@ -78,65 +116,59 @@ void SectorBasedDisk::readTrack(byte track, byte side, RawTrack& output)
 	//
 	// (*) Missing clock transitions in MFM encoding
 
-	try {
-		output.clear(RawTrack::STANDARD_SIZE); // clear idam positions
+	// The 9 sectors of a track are consecutive logical sectors, read them
+	// all at once.
+	SectorBuffer sectors[9];
+	readSectors(physToLog(track, side, 1), sectors);
+
+	output.clear(RawTrack::STANDARD_SIZE); // clear idam positions
 
-		unsigned idx = 0;
-		for (int i = 0; i < 80; ++i) output.write(idx++, 0x4E); // gap4a
+	unsigned idx = 0;
+	for (int i = 0; i < 80; ++i) output.write(idx++, 0x4E); // gap4a
+	for (int i = 0; i < 12; ++i) output.write(idx++, 0x00); // sync
+	for (int i = 0; i <  3; ++i) output.write(idx++, 0xC2); // index mark (1)
+	for (int i = 0; i <  1; ++i) output.write(idx++, 0xFC); //            (2)
+	for (int i = 0; i < 50; ++i) output.write(idx++, 0x4E); // gap1
+
+	for (int j = 0; j < 9; ++j) {
 		for (int i = 0; i < 12; ++i) output.write(idx++, 0x00); // sync
-		for (int i = 0; i <  3; ++i) output.write(idx++, 0xC2); // index mark (1)
-		for (int i = 0; i <  1; ++i) output.write(idx++, 0xFC); //            (2)
-		for (int i = 0; i < 50; ++i) output.write(idx++, 0x4E); // gap1
-
-		for (int j = 0; j < 9; ++j) {
-			for (int i = 0; i < 12; ++i) output.write(idx++, 0x00); // sync
-
-			for (int i = 0; i <  3; ++i) output.write(idx++, 0xA1); // addr mark (1)
-			for (int i = 0; i <  1; ++i) output.write(idx++, 0xFE, true); //     (2) add idam
-			output.write(idx++, track); // C: Cylinder number
-			output.write(idx++, side);  // H: Head Address
-			output.write(idx++, j + 1); // R: Record
-			output.write(idx++, 0x02);  // N: Number (length of sector: 512 = 128 << 2)
-			word addrCrc = output.calcCrc(idx - 8, 8);
-			output.write(idx++, addrCrc >> 8);   // CRC (high byte)
-			output.write(idx++, addrCrc & 0xff); //     (low  byte)
-
-			for (int i = 0; i < 22; ++i) output.write(idx++, 0x4E); // gap2
-			for (int i = 0; i < 12; ++i) output.write(idx++, 0x00); // sync
-
-			for (int i = 0; i <  3; ++i) output.write(idx++, 0xA1); // data mark (1)
-			for (int i = 0; i <  1; ++i) output.write(idx++, 0xFB); //           (2)
-
-			auto logicalSector = physToLog(track, side, j + 1);
-			SectorBuffer buf;
-			readSector(logicalSector, buf);
-			for (auto& r : buf.raw) output.write(idx++, r);
-
-			word dataCrc = output.calcCrc(idx - (512 + 4), 512 + 4);
-			output.write(idx++, dataCrc >> 8);   // CRC (high byte)
-			output.write(idx++, dataCrc & 0xff); //     (low  byte)
-
-			for (int i = 0; i < 84; ++i) output.write(idx++, 0x4E); // gap3
-		}
-
-		for (int i = 0; i < 182; ++i) output.write(idx++, 0x4E); // gap4b
-		assert(idx == RawTrack::STANDARD_SIZE);
-	} catch (MSXException& /*e*/) {
-		// There was an error while reading the actual sector data.
-		// Most likely this is because we're reading the 81th track on
-		// a disk with only 80 tracks (or similar). If you do this on a
-		// real disk, you simply read an 'empty' track. So we do the
-		// same here.
-		output.clear(RawTrack::STANDARD_SIZE);
-		cachedTrackNum = -1; // needed?
+
+		for (int i = 0; i <  3; ++i) output.write(idx++, 0xA1); // addr mark (1)
+		for (int i = 0; i <  1; ++i) output.write(idx++, 0xFE, true); //     (2) add idam
+		output.write(idx++, track); // C: Cylinder number
+		output.write(idx++, side);  // H: Head Address
+		output.write(idx++, j + 1); // R: Record
+		output.write(idx++, 0x02);  // N: Number (length of sector: 512 = 128 << 2)
+		word addrCrc = output.calcCrc(idx - 8, 8);
+		output.write(idx++, addrCrc >> 8);   // CRC (high byte)
+		output.write(idx++, addrCrc & 0xff); //     (low  byte)
+
+		for (int i = 0; i < 22; ++i) output.write(idx++, 0x4E); // gap2
+		for (int i = 0; i < 12; ++i) output.write(idx++, 0x00); // sync
+
+		for (int i = 0; i <  3; ++i) output.write(idx++, 0xA1); // data mark (1)
+		for (int i = 0; i <  1; ++i) output.write(idx++, 0xFB); //           (2)
+
+		// (no idam, no wrap-around) so copy without RawTrack::write()
+		memcpy(output.getRawBuffer() + idx, sectors[j].raw, sizeof(SectorBuffer));
+		idx += sizeof(SectorBuffer);
+
+		word dataCrc = output.calcCrc(idx - (512 + 4), 512 + 4);
+		output.write(idx++, dataCrc >> 8);   // CRC (high byte)
+		output.write(idx++, dataCrc & 0xff); //     (low  byte)
+
+		for (int i = 0; i < 84; ++i) output.write(idx++, 0x4E); // gap3
 	}
-	cachedTrackData = output;
+
+	for (int i = 0; i < 182; ++i) output.write(idx++, 0x4E); // gap4b
+	assert(idx == RawTrack::STANDARD_SIZE);
 }
 
 void SectorBasedDisk::flushCaches()
 {
 	Disk::flushCaches();
-	cachedTrackNum = -1;
+	trackCache.clear();
+	++trackCacheGeneration;
 }
 
 size_t SectorBasedDisk::getNbSectorsImpl() const
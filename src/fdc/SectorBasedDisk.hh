@@ -3,6 +3,8 @@
 
 #include "Disk.hh"
 #include "RawTrack.hh"
+#include <cstdint>
+#include <vector>
 
 namespace openmsx {
 
@@ -28,10 +30,19 @@ private:
 	void readTrack(byte track, byte side, RawTrack& output) override;
 	void writeTrackImpl(byte track, byte side, const RawTrack& input) override;
 
+	void encodeTrack(byte track, byte side, RawTrack& output);
+
 	size_t nbSectors;
 
-	RawTrack cachedTrackData;
-	int cachedTrackNum;
+	// Recently encoded tracks (least recently used one is replaced).
+	struct CachedTrack {
+		int num; // track | (side << 8)
+		uint64_t lastUse;
+		RawTrack data;
+	};
+	std::vector<CachedTrack> trackCache;
+	uint64_t trackCacheCounter = 0;
+	unsigned trackCacheGeneration = 0; // incremented on flush
 };
 
 } // namespace openmsx
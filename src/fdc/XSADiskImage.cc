@@ -1,8 +1,12 @@
 #include "XSADiskImage.hh"
 #include "DiskExceptions.hh"
 #include "File.hh"
+#include "ranges.hh"
+#include "sha1.hh"
+#include <algorithm>
 #include <cstring>
 #include <utility>
+#include <vector>
 
 using std::string;
 
@@ -11,8 +15,11 @@ namespace openmsx {
 class XSAExtractor
 {
 public:
-	explicit XSAExtractor(File& file);
-	std::pair<MemBuffer<SectorBuffer>, unsigned> extractData();
+	/** Only checks the header.
+	  * @throws MSXException when this is not an XSA image. */
+	explicit XSAExtractor(span<const byte> input);
+	unsigned getNbSectors() const { return sectors; }
+	MemBuffer<SectorBuffer> extractData();
 
 private:
 	static constexpr int MAXSTRLEN = 254;
@@ -56,18 +63,70 @@ private:
 
 // XSADiskImage
 
+// Recently decoded images, most recently used at the back. Only accessed
+// from the main thread.
+struct DecodedXSA {
+	Sha1Sum sum;
+	std::shared_ptr<const MemBuffer<SectorBuffer>> data;
+};
+static std::vector<DecodedXSA> decodedCache;
+constexpr size_t MAX_DECODED = 8; // a few MB
+
 XSADiskImage::XSADiskImage(Filename& filename, File& file)
 	: SectorBasedDisk(filename)
 {
-	XSAExtractor extractor(file);
-	unsigned sectors;
-	std::tie(data, sectors) = extractor.extractData();
-	setNbSectors(sectors);
+	auto input = file.mmap();
+	XSAExtractor extractor(input);
+	setNbSectors(extractor.getNbSectors());
+
+	xsaSum = SHA1::calc(input.data(), input.size());
+	auto it = ranges::find_if(decodedCache,
+		[&](auto& d) { return d.sum == xsaSum; });
+	if (it != end(decodedCache)) {
+		data = it->data;
+		std::rotate(it, it + 1, end(decodedCache));
+		return;
+	}
+
+	// Decompress in the background (on a copy of the input, 'file' is
+	// closed after this constructor returns).
+	MemBuffer<byte> copy(input.size());
+	memcpy(copy.data(), input.data(), input.size());
+	decoding = std::async(std::launch::async,
+		[copy = std::move(copy), size = input.size()]() mutable {
+			XSAExtractor e(span<const byte>(copy.data(), size));
+			return Data(std::make_shared<const MemBuffer<SectorBuffer>>(
+				e.extractData()));
+		});
+}
+
+const MemBuffer<SectorBuffer>& XSADiskImage::getData()
+{
+	if (decoding.valid()) {
+		try {
+			data = decoding.get(); // possibly waits
+		} catch (MSXException& e) {
+			decodeError = e.getMessage();
+		}
+		if (data) {
+			if (decodedCache.size() == MAX_DECODED) {
+				decodedCache.erase(begin(decodedCache));
+			}
+			decodedCache.push_back({xsaSum, data});
+		}
+	}
+	if (!data) throw MSXException(decodeError);
+	return *data;
 }
 
 void XSADiskImage::readSectorImpl(size_t sector, SectorBuffer& buf)
 {
-	memcpy(&buf, &data[sector], sizeof(buf));
+	memcpy(&buf, &getData()[sector], sizeof(buf));
+}
+
+void XSADiskImage::readSectorsImpl(size_t startSector, span<SectorBuffer> buffers)
+{
+	memcpy(buffers.data(), &getData()[startSector], buffers.size_bytes());
 }
 
 void XSADiskImage::writeSectorImpl(size_t /*sector*/, const SectorBuffer& /*buf*/)
@@ -83,11 +142,10 @@ bool XSADiskImage::isWriteProtectedImpl() const
 
 // XSAExtractor
 
-XSAExtractor::XSAExtractor(File& file)
+XSAExtractor::XSAExtractor(span<const byte> input)
 {
-	auto mmap = file.mmap();
-	inBufPos = mmap.begin();
-	inBufEnd = mmap.end();
+	inBufPos = input.data();
+	inBufEnd = input.data() + input.size();
 
 	if ((charIn() != 'P') || (charIn() != 'C') ||
 	    (charIn() != 'K') || (charIn() != '\010')) {
@@ -95,14 +153,15 @@ XSAExtractor::XSAExtractor(File& file)
 	}
 
 	chkHeader();
-	initHufInfo();	// initialize the cpDist tables
-	unLz77();
 }
 
-std::pair<MemBuffer<SectorBuffer>, unsigned> XSAExtractor::extractData()
+MemBuffer<SectorBuffer> XSAExtractor::extractData()
 {
+	outBuf.resize(sectors);
+	initHufInfo();	// initialize the cpDist tables
+	unLz77();
 	// destroys internal outBuf, but that's ok
-	return {std::move(outBuf), sectors};
+	return std::move(outBuf);
 }
 
 // Get the next character from the input buffer
@@ -123,7 +182,6 @@ void XSAExtractor::chkHeader()
 		outBufLen += base * charIn();
 	}
 	sectors = (outBufLen + 511) / 512;
-	outBuf.resize(sectors);
 
 	// skip compressed length
 	inBufPos += 4;
@@ -10,23 +10,42 @@
 
 #include "SectorBasedDisk.hh"
 #include "MemBuffer.hh"
+#include <future>
+#include <memory>
+#include <string>
 
 namespace openmsx {
 
 class File;
 
+/** XSA (compressed) disk image.
+  *
+  * Only the header is parsed in the constructor, the actual decompression
+  * is done in a background thread. The first sector access waits for the
+  * result, so this is invisible to the emulation. Recently decoded images
+  * are kept (indexed by sha1sum of the XSA file), so re-inserting them
+  * doesn't require decoding again.
+  */
 class XSADiskImage final : public SectorBasedDisk
 {
 public:
 	XSADiskImage(Filename& filename, File& file);
 
 private:
+	using Data = std::shared_ptr<const MemBuffer<SectorBuffer>>;
+
+	const MemBuffer<SectorBuffer>& getData();
+
 	// SectorBasedDisk
 	void readSectorImpl (size_t sector,       SectorBuffer& buf) override;
 	void writeSectorImpl(size_t sector, const SectorBuffer& buf) override;
+	void readSectorsImpl(size_t startSector, span<SectorBuffer> buffers) override;
 	bool isWriteProtectedImpl() const override;
 
-	MemBuffer<SectorBuffer> data;
+	Data data;
+	std::string decodeError;
+	Sha1Sum xsaSum;
+	std::future<Data> decoding; // must be destroyed first
 };
 
 } // namespace openmsx
@@ -2,12 +2,78 @@
 #include "FileException.hh"
 #include "hash_set.hh"
 #include "xxhash.hh"
+#include <algorithm>
+#include <cassert>
 #include <cstring>
+#include <limits>
+#include <vector>
+#include <zlib.h>
 
 using std::string;
 
 namespace openmsx {
 
+// Files that are (expected to be) smaller than this are completely
+// decompressed on first access.
+constexpr size_t STREAM_THRESHOLD = 16 * 1024 * 1024;
+// Granularity of on-demand decompression.
+constexpr size_t CHUNK_SIZE = 256 * 1024;
+// Minimal distance (in uncompressed bytes) between two restart points.
+constexpr size_t INDEX_SPAN = 1024 * 1024;
+// Maximum amount of decompressed chunks kept in memory (all files together).
+constexpr size_t MAX_CACHED_CHUNKS = 64 * 1024 * 1024 / CHUNK_SIZE;
+// Size of the deflate sliding window.
+constexpr unsigned WINDOW_SIZE = 32768;
+
+// A position in the deflate stream from where decompression can be
+// restarted (deflate block boundary).
+struct Checkpoint {
+	size_t out;  // offset in uncompressed data
+	size_t in;   // offset in compressed data (first byte of the block)
+	int bits;    // number of bits of in[-1] that belong to the block
+	MemBuffer<uint8_t> window; // preceding uncompressed data (dictionary)
+	unsigned windowSize;
+};
+
+struct Chunk {
+	size_t number;
+	MemBuffer<uint8_t> data;
+	uint64_t lastUse;
+};
+
+struct CompressedFileAdapter::StreamState {
+	StreamState(span<uint8_t> input_, NextMember nextMember_)
+		: input(input_), nextMember(nextMember_)
+	{
+		strm.zalloc = nullptr;
+		strm.zfree  = nullptr;
+		strm.opaque = nullptr;
+	}
+	~StreamState() {
+		stop();
+	}
+	void stop() {
+		if (active) inflateEnd(&strm);
+		active = false;
+	}
+	[[noreturn]] void error(int err) {
+		stop();
+		throw FileException("Error decompressing: ", zError(err));
+	}
+
+	std::unique_ptr<FileBase> file; // the compressed file
+	span<uint8_t> input;            // mmap()-ed content of 'file'
+	NextMember nextMember;
+	std::vector<Checkpoint> index;  // sorted on 'out'
+	std::vector<Chunk> chunks;      // cached decompressed chunks
+
+	// The decompressor, positioned at uncompressed offset 'pos'.
+	// Reused for (typical) sequential reads.
+	z_stream strm;
+	size_t pos = 0;
+	bool active = false;
+};
+
 struct GetURLFromDecompressed {
 	template<typename Ptr> const string& operator()(const Ptr& p) const {
 		return p->cachedURL;
@@ -16,6 +82,122 @@ struct GetURLFromDecompressed {
 static hash_set<std::shared_ptr<CompressedFileAdapter::Decompressed>,
                 GetURLFromDecompressed, XXHasher> decompressCache;
 
+static size_t numCachedChunks = 0;
+static uint64_t chunkUseCounter = 0;
+
+// Guards 'decompressCache', the cached chunks of all files (evictChunk() can
+// take them from any file), 'numCachedChunks' and 'chunkUseCounter'. When
+// also locking Decompressed::mutex, lock that one first.
+static std::mutex cacheMutex;
+
+// (Re)start the decompressor at the given restart point.
+static void restart(CompressedFileAdapter::StreamState& st, const Checkpoint& cp)
+{
+	st.stop();
+	st.strm.next_in  = st.input.data() + cp.in;
+	st.strm.avail_in = uInt(st.input.size() - cp.in);
+	int err = inflateInit2(&st.strm, -MAX_WBITS);
+	if (err != Z_OK) st.error(err);
+	st.active = true;
+	st.pos = cp.out;
+	if (cp.bits) {
+		err = inflatePrime(&st.strm, cp.bits,
+		                   st.input[cp.in - 1] >> (8 - cp.bits));
+		if (err != Z_OK) st.error(err);
+	}
+	if (cp.windowSize) {
+		err = inflateSetDictionary(&st.strm, cp.window.data(), cp.windowSize);
+		if (err != Z_OK) st.error(err);
+	}
+}
+
+// Add a restart point when the decompressor is at a block boundary (not the
+// last block) and far enough past the last restart point.
+static void addCheckpoint(CompressedFileAdapter::StreamState& st)
+{
+	if ((st.strm.data_type & 128) && !(st.strm.data_type & 64) &&
+	    (st.pos >= (st.index.back().out + INDEX_SPAN))) {
+		Checkpoint c;
+		c.out = st.pos;
+		c.in = st.strm.next_in - st.input.data();
+		c.bits = st.strm.data_type & 7;
+		c.window.resize(WINDOW_SIZE);
+		c.windowSize = WINDOW_SIZE;
+		inflateGetDictionary(&st.strm, c.window.data(), &c.windowSize);
+		st.index.push_back(std::move(c));
+	}
+}
+
+// Called at the end of a deflate stream. When another member follows, reset
+// the decompressor to its start and return true.
+static bool startNextMember(CompressedFileAdapter::StreamState& st)
+{
+	if (!st.nextMember) return false;
+	size_t next = st.nextMember(st.input, st.strm.next_in - st.input.data());
+	if (next == 0) return false;
+	int err = inflateReset(&st.strm);
+	if (err != Z_OK) st.error(err);
+	st.strm.next_in  = st.input.data() + next;
+	st.strm.avail_in = uInt(st.input.size() - next);
+	if (st.pos >= (st.index.back().out + INDEX_SPAN)) {
+		// a new member doesn't refer to earlier data
+		st.index.push_back(Checkpoint{st.pos, next, 0, {}, 0});
+	}
+	return true;
+}
+
+// Decompress the whole file (all members) from the start. Store the result in
+// 'output', or (when it's nullptr) only build the index.
+// @return The uncompressed size.
+static size_t inflateAll(CompressedFileAdapter::StreamState& st,
+                         MemBuffer<uint8_t>* output, size_t sizeHint = 0)
+{
+	restart(st, st.index.front());
+	MemBuffer<uint8_t> scratch;
+	size_t outSize = sizeHint;
+	if (output) {
+		output->resize(outSize);
+	} else {
+		scratch.resize(CHUNK_SIZE);
+	}
+	while (true) {
+		if (output) {
+			if (st.pos == outSize) {
+				outSize = std::max<size_t>(2 * outSize, 65536);
+				output->resize(outSize);
+			}
+			st.strm.next_out = output->data() + st.pos;
+			st.strm.avail_out = uInt(std::min<size_t>(
+				outSize - st.pos,
+				std::numeric_limits<uInt>::max()));
+		} else {
+			st.strm.next_out = scratch.data();
+			st.strm.avail_out = CHUNK_SIZE;
+		}
+		auto avail = st.strm.avail_out;
+		int err = inflate(&st.strm, Z_BLOCK);
+		st.pos += avail - st.strm.avail_out;
+		if (err == Z_STREAM_END) {
+			if (!startNextMember(st)) break;
+		} else if (err != Z_OK) {
+			st.error(err);
+		} else if (!output) {
+			addCheckpoint(st);
+		}
+	}
+	st.stop();
+	if (output) output->resize(st.pos);
+	return st.pos;
+}
+
+
+CompressedFileAdapter::Decompressed::Decompressed() = default;
+
+CompressedFileAdapter::Decompressed::~Decompressed()
+{
+	// called with 'cacheMutex' locked, see ~CompressedFileAdapter()
+	if (stream) numCachedChunks -= stream->chunks.size();
+}
 
 CompressedFileAdapter::CompressedFileAdapter(std::unique_ptr<FileBase> file_)
 	: file(std::move(file_)), pos(0)
@@ -24,6 +206,7 @@ CompressedFileAdapter::CompressedFileAdapter(std::unique_ptr<FileBase> file_)
 
 CompressedFileAdapter::~CompressedFileAdapter()
 {
+	std::lock_guard<std::mutex> lock(cacheMutex);
 	auto it = decompressCache.find(getURL());
 	decompressed.reset();
 	if (it != end(decompressCache) && it->unique()) {
@@ -37,14 +220,39 @@ void CompressedFileAdapter::decompress()
 	if (decompressed) return;
 
 	string url = getURL();
+	// Also makes other threads wait when they open the same file, so
+	// that it's decompressed only once.
+	std::lock_guard<std::mutex> lock(cacheMutex);
 	auto it = decompressCache.find(url);
 	if (it != end(decompressCache)) {
 		decompressed = *it;
 	} else {
-		decompressed = std::make_shared<Decompressed>();
-		decompress(*file, *decompressed);
-		decompressed->cachedModificationDate = getModificationDate();
-		decompressed->cachedURL = std::move(url);
+		auto d = std::make_shared<Decompressed>();
+		auto input = file->mmap();
+		size_t start = parseHeader(input, *d);
+		auto stream = std::make_unique<StreamState>(input, d->nextMember);
+		stream->index.push_back(Checkpoint{0, start, 0, {}, 0});
+		if (d->size == 0) {
+			// The size is unknown. Find it with a full pass, this
+			// also builds the index.
+			d->size = inflateAll(*stream, nullptr);
+		}
+		if (d->size < STREAM_THRESHOLD) {
+			// also correct when the size was only a hint
+			d->size = inflateAll(*stream, &d->buf, d->size ? d->size : 65536);
+		} else {
+			// Keep the compressed file open, decompress on demand.
+			// When there can be more members (e.g. gzip only stores
+			// the size of the last member), the size is only a hint.
+			// Assume a single member (the common case) until a read
+			// goes past it, see determineExactSize().
+			d->exactSize = !d->nextMember;
+			d->stream = std::move(stream);
+		}
+		d->cachedModificationDate = getModificationDate();
+		d->cachedURL = std::move(url);
+		if (d->stream) d->stream->file = std::move(file);
+		decompressed = std::move(d);
 		decompressCache.insert_noDuplicateCheck(decompressed);
 	}
 
@@ -52,17 +260,162 @@ void CompressedFileAdapter::decompress()
 	file.reset();
 }
 
+// Requires 'cacheMutex' to be locked.
+static void evictChunk()
+{
+	Chunk* oldest = nullptr;
+	std::vector<Chunk>* owner = nullptr;
+	for (auto& d : decompressCache) {
+		if (!d->stream) continue;
+		for (auto& c : d->stream->chunks) {
+			if (!oldest || (c.lastUse < oldest->lastUse)) {
+				oldest = &c;
+				owner = &d->stream->chunks;
+			}
+		}
+	}
+	if (!oldest) return;
+	*oldest = std::move(owner->back());
+	owner->pop_back();
+	--numCachedChunks;
+}
+
+// Decompress (at least) up to the end of the given chunk. All chunks that
+// are completely decompressed on the way are added to the cache.
+// Requires 'd.mutex' to be locked.
+static void inflateChunk(CompressedFileAdapter::Decompressed& d, size_t number)
+{
+	auto& st = *d.stream;
+	size_t first = number * CHUNK_SIZE;
+	size_t last = std::min(first + CHUNK_SIZE, d.size);
+
+	// Start from the nearest restart point, unless the current decompressor
+	// position is closer.
+	auto cp = std::prev(std::upper_bound(begin(st.index), end(st.index), first,
+		[](size_t p, const Checkpoint& c) { return p < c.out; }));
+	if (!st.active || (st.pos > first) || (cp->out > st.pos)) {
+		restart(st, *cp);
+	}
+
+	MemBuffer<uint8_t> buf(CHUNK_SIZE);
+	size_t bufStart = st.pos; // uncompressed offset of buf[0]
+	while (st.pos < last) {
+		size_t chunkEnd = std::min((st.pos / CHUNK_SIZE + 1) * CHUNK_SIZE, d.size);
+		st.strm.next_out  = buf.data() + (st.pos - bufStart);
+		st.strm.avail_out = uInt(chunkEnd - st.pos);
+		int err = inflate(&st.strm, Z_BLOCK);
+		st.pos = bufStart + (st.strm.next_out - buf.data());
+		if (err == Z_STREAM_END) {
+			if (!startNextMember(st) && (st.pos != d.size)) {
+				st.error(Z_DATA_ERROR); // size in header was wrong
+			}
+		} else if (err != Z_OK) {
+			st.error(err);
+		} else {
+			addCheckpoint(st);
+		}
+
+		if (st.pos == chunkEnd) {
+			// only cache chunks that were decompressed from their start
+			if ((bufStart % CHUNK_SIZE) == 0) {
+				std::lock_guard<std::mutex> lock(cacheMutex);
+				if (numCachedChunks >= MAX_CACHED_CHUNKS) evictChunk();
+				// Count as used now, otherwise the chunks that are
+				// decompressed on the way to the requested one are
+				// the first to be evicted again.
+				st.chunks.push_back(Chunk{bufStart / CHUNK_SIZE, std::move(buf),
+				                          ++chunkUseCounter});
+				++numCachedChunks;
+				buf = MemBuffer<uint8_t>(CHUNK_SIZE);
+			}
+			bufStart = st.pos;
+		}
+	}
+}
+
+// Copy 'num' bytes from the given offset in the given chunk.
+// Requires 'd.mutex' to be locked.
+static void readChunk(CompressedFileAdapter::Decompressed& d, size_t number,
+                      size_t offset, uint8_t* out, size_t num)
+{
+	while (true) {
+		{
+			std::lock_guard<std::mutex> lock(cacheMutex);
+			auto& chunks = d.stream->chunks;
+			auto it = std::find_if(begin(chunks), end(chunks),
+				[&](const Chunk& c) { return c.number == number; });
+			if (it != end(chunks)) {
+				it->lastUse = ++chunkUseCounter;
+				memcpy(out, it->data.data() + offset, num);
+				return;
+			}
+		}
+		// Another thread can evict the chunk again before we get
+		// to copy it, then simply try again.
+		inflateChunk(d, number);
+	}
+}
+
+// Requires 'd.mutex' to be locked.
+static void readStream(CompressedFileAdapter::Decompressed& d, size_t pos,
+                       uint8_t* out, size_t num)
+{
+	while (num) {
+		size_t offset = pos % CHUNK_SIZE;
+		size_t n = std::min(num, CHUNK_SIZE - offset);
+		readChunk(d, pos / CHUNK_SIZE, offset, out, n);
+		out += n;
+		pos += n;
+		num -= n;
+	}
+}
+
 void CompressedFileAdapter::read(void* buffer, size_t num)
 {
 	decompress();
-	if (decompressed->size < (pos + num)) {
-		throw FileException("Read beyond end of file");
+	auto& d = *decompressed;
+	std::lock_guard<std::mutex> lock(d.mutex);
+	if (d.size < (pos + num)) {
+		determineExactSize();
+		if (d.size < (pos + num)) {
+			throw FileException("Read beyond end of file");
+		}
+	}
+	auto* out = static_cast<uint8_t*>(buffer);
+	if (d.stream) {
+		readStream(d, pos, out, num);
+	} else {
+		memcpy(out, d.buf.data() + pos, num);
 	}
-	const auto& buf = decompressed->buf;
-	memcpy(buffer, buf.data() + pos, num);
 	pos += num;
 }
 
+// Requires 'decompressed->mutex' to be locked.
+void CompressedFileAdapter::determineExactSize()
+{
+	// The size from the header was only a hint: find the real size with a
+	// full pass. The already decompressed chunks and restart points remain
+	// valid, this pass only adds more restart points.
+	auto& d = *decompressed;
+	if (d.exactSize) return;
+	d.size = inflateAll(*d.stream, nullptr);
+	d.exactSize = true;
+}
+
+// Requires 'decompressed->mutex' to be locked.
+void CompressedFileAdapter::decompressAll()
+{
+	// mmap() requires all data in one contiguous block
+	determineExactSize();
+	auto& d = *decompressed;
+	MemBuffer<uint8_t> buf(d.size);
+	readStream(d, 0, buf.data(), d.size);
+	d.buf = std::move(buf);
+	std::lock_guard<std::mutex> lock(cacheMutex); // for evictChunk()
+	numCachedChunks -= d.stream->chunks.size();
+	d.stream.reset();
+}
+
 void CompressedFileAdapter::write(const void* /*buffer*/, size_t /*num*/)
 {
 	throw FileException("Writing to compressed files not yet supported");
@@ -71,6 +424,8 @@ void CompressedFileAdapter::write(const void* /*buffer*/, size_t /*num*/)
 span<uint8_t> CompressedFileAdapter::mmap()
 {
 	decompress();
+	std::lock_guard<std::mutex> lock(decompressed->mutex);
+	if (decompressed->stream) decompressAll();
 	return { decompressed->buf.data(), decompressed->size };
 }
 
@@ -82,6 +437,7 @@ void CompressedFileAdapter::munmap()
 size_t CompressedFileAdapter::getSize()
 {
 	decompress();
+	std::lock_guard<std::mutex> lock(decompressed->mutex);
 	return decompressed->size;
 }
 
@@ -4,18 +4,54 @@
 #include "FileBase.hh"
 #include "MemBuffer.hh"
 #include <memory>
+#include <mutex>
 
 namespace openmsx {
 
+/** Base class for reading (deflate) compressed files.
+  *
+  * Small files are completely decompressed in memory on first access. Large
+  * files are decompressed on demand: while decompressing, an index of
+  * restart points is built, so that later random reads only need to
+  * decompress a small part of the file. Only a limited amount of
+  * decompressed data (shared by all compressed files) is kept in memory.
+  * When the uncompressed size isn't known from the header, a first pass
+  * over the whole file determines it (and builds the index). When the
+  * header only gives a hint (gzip: the size of the last member), that
+  * hint is used until a read goes past it, only then such a pass is done.
+  *
+  * The decompressed data is shared between all File objects that refer to
+  * the same (compressed) file. Those File objects may be used from
+  * different threads (but each File object only from one thread at a
+  * time).
+  */
 class CompressedFileAdapter : public FileBase
 {
 public:
+	struct StreamState;
+
+	/** For formats that can contain several deflate streams after each
+	  * other (gzip members): given the offset right after the end of a
+	  * deflate stream, returns the offset of the next deflate stream, or
+	  * 0 when there is none.
+	  */
+	using NextMember = size_t (*)(span<uint8_t> input, size_t offset);
+
 	struct Decompressed {
-		MemBuffer<uint8_t> buf;
+		Decompressed();
+		~Decompressed();
+
+		// Guards 'buf', 'size', 'exactSize' and 'stream' (but not the
+		// cached chunks of the stream, see the .cc file).
+		std::mutex mutex;
+		MemBuffer<uint8_t> buf; // only for completely decompressed files
 		size_t size;
+		bool exactSize = true; // or is 'size' only a hint
 		std::string originalName;
 		std::string cachedURL;
 		time_t cachedModificationDate;
+		NextMember nextMember = nullptr;
+		std::unique_ptr<StreamState> stream; // only for on-demand files
 	};
 
 	void read(void* buffer, size_t num) final override;
@@ -35,10 +71,20 @@ public:
 protected:
 	explicit CompressedFileAdapter(std::unique_ptr<FileBase> file);
 	~CompressedFileAdapter() override;
-	virtual void decompress(FileBase& file, Decompressed& decompressed) = 0;
+
+	/** Parse the header of the compressed file.
+	  * Must fill in 'decompressed.originalName' and 'decompressed.size'
+	  * (the uncompressed size, or 0 when unknown). When it also fills in
+	  * 'decompressed.nextMember', the stream can consist of several
+	  * members and the size is only used as a hint.
+	  * @return The offset of the raw deflate stream in 'input'.
+	  */
+	virtual size_t parseHeader(span<uint8_t> input, Decompressed& decompressed) = 0;
 
 private:
 	void decompress();
+	void decompressAll();
+	void determineExactSize();
 
 	std::unique_ptr<FileBase> file;
 	std::shared_ptr<Decompressed> decompressed;
@@ -0,0 +1,179 @@
+#include "DirWatcher.hh"
+#include "FileOperations.hh"
+#include "ReadDir.hh"
+#include "StringOp.hh"
+#include "ranges.hh"
+#include <cassert>
+#ifdef __linux__
+#include <cerrno>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace openmsx {
+
+#ifdef __linux__
+
+constexpr uint32_t WATCH_MASK =
+	IN_CREATE | IN_DELETE | IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB |
+	IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF |
+	IN_ONLYDIR;
+
+DirWatcher::DirWatcher(std::string directory_)
+	: directory(std::move(directory_))
+{
+	assert(StringOp::endsWith(directory, '/'));
+	fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (fd == -1) return;
+	addWatch({});
+}
+
+DirWatcher::~DirWatcher()
+{
+	stop();
+}
+
+bool DirWatcher::isActive() const
+{
+	return fd != -1;
+}
+
+void DirWatcher::stop()
+{
+	if (fd != -1) {
+		close(fd); // also removes all watches
+		fd = -1;
+	}
+	watches.clear();
+}
+
+void DirWatcher::addWatch(const std::string& subDir)
+{
+	if (fd == -1) return;
+	int wd = inotify_add_watch(fd, (directory + subDir).c_str(), WATCH_MASK);
+	if (wd == -1) {
+		if (subDir.empty() || (errno == ENOSPC) || (errno == ENOMEM)) {
+			// can't watch everything, fall back to polling
+			stop();
+		}
+		// else: directory was already removed again, ignore
+		return;
+	}
+	watches[wd] = subDir;
+
+	// Also watch all subdirectories. Do this after adding the watch for
+	// this directory, so that subdirectories created in between are
+	// reported.
+	std::vector<std::string> subDirs;
+	{
+		ReadDir dir(directory + subDir);
+		while (auto* d = dir.getEntry()) {
+			if (StringOp::startsWith(d->d_name, '.')) continue;
+			std::string path = subDir + d->d_name;
+			if (FileOperations::isDirectory(directory + path)) {
+				subDirs.push_back(path + '/');
+			}
+		}
+	}
+	for (auto& s : subDirs) addWatch(s);
+}
+
+void DirWatcher::removeWatches(const std::string& subDir)
+{
+	// The paths of the watches in a moved directory are no longer correct.
+	// Remove them now (and not only when IN_IGNORED arrives), so that the
+	// directory can be watched again under its new name.
+	std::vector<int> remove;
+	for (const auto& [wd, dir] : watches) {
+		if (StringOp::startsWith(dir, subDir)) remove.push_back(wd);
+	}
+	for (auto wd : remove) {
+		inotify_rm_watch(fd, wd);
+		watches.erase(wd);
+	}
+}
+
+bool DirWatcher::getChanges(std::vector<std::string>& changed)
+{
+	changed.clear();
+	if (fd == -1) return false;
+
+	bool complete = true;
+	alignas(inotify_event) char buf[16384];
+	while (true) {
+		auto len = ::read(fd, buf, sizeof(buf));
+		if (len <= 0) break; // EAGAIN: no more events
+		for (char* p = buf; p < (buf + len); /**/) {
+			auto* event = reinterpret_cast<inotify_event*>(p);
+			p += sizeof(inotify_event) + event->len;
+
+			if (event->mask & IN_Q_OVERFLOW) {
+				complete = false;
+				continue;
+			}
+			auto* subDir = lookup(watches, event->wd);
+			if (!subDir) continue;
+			if (event->mask & IN_IGNORED) {
+				// watch removed (directory deleted/moved away)
+				if (subDir->empty()) complete = false;
+				watches.erase(event->wd);
+				continue;
+			}
+			if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF)) {
+				// Reported as a change in the parent directory,
+				// except for the watched directory itself.
+				if (subDir->empty()) complete = false;
+				continue;
+			}
+			if (event->len == 0) continue;
+			if (event->name[0] == '.') continue; // hidden file
+
+			std::string path = *subDir + event->name;
+			if ((event->mask & IN_ISDIR) && (event->mask & IN_MOVED_FROM)) {
+				removeWatches(path + '/');
+			}
+			if ((event->mask & IN_ISDIR) &&
+			    (event->mask & (IN_CREATE | IN_MOVED_TO))) {
+				addWatch(path + '/');
+				if (fd == -1) return false;
+			}
+			changed.push_back(std::move(path));
+		}
+	}
+	if (!complete) {
+		// start over with a fresh set of watches
+		stop();
+		fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		if (fd != -1) addWatch({});
+		changed.clear();
+		return false;
+	}
+
+	ranges::sort(changed);
+	changed.erase(ranges::unique(changed), end(changed));
+	return true;
+}
+
+#else // __linux__
+
+DirWatcher::DirWatcher(std::string directory_)
+	: directory(std::move(directory_))
+{
+}
+
+DirWatcher::~DirWatcher() = default;
+
+bool DirWatcher::isActive() const
+{
+	return false;
+}
+
+bool DirWatcher::getChanges(std::vector<std::string>& changed)
+{
+	changed.clear();
+	return false;
+}
+
+#endif // __linux__
+
+} // namespace openmsx
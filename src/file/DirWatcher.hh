@@ -0,0 +1,56 @@
+#ifndef DIRWATCHER_HH
+#define DIRWATCHER_HH
+
+#include "hash_map.hh"
+#include <string>
+#include <vector>
+
+namespace openmsx {
+
+/** Reports which entries in a host directory tree have changed.
+  *
+  * On Linux this uses inotify, so no rescans of the directory are needed.
+  * On other platforms (or when inotify can't be used, e.g. because the
+  * limit on the number of watches is reached) isActive() returns false and
+  * the user has to fall back to polling the directory.
+  *
+  * Hidden files and directories (starting with '.') are not watched.
+  */
+class DirWatcher
+{
+public:
+	DirWatcher(const DirWatcher&) = delete;
+	DirWatcher& operator=(const DirWatcher&) = delete;
+
+	/** @param directory The directory to watch, must end with '/'. */
+	explicit DirWatcher(std::string directory);
+	~DirWatcher();
+
+	[[nodiscard]] bool isActive() const;
+
+	/** Get the entries that changed since the previous call.
+	  * @param changed Is filled with the paths (relative to the watched
+	  *                directory, without trailing '/') of all files and
+	  *                directories that were created, deleted, moved or
+	  *                modified. Sorted and without duplicates.
+	  * @result False when changes might have been missed (event queue
+	  *         overflow or the watched directory itself was removed).
+	  *         Then the whole directory must be rescanned.
+	  */
+	[[nodiscard]] bool getChanges(std::vector<std::string>& changed);
+
+private:
+	void addWatch(const std::string& subDir);
+	void removeWatches(const std::string& subDir);
+	void stop();
+
+	const std::string directory;
+#ifdef __linux__
+	hash_map<int, std::string> watches; // watch descriptor -> subdir
+	int fd;
+#endif
+};
+
+} // namespace openmsx
+
+#endif
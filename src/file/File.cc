@@ -151,4 +151,9 @@ time_t File::getModificationDate()
 	return file->getModificationDate();
 }
 
+bool File::isCompressed() const
+{
+	return dynamic_cast<const CompressedFileAdapter*>(file.get()) != nullptr;
+}
+
 } // namespace openmsx
@@ -142,6 +142,11 @@ public:
 	 */
 	time_t getModificationDate();
 
+	/** Is this a (gzip or zip) compressed file, that's transparently
+	 * decompressed?
+	 */
+	bool isCompressed() const;
+
 private:
 	friend class LocalFileReference;
 	/** This is an internal method used by LocalFileReference.
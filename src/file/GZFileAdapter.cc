@@ -1,6 +1,7 @@
 #include "GZFileAdapter.hh"
 #include "ZlibInflate.hh"
 #include "FileException.hh"
+#include "endian.hh"
 
 namespace openmsx {
 
@@ -53,13 +54,52 @@ static bool skipHeader(ZlibInflate& zlib, std::string& originalName)
 	return true;
 }
 
-void GZFileAdapter::decompress(FileBase& f, Decompressed& d)
+// Can 'compressed' bytes of deflate data decompress to 'size' bytes? Deflate
+// expands (incompressible) data by only a few bytes per 16kB and compresses
+// it at most about 1032:1.
+static bool isPlausibleSize(size_t size, size_t compressed)
 {
-	ZlibInflate zlib(f.mmap());
+	return (compressed <= (size + (size >> 12) + (size >> 14) + 64)) &&
+	       (size <= (compressed * 1032));
+}
+
+// Skip the trailer of the member that ends at 'offset' and the header of the
+// next one (if any).
+static size_t nextMember(span<uint8_t> input, size_t offset)
+{
+	offset += 8; // crc and size
+	if (offset >= input.size()) return 0;
+	try {
+		ZlibInflate zlib(input.subspan(offset));
+		std::string dummy;
+		if (!skipHeader(zlib, dummy)) {
+			return 0; // e.g. zero padding
+		}
+		return offset + zlib.getInputPos();
+	} catch (FileException&) {
+		return 0; // truncated header
+	}
+}
+
+size_t GZFileAdapter::parseHeader(span<uint8_t> input, Decompressed& d)
+{
+	ZlibInflate zlib(input);
 	if (!skipHeader(zlib, d.originalName)) {
 		throw FileException("Not a gzip header");
 	}
-	d.size = zlib.inflate(d.buf);
+	size_t start = zlib.getInputPos();
+	// The gzip trailer contains the uncompressed size, but modulo 2^32 and
+	// only of the last member. So it's only a hint, and only when it fits
+	// the compressed size. Otherwise treat it as unknown.
+	d.size = 0;
+	if (input.size() >= (start + 8)) {
+		size_t size = Endian::read_UA_L32(&input[input.size() - 4]);
+		if (isPlausibleSize(size, input.size() - start - 8)) {
+			d.size = size;
+		}
+	}
+	d.nextMember = nextMember;
+	return start;
 }
 
 } // namespace openmsx
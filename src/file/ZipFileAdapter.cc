@@ -9,16 +9,18 @@ ZipFileAdapter::ZipFileAdapter(std::unique_ptr<FileBase> file_)
 {
 }
 
-void ZipFileAdapter::decompress(FileBase& f, Decompressed& d)
+size_t ZipFileAdapter::parseHeader(span<uint8_t> input, Decompressed& d)
 {
-	ZlibInflate zlib(f.mmap());
+	ZlibInflate zlib(input);
 
 	if (zlib.get32LE() != 0x04034B50) {
 		throw FileException("Invalid ZIP file");
 	}
 
-	// skip "version needed to extract" and "general purpose bit flag"
-	zlib.skip(2 + 2);
+	// skip "version needed to extract"
+	zlib.skip(2);
+	// general purpose bit flag, bit 3: sizes are stored after the data
+	bool dataDescriptor = (zlib.get16LE() & 0x0008) != 0;
 
 	// compression method
 	if (zlib.get16LE() != 0x0008) {
@@ -35,7 +37,8 @@ void ZipFileAdapter::decompress(FileBase& f, Decompressed& d)
 	d.originalName = zlib.getString(filenameLen); // original filename
 	zlib.skip(extraFieldLen); // skip "extra field"
 
-	d.size = zlib.inflate(d.buf, origSize);
+	d.size = dataDescriptor ? 0 : origSize;
+	return zlib.getInputPos();
 }
 
 } // namespace openmsx
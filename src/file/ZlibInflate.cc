@@ -11,7 +11,7 @@ ZlibInflate::ZlibInflate(span<uint8_t> input)
 		throw FileException(
 			"Error while decompressing: input file too big");
 	}
-	auto inputLen = static_cast<decltype(s.avail_in)>(input.size());
+	inputLen = static_cast<decltype(s.avail_in)>(input.size());
 
 	s.zalloc = nullptr;
 	s.zfree  = nullptr;
@@ -22,10 +22,14 @@ public:
 	std::string getString(size_t len);
 	std::string getCString();
 
+	/** The number of input bytes consumed so far by the methods above. */
+	[[nodiscard]] size_t getInputPos() const { return inputLen - s.avail_in; }
+
 	size_t inflate(MemBuffer<uint8_t>& output, size_t sizeHint = 65536);
 
 private:
 	z_stream s;
+	uInt inputLen;
 	bool wasInit;
 };
 
@@ -14,6 +14,7 @@
 #include "serialize.hh"
 #include "tiger.hh"
 #include "xrange.hh"
+#include <algorithm>
 #include <cassert>
 #include <memory>
 
@@ -24,6 +25,10 @@ using std::string;
 HD::HD(const DeviceConfig& config)
 	: motherBoard(config.getMotherBoard())
 	, name("hdX")
+	, cache(file, [this] {
+		// file modification time changed, but the hash is still up-to-date
+		tigerTree->notifyChange(0, 0, file.getModificationDate());
+	  })
 {
 	hdInUse = motherBoard.getSharedStuff<HDInUse>("hdInUse");
 
@@ -59,6 +64,7 @@ HD::HD(const DeviceConfig& config)
 		file.truncate(size_t(config.getChildDataAsInt("size")) * 1024 * 1024);
 		filesize = file.getSize();
 	}
+	cache.reset(getNbSectorsImpl());
 	tigerTree = std::make_unique<TigerTree>(
 		*this, filesize, filename.getResolved());
 
@@ -75,6 +81,13 @@ HD::HD(const DeviceConfig& config)
 
 HD::~HD()
 {
+	try {
+		flushWrites();
+	} catch (MSXException& e) {
+		motherBoard.getMSXCliComm().printWarning(
+			"Couldn't write to harddisk image ",
+			filename.getResolved(), ": ", e.getMessage());
+	}
 	motherBoard.getMSXCliComm().update(CliComm::HARDWARE, name, "remove");
 
 	unsigned id = name[2] - 'a';
@@ -84,9 +97,12 @@ HD::~HD()
 
 void HD::switchImage(const Filename& newFilename)
 {
-	file = File(newFilename);
+	File newFile(newFilename);
+	flushWrites(); // to the old image
+	file = std::move(newFile);
 	filename = newFilename;
 	filesize = file.getSize();
+	cache.reset(getNbSectorsImpl());
 	tigerTree = std::make_unique<TigerTree>(*this, filesize,
 			filename.getResolved());
 	motherBoard.getMSXCliComm().update(CliComm::MEDIA, getName(),
@@ -100,16 +116,57 @@ size_t HD::getNbSectorsImpl() const
 
 void HD::readSectorImpl(size_t sector, SectorBuffer& buf)
 {
-	file.seek(sector * sizeof(buf));
-	file.read(&buf, sizeof(buf));
+	cache.read(sector, buf);
 }
 
 void HD::writeSectorImpl(size_t sector, const SectorBuffer& buf)
 {
-	file.seek(sector * sizeof(buf));
-	file.write(&buf, sizeof(buf));
-	tigerTree->notifyChange(sector * sizeof(buf), sizeof(buf),
-	                        file.getModificationDate());
+	if (cache.write(sector, buf)) {
+		tigerTree->notifyChange(sector * sizeof(buf), sizeof(buf),
+		                        file.getModificationDate());
+	}
+	flushWrites();
+}
+
+void HD::readSectorsImpl(size_t startSector, span<SectorBuffer> buffers)
+{
+	for (auto i : xrange(buffers.size())) {
+		cache.read(startSector + i, buffers[i]);
+	}
+}
+
+void HD::writeSectorsImpl(size_t startSector, span<const SectorBuffer> buffers)
+{
+	// Collect all sectors in the cache and write them to the image file in
+	// one go (consecutive dirty sectors with a single write).
+	size_t first = size_t(-1);
+	size_t last = 0;
+	auto notify = [&] {
+		if (first == size_t(-1)) return;
+		tigerTree->notifyChange(first * sizeof(SectorBuffer),
+		                        (last - first + 1) * sizeof(SectorBuffer),
+		                        file.getModificationDate());
+	};
+	try {
+		for (auto i : xrange(startSector, startSector + buffers.size())) {
+			if (cache.write(i, buffers[i - startSector])) {
+				first = std::min(first, i);
+				last = i;
+			}
+		}
+	} catch (MSXException&) {
+		// the sectors that are already in the cache are written by the
+		// next flush
+		notify();
+		throw;
+	}
+	notify();
+	flushWrites();
+}
+
+void HD::flushWrites()
+{
+	if (file.is_open()) cache.flush();
 }
 
 bool HD::isWriteProtectedImpl() const
@@ -122,6 +179,7 @@ Sha1Sum HD::getSha1SumImpl(FilePool& filePool)
 	if (hasPatches()) {
 		return SectorAccessibleDisk::getSha1SumImpl(filePool);
 	}
+	flushWrites();
 	return filePool.getSha1Sum(file);
 }
 
@@ -165,11 +223,9 @@ uint8_t* HD::getData(size_t offset, size_t size)
 	};
 	static Work work; // not reentrant
 
-	size_t sector = offset / sizeof(SectorBuffer);
-	for (auto i : xrange(size / sizeof(SectorBuffer))) {
-		// This possibly applies IPS patches.
-		readSector(sector++, work.bufs[i]);
-	}
+	// This possibly applies IPS patches.
+	readSectors(offset / sizeof(SectorBuffer),
+	            span<SectorBuffer>(work.bufs, size / sizeof(SectorBuffer)));
 	return work.bufs[0].raw;
 }
 
@@ -211,6 +267,10 @@ int HD::insertDisk(std::string_view newFilename)
 template<typename Archive>
 void HD::serialize(Archive& ar, unsigned version)
 {
+	if (!ar.isLoader()) {
+		// make sure the image file matches the hash stored below
+		flushWrites();
+	}
 	Filename tmp = file.is_open() ? filename : Filename();
 	ar.serialize("filename", tmp);
 	if (ar.isLoader()) {
@@ -250,6 +310,9 @@ void HD::serialize(Archive& ar, unsigned version)
 			if (ar.isLoader()) {
 				string newTiger = getTigerTreeHash();
 				mismatch = oldTiger != newTiger;
+			} else if (!ar.isReverseSnapshot()) {
+				// the hash is up-to-date now, also store it
+				tigerTree->persist();
 			}
 		} else {
 			// use sha1
@@ -3,6 +3,7 @@
 
 #include "Filename.hh"
 #include "File.hh"
+#include "HDCache.hh"
 #include "SectorAccessibleDisk.hh"
 #include "DiskContainer.hh"
 #include "TigerTree.hh"
@@ -36,9 +37,13 @@ public:
 	MSXMotherBoard& getMotherBoard() const { return motherBoard; }
 
 private:
+	void flushWrites();
+
 	// SectorAccessibleDisk:
 	void readSectorImpl (size_t sector,       SectorBuffer& buf) override;
 	void writeSectorImpl(size_t sector, const SectorBuffer& buf) override;
+	void readSectorsImpl (size_t startSector, span<      SectorBuffer> buffers) override;
+	void writeSectorsImpl(size_t startSector, span<const SectorBuffer> buffers) override;
 	size_t getNbSectorsImpl() const override;
 	bool isWriteProtectedImpl() const override;
 	Sha1Sum getSha1SumImpl(FilePool& filePool) override;
@@ -63,6 +68,7 @@ private:
 	File file;
 	Filename filename;
 	size_t filesize;
+	HDCache cache;
 
 	static constexpr unsigned MAX_HD = 26;
 	using HDInUse = std::bitset<MAX_HD>;
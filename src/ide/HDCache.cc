@@ -0,0 +1,121 @@
+#include "HDCache.hh"
+#include "File.hh"
+#include "ranges.hh"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+namespace openmsx {
+
+HDCache::HDCache(File& file_, std::function<void()> written_)
+	: file(file_)
+	, written(std::move(written_))
+{
+	blocks.reserve(MAX_BLOCKS); // pointers to blocks must stay valid
+}
+
+void HDCache::reset(size_t nbSectors_)
+{
+	blocks.clear();
+	lastBlock = nullptr;
+	nbSectors = nbSectors_;
+}
+
+void HDCache::read(size_t sector, SectorBuffer& buf)
+{
+	auto& block = getBlock(sector / SECTORS_PER_BLOCK);
+	buf = block.data[sector % SECTORS_PER_BLOCK];
+}
+
+bool HDCache::write(size_t sector, const SectorBuffer& buf)
+{
+	auto& block = getBlock(sector / SECTORS_PER_BLOCK);
+	auto idx = sector % SECTORS_PER_BLOCK;
+	auto& s = block.data[idx];
+	if (memcmp(s.raw, buf.raw, sizeof(buf)) == 0) return false;
+	s = buf;
+	block.dirty.set(idx);
+	return true;
+}
+
+void HDCache::flush()
+{
+	// write in file order
+	std::vector<Block*> dirty;
+	for (auto& b : blocks) {
+		if (b.dirty.any()) dirty.push_back(&b);
+	}
+	if (dirty.empty()) return;
+	ranges::sort(dirty, [](auto* x, auto* y) { return x->number < y->number; });
+	for (auto* b : dirty) writeBack(*b);
+	file.flush();
+	written();
+}
+
+bool HDCache::isDirty() const
+{
+	return ranges::any_of(blocks, [](auto& b) { return b.dirty.any(); });
+}
+
+HDCache::Block& HDCache::getBlock(size_t number)
+{
+	if (lastBlock && (lastBlock->number == number)) {
+		return *lastBlock; // fast path for consecutive accesses
+	}
+	auto it = ranges::find_if(blocks, [&](auto& b) { return b.number == number; });
+	if (it == end(blocks)) {
+		if (blocks.size() < MAX_BLOCKS) {
+			blocks.emplace_back();
+			it = end(blocks) - 1;
+		} else {
+			// evict least recently used block
+			it = std::min_element(begin(blocks), end(blocks),
+				[](auto& x, auto& y) { return x.lastUse < y.lastUse; });
+			if (it->dirty.any()) {
+				writeBack(*it);
+				written();
+			}
+		}
+		load(*it, number);
+	}
+	it->lastUse = ++useCounter;
+	lastBlock = &*it;
+	return *it;
+}
+
+void HDCache::load(Block& block, size_t number)
+{
+	auto first = number * SECTORS_PER_BLOCK;
+	assert(first < nbSectors);
+	auto num = std::min(SECTORS_PER_BLOCK, nbSectors - first);
+	block.data.resize(num);
+	block.dirty.reset();
+	block.number = number;
+	block.lastUse = 0;
+	try {
+		file.seek(first * sizeof(SectorBuffer));
+		file.read(block.data.data(), num * sizeof(SectorBuffer));
+	} catch (...) {
+		block.number = size_t(-1); // don't keep invalid data
+		lastBlock = nullptr;
+		throw;
+	}
+}
+
+void HDCache::writeBack(Block& block)
+{
+	auto first = block.number * SECTORS_PER_BLOCK;
+	size_t num = block.data.size();
+	size_t i = 0;
+	while (i < num) {
+		if (!block.dirty[i]) { ++i; continue; }
+		size_t j = i + 1;
+		while ((j < num) && block.dirty[j]) ++j;
+		file.seek((first + i) * sizeof(SectorBuffer));
+		file.write(&block.data[i], (j - i) * sizeof(SectorBuffer));
+		i = j;
+	}
+	block.dirty.reset();
+}
+
+} // namespace openmsx
@@ -0,0 +1,76 @@
+#ifndef HDCACHE_HH
+#define HDCACHE_HH
+
+#include "DiskImageUtils.hh"
+#include <bitset>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace openmsx {
+
+class File;
+
+/** Block cache for harddisk images.
+  *
+  * Without a cache each sector access results in a seek plus a read or write
+  * on the image file, so a multi-sector transfer results in many system
+  * calls. This cache reads the image in blocks of 64kB (so sequential reads
+  * are automatically read ahead) and collects sector writes. Dirty sectors
+  * are only written to the file on flush() (or when their block gets
+  * evicted), consecutive dirty sectors with a single write.
+  *
+  * Writes that don't change the content are dropped. So e.g. clearing a
+  * never written region of a sparse image file doesn't allocate space for
+  * it on the host.
+  */
+class HDCache
+{
+public:
+	static constexpr size_t SECTORS_PER_BLOCK = 128; // 64kB
+	static constexpr size_t MAX_BLOCKS = 64;         // 4MB
+
+	/** @param file The image file, must stay alive as long as this cache.
+	  * @param written Called after data was written to the file.
+	  */
+	HDCache(File& file, std::function<void()> written);
+
+	/** Drop all cached data (without writing it back), e.g. because a
+	  * different image was opened.
+	  * @param nbSectors The number of sectors in the (new) image.
+	  */
+	void reset(size_t nbSectors);
+
+	void read(size_t sector, SectorBuffer& buf);
+
+	/** Returns true iff the content of the sector actually changed. */
+	bool write(size_t sector, const SectorBuffer& buf);
+
+	/** Write all dirty sectors back to the file. */
+	void flush();
+
+	[[nodiscard]] bool isDirty() const;
+
+private:
+	struct Block {
+		std::vector<SectorBuffer> data;
+		std::bitset<SECTORS_PER_BLOCK> dirty;
+		size_t number;
+		uint64_t lastUse;
+	};
+
+	Block& getBlock(size_t number);
+	void load(Block& block, size_t number);
+	void writeBack(Block& block);
+
+	File& file;
+	std::function<void()> written;
+	std::vector<Block> blocks;
+	Block* lastBlock = nullptr;
+	size_t nbSectors = 0;
+	uint64_t useCounter = 0;
+};
+
+} // namespace openmsx
+
+#endif
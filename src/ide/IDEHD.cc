@@ -78,10 +78,9 @@ void IDEHD::writeBlockComplete(AlignedBuffer& buf, unsigned count)
 	try {
 		assert((count % 512) == 0);
 		unsigned num = count / 512;
-		for (unsigned i = 0; i < num; ++i) {
-			writeSector(transferSectorNumber++,
-			            *aligned_cast<SectorBuffer*>(buf + 512 * i));
-		}
+		writeSectors(transferSectorNumber, span<const SectorBuffer>(
+			aligned_cast<const SectorBuffer*>(buf), num));
+		transferSectorNumber += num;
 	} catch (MSXException&) {
 		abortWriteTransfer(UNC);
 	}
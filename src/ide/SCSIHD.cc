@@ -276,12 +276,11 @@ unsigned SCSIHD::readSectors(unsigned& blocks)
 	unsigned counter = currentLength * SECTOR_SIZE;
 
 	try {
-		for (unsigned i = 0; i < numSectors; ++i) {
-			auto* sbuf = aligned_cast<SectorBuffer*>(buffer);
-			readSector(currentSector, sbuf[i]);
-			++currentSector;
-			--currentLength;
-		}
+		auto* sbuf = aligned_cast<SectorBuffer*>(buffer);
+		SectorAccessibleDisk::readSectors(
+			currentSector, span<SectorBuffer>(sbuf, numSectors));
+		currentSector += numSectors;
+		currentLength -= numSectors;
 		blocks = currentLength;
 		return counter;
 	} catch (MSXException&) {
@@ -310,12 +309,11 @@ unsigned SCSIHD::writeSectors(unsigned& blocks)
 	unsigned numSectors = std::min(currentLength, BUFFER_BLOCK_SIZE);
 
 	try {
-		for (unsigned i = 0; i < numSectors; ++i) {
-			auto* sbuf = aligned_cast<const SectorBuffer*>(buffer);
-			writeSector(currentSector, sbuf[i]);
-			++currentSector;
-			--currentLength;
-		}
+		auto* sbuf = aligned_cast<const SectorBuffer*>(buffer);
+		SectorAccessibleDisk::writeSectors(
+			currentSector, span<const SectorBuffer>(sbuf, numSectors));
+		currentSector += numSectors;
+		currentLength -= numSectors;
 
 		unsigned tmp = std::min(currentLength, BUFFER_BLOCK_SIZE);
 		blocks = currentLength - tmp;
@@ -8,11 +8,16 @@
 #include "stl.hh"
 #include "stringsp.hh" // for strncasecmp
 #include "view.hh"
+#include <algorithm>
 #include <cstring> // for memcpy, memcmp
 #include <cstdlib> // for atoi
 #include <cctype> // for isspace
 #include <memory>
 
+// Amount of decoded data the worker keeps ready (unless more is requested).
+constexpr size_t FRAMES_AHEAD = 8;  // each frame is 450kB
+constexpr size_t AUDIO_AHEAD = 32;  // fragments, about 1.5s
+
 // TODO
 // - Improve error handling
 // - When an non-ogg file is passed, the entire file is scanned
@@ -201,6 +206,16 @@ OggReader::OggReader(const Filename& filename, CliComm& cli_)
 	th_setup_free(tsi);
 	th_info_clear(&ti);
 	th_comment_clear(&tc);
+
+	// The index is built with a second handle to the file. Not for a
+	// compressed file: both handles would share the same decompressor
+	// (see CompressedFileAdapter), and constantly restart it at each
+	// other's position. Seeking then keeps using bisection.
+	if (!file.isCompressed()) {
+		indexFile = File(filename);
+		indexThread = std::thread([this]() { buildIndex(); });
+	}
+	worker = std::thread([this]() { workerLoop(); });
 }
 
 void OggReader::cleanup()
@@ -227,9 +242,134 @@ void OggReader::cleanup()
 
 OggReader::~OggReader()
 {
+	stopIndex = true;
+	{
+		std::lock_guard lock(mutex);
+		stopWorker = true;
+	}
+	cond.notify_all();
+	worker.join();
+	if (indexThread.joinable()) indexThread.join();
 	cleanup();
 }
 
+void OggReader::workerLoop()
+{
+	std::unique_lock lock(mutex);
+	while (true) {
+		cond.wait(lock, [&] {
+			return stopWorker || (!paused && !endOfStream && needMoreData());
+		});
+		if (stopWorker) return;
+
+		// take back the buffers that are no longer used
+		for (auto& f : returnedFrames) {
+			recycleFrameList.push_back(std::move(f));
+		}
+		returnedFrames.clear();
+		for (auto& a : returnedAudio) {
+			a->length = 0;
+			recycleAudioList.push_back(std::move(a));
+		}
+		returnedAudio.clear();
+
+		busy = true;
+		lock.unlock();
+		bool more = nextPacket();
+		lock.lock();
+		busy = false;
+
+		if (!more) endOfStream = true;
+		publish(!more);
+		cond.notify_all();
+	}
+}
+
+bool OggReader::needMoreData() const
+{
+	return demand || ((readyFrames.size() < FRAMES_AHEAD) &&
+	                  (readyAudio.size()  < AUDIO_AHEAD));
+}
+
+// Move the decoded frames and audio that can no longer change to the 'ready'
+// queues. Called by the worker with the mutex locked.
+void OggReader::publish(bool all)
+{
+	// A frame is complete once its number is known. But the last frame can
+	// still be extended by a dup frame.
+	while ((frameList.size() > (all ? 0 : 1)) &&
+	       (all || (frameList[0]->no != size_t(-1)))) {
+		readyFrames.push_back(frameList.pop_front());
+	}
+	// The positions of the audio fragments are only known once vorbisPos
+	// is known, see vorbisFoundPosition().
+	if (all || (vorbisPos != AudioFragment::UNKNOWN_POS)) {
+		for (auto& a : audioList) {
+			readyAudio.push_back(std::move(a));
+		}
+		audioList.clear();
+	}
+}
+
+void OggReader::pauseWorker()
+{
+	std::unique_lock lock(mutex);
+	paused = true;
+	cond.wait(lock, [&] { return !busy; });
+}
+
+void OggReader::resumeWorker()
+{
+	{
+		std::lock_guard lock(mutex);
+		paused = false;
+	}
+	cond.notify_all();
+}
+
+// Wait till the worker has decoded more frames, move them to 'playFrames'.
+// Returns false at the end of the stream.
+bool OggReader::fetchFrames()
+{
+	std::unique_lock lock(mutex);
+	demand = true;
+	cond.notify_all();
+	cond.wait(lock, [&] { return !readyFrames.empty() || endOfStream; });
+	demand = false;
+	if (readyFrames.empty()) return false;
+	while (!readyFrames.empty()) {
+		playFrames.push_back(readyFrames.pop_front());
+	}
+	cond.notify_all(); // room for more
+	return true;
+}
+
+// Same as fetchFrames(), but for audio.
+bool OggReader::fetchAudio()
+{
+	std::unique_lock lock(mutex);
+	demand = true;
+	cond.notify_all();
+	cond.wait(lock, [&] { return !readyAudio.empty() || endOfStream; });
+	demand = false;
+	if (readyAudio.empty()) return false;
+	while (!readyAudio.empty()) {
+		playAudio.push_back(readyAudio.pop_front());
+	}
+	cond.notify_all();
+	return true;
+}
+
+void OggReader::printWarnings()
+{
+	std::vector<std::string> w;
+	{
+		std::lock_guard lock(mutex);
+		std::swap(w, warnings);
+	}
+	for (auto& m : w) cli.printWarning(m);
+}
+
 /** Vorbis only records the ogg position (in no. of samples) once per ogg
  * page. After seeking we have already decoded some audio before we encounter
  * the exact position we are at. Fixup the positions and discard any unwanted
@@ -245,7 +385,7 @@ void OggReader::vorbisFoundPosition()
 
 	// last is now the first vorbis audio decoded
 	if (last > currentSample) {
-		cli.printWarning("missing part of audio stream");
+		warning("missing part of audio stream");
 	}
 
 	if (vorbisPos > currentSample) {
@@ -408,7 +548,7 @@ void OggReader::readVorbis(ogg_packet* packet)
 			vorbisFoundPosition();
 		} else {
 			if (vorbisPos != size_t(packet->granulepos)) {
-				cli.printWarning(
+				warning(
 					"vorbis audio out of sync, expected ",
 					vorbisPos, ", got ", packet->granulepos);
 				vorbisPos = packet->granulepos;
@@ -529,25 +669,25 @@ void OggReader::readTheora(ogg_packet* packet)
 	switch (rc) {
 	case TH_DUPFRAME:
 		if (frameList.empty()) {
-			cli.printWarning("Theora error: dup frame encountered "
+			warning("Theora error: dup frame encountered "
 					 "without preceding frame");
 		} else {
 			frameList.back()->length++;
 		}
 		break;
 	case TH_EIMPL:
-		cli.printWarning("Theora error: not capable of reading this");
+		warning("Theora error: not capable of reading this");
 		break;
 	case TH_EFAULT:
-		cli.printWarning("Theora error: API not used correctly");
+		warning("Theora error: API not used correctly");
 		break;
 	case TH_EBADPACKET:
-		cli.printWarning("Theora error: bad packet");
+		warning("Theora error: bad packet");
 		break;
 	case 0:
 		break;
 	default:
-		cli.printWarning("Theora error: unknown error ", rc);
+		warning("Theora error: unknown error ", rc);
 		break;
 	}
 
@@ -588,7 +728,7 @@ void OggReader::readTheora(ogg_packet* packet)
 	if (last && (last->no != size_t(-1))) {
 		if ((frameno != size_t(-1)) &&
 		    (frameno != last->no + last->length)) {
-			cli.printWarning("Theora frame sequence wrong");
+			warning("Theora frame sequence wrong");
 		} else {
 			frameno = last->no + last->length;
 		}
@@ -613,13 +753,15 @@ void OggReader::readTheora(ogg_packet* packet)
 
 void OggReader::getFrameNo(RawFrame& rawFrame, size_t frameno)
 {
+	printWarnings();
+
 	Frame* frame;
 	while (true) {
 		// If there are no frames or the frames we have read
 		// does not include a proper frame number, just read
 		// more data
-		if (frameList.empty() || (frameList[0]->no == size_t(-1))) {
-			if (!nextPacket()) {
+		if (playFrames.empty() || (playFrames[0]->no == size_t(-1))) {
+			if (!fetchFrames()) {
 				return;
 			}
 			continue;
@@ -628,35 +770,36 @@ void OggReader::getFrameNo(RawFrame& rawFrame, size_t frameno)
 		// Remove unneeded frames. Note that at 60Hz the odd and
 		// and even frame are displayed during still, so we can
 		// only throw away the one two frames ago
-		while (frameList.size() >= 3 && frameList[2]->no <= frameno) {
-			recycleFrameList.push_back(frameList.pop_front());
+		while (playFrames.size() >= 3 && playFrames[2]->no <= frameno) {
+			std::lock_guard lock(mutex);
+			returnedFrames.push_back(playFrames.pop_front());
 		}
 
-		if (!frameList.empty() && frameList[0]->no > frameno) {
+		if (!playFrames.empty() && playFrames[0]->no > frameno) {
 			// we're missing frames!
-			frame = frameList[0].get();
+			frame = playFrames[0].get();
 			cli.printWarning(
 					"Cannot find frame ", frameno, " using ",
 			        frame->no, " instead");
 			break;
 		}
 
-		if ((frameList.size() >= 2) &&
-		    ((frameno >= frameList[0]->no) &&
-		     (frameno <  frameList[1]->no))) {
-			frame = frameList[0].get();
+		if ((playFrames.size() >= 2) &&
+		    ((frameno >= playFrames[0]->no) &&
+		     (frameno <  playFrames[1]->no))) {
+			frame = playFrames[0].get();
 			break;
 		}
 
-		if ((frameList.size() >= 3) &&
-		    ((frameno >= frameList[1]->no) &&
-		     (frameno <  frameList[2]->no))) {
-			frame = frameList[1].get();
+		if ((playFrames.size() >= 3) &&
+		    ((frameno >= playFrames[1]->no) &&
+		     (frameno <  playFrames[2]->no))) {
+			frame = playFrames[1].get();
 			break;
 		}
 
 		// Sanity check, should not happen
-		if (frameList.size() > (size_t(2) << granuleShift)) {
+		if (playFrames.size() > (size_t(2) << granuleShift)) {
 			// We've got more than twice as many frames
 			// as the maximum distance between key frames.
 			cli.printWarning("Cannot find frame ", frameno);
@@ -664,7 +807,7 @@ void OggReader::getFrameNo(RawFrame& rawFrame, size_t frameno)
 		}
 
 		// ..add read some new ones
-		if (!nextPacket()) {
+		if (!fetchFrames()) {
 			return;
 		}
 	}
@@ -674,27 +817,29 @@ void OggReader::getFrameNo(RawFrame& rawFrame, size_t frameno)
 
 void OggReader::recycleAudio(std::unique_ptr<AudioFragment> audio)
 {
-	audio->length = 0;
-	recycleAudioList.push_back(std::move(audio));
+	std::lock_guard lock(mutex);
+	returnedAudio.push_back(std::move(audio));
 }
 
 const AudioFragment* OggReader::getAudio(size_t sample)
 {
+	printWarnings();
+
 	// Read while position is unknown
-	while (audioList.empty() ||
-	       audioList.front()->position == AudioFragment::UNKNOWN_POS) {
-		if (!nextPacket()) {
+	while (playAudio.empty() ||
+	       playAudio.front()->position == AudioFragment::UNKNOWN_POS) {
+		if (!fetchAudio()) {
 			return nullptr;
 		}
 	}
 
-	auto it = begin(audioList);
+	auto it = begin(playAudio);
 	while (true) {
 		auto& audio = *it;
 		if (audio->position + audio->length + getSampleRate() <= sample) {
 			// Dispose if this, more than 1 second old
 			recycleAudio(std::move(*it));
-			it = audioList.erase(it);
+			it = playAudio.erase(it);
 		} else if (audio->position + audio->length <= sample) {
 			++it;
 		} else {
@@ -707,16 +852,13 @@ const AudioFragment* OggReader::getAudio(size_t sample)
 		}
 
 		// read more if we're at the end of the list
-		if (it == end(audioList)) {
-			size_t size = audioList.size();
-			while (size == audioList.size()) {
-				if (!nextPacket()) {
-					return nullptr;
-				}
+		if (it == end(playAudio)) {
+			if (!fetchAudio()) {
+				return nullptr;
 			}
 
 			// reset the iterator to not point to the end
-			it = begin(audioList);
+			it = begin(playAudio);
 		}
 	}
 }
@@ -752,14 +894,14 @@ bool OggReader::nextPacket()
 		int serial = ogg_page_serialno(&page);
 		if (serial == audioSerial) {
 			if (ogg_stream_pagein(&vorbisStream, &page)) {
-				cli.printWarning("Failed to submit vorbis page");
+				warning("Failed to submit vorbis page");
 			}
 		} else if (serial == videoSerial) {
 			if (ogg_stream_pagein(&theoraStream, &page)) {
-				cli.printWarning("Failed to submit theora page");
+				warning("Failed to submit theora page");
 			}
 		} else if (serial != skeletonSerial) {
-			cli.printWarning("Unexpected stream with serial ",
+			warning("Unexpected stream with serial ",
 			                 serial, " in ogg file");
 		}
 	}
@@ -790,7 +932,7 @@ bool OggReader::nextPage(ogg_page* page)
 		fileOffset += chunk;
 
 		if (ogg_sync_wrote(&sync, long(chunk)) == -1) {
-			cli.printWarning("Internal error: ogg_sync_wrote failed");
+			warning("Internal error: ogg_sync_wrote failed");
 		}
 	}
 
@@ -909,6 +1051,11 @@ size_t OggReader::findOffset(size_t frame, size_t sample)
 		frame = maxFrames;
 	}
 
+	if (indexReady && !videoIndex.empty() && !audioIndex.empty() &&
+	    (frame <= videoIndex.back().pos) && (sample <= audioIndex.back().pos)) {
+		return findOffsetInIndex(frame, sample);
+	}
+
 	offset = bisection(frame, sample, maxOffset, maxSamples, maxFrames);
 
 	// Find key frame
@@ -933,22 +1080,117 @@ size_t OggReader::findOffset(size_t frame, size_t sample)
 	return bisection(keyFrame, sample, maxOffset, maxSamples, maxFrames);
 }
 
+void OggReader::buildIndex()
+{
+	// Only the page headers are parsed, nothing is decoded. This uses its
+	// own file handle and ogg state, so it can run in parallel with the
+	// decoder.
+	constexpr size_t CHUNK = 64 * 1024;
+
+	ogg_sync_state indexSync;
+	ogg_sync_init(&indexSync);
+	bool complete = false;
+	try {
+		size_t size = indexFile.getSize();
+		size_t readPos = 0;
+		size_t offset = 0; // file offset of the next page
+		while (!stopIndex) {
+			ogg_page page;
+			long ret = ogg_sync_pageseek(&indexSync, &page);
+			if (ret < 0) {
+				offset += -ret; // skipped garbage
+			} else if (ret == 0) {
+				if (readPos == size) {
+					complete = true;
+					break;
+				}
+				size_t chunk = std::min(CHUNK, size - readPos);
+				char* buffer = ogg_sync_buffer(&indexSync, long(chunk));
+				indexFile.read(buffer, chunk);
+				readPos += chunk;
+				ogg_sync_wrote(&indexSync, long(chunk));
+			} else {
+				auto granule = ogg_page_granulepos(&page);
+				if (granule > 0) {
+					int serial = ogg_page_serialno(&page);
+					if (serial == videoSerial) {
+						size_t key = granule >> granuleShift;
+						size_t intra = granule & ((size_t(1) << granuleShift) - 1);
+						videoIndex.push_back({offset, key + intra, key});
+					} else if (serial == audioSerial) {
+						audioIndex.push_back({offset, size_t(granule), 0});
+					}
+				}
+				offset += ret;
+			}
+		}
+	} catch (MSXException&) {
+		// can't read the file, keep using bisection
+	}
+	ogg_sync_clear(&indexSync);
+	indexFile.close();
+	if (complete) indexReady = true;
+}
+
+size_t OggReader::findOffsetInIndex(size_t frame, size_t sample)
+{
+	// Decoding must start at the keyframe preceding 'frame', at the last
+	// page that ends before that keyframe (the keyframe itself may start
+	// on that page).
+	auto it = std::upper_bound(begin(videoIndex), end(videoIndex), frame,
+		[](size_t f, const IndexEntry& e) { return f < e.key; });
+	if (it == begin(videoIndex)) {
+		keyFrame = 1;
+		return 0;
+	}
+	keyFrame = std::prev(it)->key;
+	auto byPos = [](const IndexEntry& e, size_t p) { return e.pos < p; };
+	it = std::lower_bound(begin(videoIndex), end(videoIndex), keyFrame, byPos);
+	size_t videoOffset = (it == begin(videoIndex)) ? 0 : std::prev(it)->offset;
+
+	// Vorbis needs the previous packet to decode a packet, so start one
+	// page earlier.
+	it = std::lower_bound(begin(audioIndex), end(audioIndex), sample, byPos);
+	size_t audioOffset = ((it - begin(audioIndex)) < 2) ? 0 : (it - 2)->offset;
+
+	return std::min(videoOffset, audioOffset);
+}
+
 bool OggReader::seek(size_t frame, size_t samples)
 {
-	// Remove all queued frames
-	recycleFrameList.insert(end(recycleFrameList),
-		std::move_iterator(begin(frameList)),
-		std::move_iterator(end  (frameList)));
-	frameList.clear();
+	// From here on the decoder state can be used from this thread.
+	pauseWorker();
 
+	// Remove all queued frames
+	auto dropFrames = [&](auto& list) {
+		recycleFrameList.insert(end(recycleFrameList),
+			std::move_iterator(begin(list)),
+			std::move_iterator(end  (list)));
+		list.clear();
+	};
 	// Remove all queued audio
 	if (!recycleAudioList.empty()) {
 		recycleAudioList.front()->length = 0;
 	}
-	for (auto& a : audioList) {
-		recycleAudio(std::move(a));
+	auto dropAudio = [&](auto& list) {
+		for (auto& a : list) {
+			a->length = 0;
+			recycleAudioList.push_back(std::move(a));
+		}
+		list.clear();
+	};
+	dropFrames(frameList);
+	dropFrames(playFrames);
+	dropAudio(audioList);
+	dropAudio(playAudio);
+	{
+		std::lock_guard lock(mutex);
+		dropFrames(readyFrames);
+		dropFrames(returnedFrames);
+		dropAudio(readyAudio);
+		dropAudio(returnedAudio);
+		endOfStream = false;
 	}
-	audioList.clear();
 
 	fileOffset = findOffset(frame, samples);
 	file.seek(fileOffset);
@@ -961,6 +1203,8 @@ bool OggReader::seek(size_t frame, size_t samples)
 
 	vorbis_synthesis_restart(&vd);
 
+	resumeWorker();
+	printWarnings();
 	return true;
 }
 
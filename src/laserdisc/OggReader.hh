@@ -3,11 +3,17 @@
 
 #include "File.hh"
 #include "circular_buffer.hh"
+#include "strCat.hh"
 #include <ogg/ogg.h>
 #include <vorbis/codec.h>
 #include <theora/theoradec.h>
+#include <atomic>
+#include <condition_variable>
 #include <memory>
+#include <mutex>
 #include <list>
+#include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -36,6 +42,13 @@ struct Frame
 	int length;
 };
 
+/** Reads the video and audio from an ogg file (laserdisc image).
+  *
+  * Decoding is done in a separate thread which stays a few frames (and
+  * audio fragments) ahead of what was last requested. Another thread builds
+  * an index of the ogg pages once per file, when that's done seeks no longer
+  * need to search (bisect) the file.
+  */
 class OggReader
 {
 public:
@@ -57,6 +70,22 @@ public:
 	size_t getChapter(int chapterNo) const;
 
 private:
+	// The decoder state (frameList, audioList, the ogg/theora/vorbis
+	// state, ...) is only used by the worker thread, except while the
+	// worker is paused.
+	void workerLoop();
+	[[nodiscard]] bool needMoreData() const;
+	void publish(bool all);
+	void pauseWorker();
+	void resumeWorker();
+	bool fetchFrames();
+	bool fetchAudio();
+	template<typename... Args> void warning(Args&&... args);
+	void printWarnings();
+
+	void buildIndex();
+	size_t findOffsetInIndex(size_t frame, size_t sample);
+
 	void cleanup();
 	void readTheora(ogg_packet* packet);
 	void theoraHeaderPage(ogg_page* page, th_info& ti, th_comment& tc,
@@ -101,8 +130,9 @@ private:
 	int granuleShift;
 	size_t totalFrames;
 
-	cb_queue<std::unique_ptr<Frame>> frameList;
+	cb_queue<std::unique_ptr<Frame>> frameList; // decoded by the worker
 	std::vector<std::unique_ptr<Frame>> recycleFrameList;
+	cb_queue<std::unique_ptr<Frame>> playFrames; // used by getFrameNo()
 
 	// audio
 	int audioHeaders;
@@ -113,14 +143,52 @@ private:
 	size_t currentSample;
 	size_t vorbisPos;
 
-	std::list<std::unique_ptr<AudioFragment>> audioList;
+	std::list<std::unique_ptr<AudioFragment>> audioList; // decoded by the worker
 	cb_queue<std::unique_ptr<AudioFragment>> recycleAudioList;
+	std::list<std::unique_ptr<AudioFragment>> playAudio; // used by getAudio()
 
 	// Metadata
 	std::vector<size_t> stopFrames;
 	std::vector<std::pair<int, size_t>> chapters;
+
+	// Shared between the worker and the emulation thread, protected by
+	// 'mutex'.
+	std::mutex mutex;
+	std::condition_variable cond;
+	cb_queue<std::unique_ptr<Frame>> readyFrames;
+	cb_queue<std::unique_ptr<AudioFragment>> readyAudio;
+	std::vector<std::unique_ptr<Frame>> returnedFrames;
+	std::vector<std::unique_ptr<AudioFragment>> returnedAudio;
+	std::vector<std::string> warnings;
+	bool endOfStream = false; // worker reached the end of the file
+	bool demand = false;      // emulation is waiting for data
+	bool paused = false;
+	bool busy = false;        // worker is decoding
+	bool stopWorker = false;
+
+	// Index of all pages with a granule position, built in the background.
+	struct IndexEntry {
+		size_t offset; // file offset of the page
+		size_t pos;    // theora: frame number, vorbis: sample number
+		size_t key;    // theora: frame number of the preceding keyframe
+	};
+	std::vector<IndexEntry> videoIndex;
+	std::vector<IndexEntry> audioIndex;
+	File indexFile;
+	std::atomic<bool> indexReady{false};
+	std::atomic<bool> stopIndex{false};
+
+	std::thread indexThread;
+	std::thread worker;
 };
 
+template<typename... Args> void OggReader::warning(Args&&... args)
+{
+	// CliComm may only be used from the main thread
+	std::lock_guard lock(mutex);
+	warnings.push_back(strCat(std::forward<Args>(args)...));
+}
+
 } // namespace openmsx
 
 #endif
@@ -8,6 +8,16 @@
 #include <emmintrin.h>
 #endif
 
+// The AVX2 routine is compiled for the AVX2 target (even when the rest of
+// openMSX isn't) and only used when the host CPU supports it.
+#if defined(__SSE2__) && (defined(__GNUC__) || defined(__clang__))
+#define YUV2RGB_AVX2 1
+#include <immintrin.h>
+#define AVX2_TARGET __attribute__((target("avx2")))
+#else
+#define YUV2RGB_AVX2 0
+#endif
+
 namespace openmsx::yuv2rgb {
 
 #ifdef __SSE2__
@@ -252,6 +262,151 @@ static inline void convertHelperSSE2(
 
 #endif // __SSE2__
 
+#if YUV2RGB_AVX2
+
+// Same calculation as yuv2rgb_sse2(), but on 64x2 pixels. AVX2 instructions
+// operate on two independent 128-bit lanes, so the lower lane calculates the
+// left 32x2 pixels, the upper lane the right 32x2 pixels, each exactly like
+// the SSE2 routine. Thus the result is bit-identical.
+
+// Calculate the color difference terms for 8 U/V pairs (per lane).
+AVX2_TARGET static inline void chroma_avx2(
+	__m256i u, __m256i v, __m256i& dr, __m256i& dg, __m256i& db)
+{
+	const __m256i RED_V   = _mm256_set1_epi16( 102);
+	const __m256i GREEN_U = _mm256_set1_epi16( -25);
+	const __m256i GREEN_V = _mm256_set1_epi16( -52);
+	const __m256i BLUE_U  = _mm256_set1_epi16( 129);
+	const __m256i CNST_R  = _mm256_set1_epi16(-223);
+	const __m256i CNST_G  = _mm256_set1_epi16( 136);
+	const __m256i CNST_B  = _mm256_set1_epi16(-277);
+
+	__m256i mr = _mm256_srai_epi16(_mm256_mullo_epi16(v, RED_V), 6);
+	__m256i sg = _mm256_mullo_epi16(v, GREEN_V);
+	__m256i tg = _mm256_mullo_epi16(u, GREEN_U);
+	__m256i mg = _mm256_srai_epi16(_mm256_adds_epi16(sg, tg), 6);
+	__m256i mb = _mm256_srli_epi16(_mm256_mullo_epi16(u, BLUE_U), 6); // logical shift
+	dr = _mm256_adds_epi16(mr, CNST_R);
+	dg = _mm256_adds_epi16(mg, CNST_G);
+	db = _mm256_adds_epi16(mb, CNST_B);
+}
+
+// Calculate 16 BGRA pixels (per lane) from 16 Y values (per lane).
+AVX2_TARGET static inline void block_avx2(
+	__m256i y, __m256i dr, __m256i dg, __m256i db, __m256i bgra[4])
+{
+	const __m256i ALPHA  = _mm256_set1_epi16(    -1);
+	const __m256i COEF_Y = _mm256_set1_epi16(    74);
+	const __m256i Y_MASK = _mm256_set1_epi16(0x00FF);
+
+	__m256i y_even  = _mm256_and_si256(y, Y_MASK);
+	__m256i y_odd   = _mm256_srli_epi16(y, 8);
+	__m256i dy_even = _mm256_srai_epi16(_mm256_mullo_epi16(y_even, COEF_Y), 6);
+	__m256i dy_odd  = _mm256_srai_epi16(_mm256_mullo_epi16(y_odd,  COEF_Y), 6);
+	__m256i r_even  = _mm256_adds_epi16(dr, dy_even);
+	__m256i g_even  = _mm256_adds_epi16(dg, dy_even);
+	__m256i b_even  = _mm256_adds_epi16(db, dy_even);
+	__m256i r_odd   = _mm256_adds_epi16(dr, dy_odd);
+	__m256i g_odd   = _mm256_adds_epi16(dg, dy_odd);
+	__m256i b_odd   = _mm256_adds_epi16(db, dy_odd);
+	__m256i r_0f    = _mm256_unpackhi_epi8(_mm256_packus_epi16(r_even, r_even),
+	                                       _mm256_packus_epi16(r_odd,  r_odd));
+	__m256i g_0f    = _mm256_unpackhi_epi8(_mm256_packus_epi16(g_even, g_even),
+	                                       _mm256_packus_epi16(g_odd,  g_odd));
+	__m256i b_0f    = _mm256_unpackhi_epi8(_mm256_packus_epi16(b_even, b_even),
+	                                       _mm256_packus_epi16(b_odd,  b_odd));
+	__m256i br_07   = _mm256_unpacklo_epi8(b_0f, r_0f);
+	__m256i br_8f   = _mm256_unpackhi_epi8(b_0f, r_0f);
+	__m256i ga_07   = _mm256_unpacklo_epi8(g_0f, ALPHA);
+	__m256i ga_8f   = _mm256_unpackhi_epi8(g_0f, ALPHA);
+	bgra[0] = _mm256_unpacklo_epi8(br_07, ga_07);
+	bgra[1] = _mm256_unpackhi_epi8(br_07, ga_07);
+	bgra[2] = _mm256_unpacklo_epi8(br_8f, ga_8f);
+	bgra[3] = _mm256_unpackhi_epi8(br_8f, ga_8f);
+}
+
+// Store 16 pixels of each lane: lower lane at out[0..15], upper at out[32..47].
+AVX2_TARGET static inline void store_avx2(const __m256i bgra[4], __m256i* out)
+{
+	_mm256_storeu_si256(out + 0, _mm256_permute2x128_si256(bgra[0], bgra[1], 0x20));
+	_mm256_storeu_si256(out + 1, _mm256_permute2x128_si256(bgra[2], bgra[3], 0x20));
+	_mm256_storeu_si256(out + 4, _mm256_permute2x128_si256(bgra[0], bgra[1], 0x31));
+	_mm256_storeu_si256(out + 5, _mm256_permute2x128_si256(bgra[2], bgra[3], 0x31));
+}
+
+AVX2_TARGET static void yuv2rgb_avx2(
+	const uint8_t* u_ , const uint8_t* v_,
+	const uint8_t* y0_, const uint8_t* y1_,
+	uint32_t* out0_, uint32_t* out1_)
+{
+	auto* u    = reinterpret_cast<const __m256i*>(u_);
+	auto* v    = reinterpret_cast<const __m256i*>(v_);
+	auto* y0   = reinterpret_cast<const __m256i*>(y0_);
+	auto* y1   = reinterpret_cast<const __m256i*>(y1_);
+	auto* out0 = reinterpret_cast<      __m256i*>(out0_);
+	auto* out1 = reinterpret_cast<      __m256i*>(out1_);
+	const __m256i ZERO = _mm256_setzero_si256();
+
+	// U/V 0..15 in the lower lane, 16..31 in the upper lane
+	__m256i u_all = _mm256_loadu_si256(u);
+	__m256i v_all = _mm256_loadu_si256(v);
+	__m256i drL, dgL, dbL, drR, dgR, dbR;
+	chroma_avx2(_mm256_unpacklo_epi8(u_all, ZERO), _mm256_unpacklo_epi8(v_all, ZERO),
+	            drL, dgL, dbL);
+	chroma_avx2(_mm256_unpackhi_epi8(u_all, ZERO), _mm256_unpackhi_epi8(v_all, ZERO),
+	            drR, dgR, dbR);
+
+	// Y 0..15 (lower lane) and 32..47 (upper lane) go with the 'left' U/V
+	// values of each lane, Y 16..31 and 48..63 with the 'right' values.
+	for (int line = 0; line < 2; ++line) {
+		const __m256i* y = line ? y1   : y0;
+		__m256i*     out = line ? out1 : out0;
+		__m256i ya = _mm256_loadu_si256(y + 0);
+		__m256i yb = _mm256_loadu_si256(y + 1);
+		__m256i bgra[4];
+		block_avx2(_mm256_permute2x128_si256(ya, yb, 0x20), drL, dgL, dbL, bgra);
+		store_avx2(bgra, out + 0);
+		block_avx2(_mm256_permute2x128_si256(ya, yb, 0x31), drR, dgR, dbR, bgra);
+		store_avx2(bgra, out + 2);
+	}
+}
+
+AVX2_TARGET static void convertHelperAVX2(
+	const th_ycbcr_buffer& buffer, RawFrame& output)
+{
+	const int width      = buffer[0].width;
+	const int y_stride   = buffer[0].stride;
+	const int uv_stride2 = buffer[1].stride / 2;
+
+	assert((width % 64) == 0);
+	assert((buffer[0].height % 2) == 0);
+
+	for (int y = 0; y < buffer[0].height; y += 2) {
+		const uint8_t* pY1 = buffer[0].data + y * y_stride;
+		const uint8_t* pY2 = buffer[0].data + (y + 1) * y_stride;
+		const uint8_t* pCb = buffer[1].data + y * uv_stride2;
+		const uint8_t* pCr = buffer[2].data + y * uv_stride2;
+		auto* out0 = output.getLinePtrDirect<uint32_t>(y + 0);
+		auto* out1 = output.getLinePtrDirect<uint32_t>(y + 1);
+
+		for (int x = 0; x < width; x += 64) {
+			// convert a block of (64 x 2) pixels
+			yuv2rgb_avx2(pCb, pCr, pY1, pY2, out0, out1);
+			pCb += 32;
+			pCr += 32;
+			pY1 += 64;
+			pY2 += 64;
+			out0 += 64;
+			out1 += 64;
+		}
+
+		output.setLineWidth(y + 0, width);
+		output.setLineWidth(y + 1, width);
+	}
+}
+
+#endif // YUV2RGB_AVX2
+
 constexpr int PREC = 15;
 constexpr int COEF_Y  = int(1.164 * (1 << PREC) + 0.5); // prefer to use lrint() to round
 constexpr int COEF_RV = int(1.596 * (1 << PREC) + 0.5); // but that's not (yet) constexpr
@@ -338,19 +493,68 @@ static void convertHelper(const th_ycbcr_buffer& buffer, RawFrame& output,
 	}
 }
 
-void convert(const th_ycbcr_buffer& input, RawFrame& output)
+bool isSupported(Impl impl)
 {
+	switch (impl) {
+	case Impl::SCALAR:
+		return true;
+	case Impl::SSE2:
+#ifdef __SSE2__
+		return true;
+#else
+		return false;
+#endif
+	case Impl::AVX2:
+#if YUV2RGB_AVX2
+		static const bool avx2 = __builtin_cpu_supports("avx2");
+		return avx2;
+#else
+		return false;
+#endif
+	}
+	return false;
+}
+
+static Impl getBestImpl()
+{
+	static const Impl best = isSupported(Impl::AVX2) ? Impl::AVX2
+	                       : isSupported(Impl::SSE2) ? Impl::SSE2
+	                       : Impl::SCALAR;
+	return best;
+}
+
+void convert(const th_ycbcr_buffer& input, RawFrame& output, Impl impl)
+{
+	assert(isSupported(impl));
 	const PixelFormat& format = output.getPixelFormat();
 	if (format.getBytesPerPixel() == 4) {
+		if ((impl == Impl::AVX2) && ((input[0].width % 64) != 0)) {
+			impl = Impl::SSE2;
+		}
+		switch (impl) {
+#if YUV2RGB_AVX2
+		case Impl::AVX2:
+			convertHelperAVX2(input, output);
+			break;
+#endif
 #ifdef __SSE2__
-		convertHelperSSE2(input, output);
-#else
-		convertHelper<uint32_t>(input, output, format);
+		case Impl::SSE2:
+			convertHelperSSE2(input, output);
+			break;
 #endif
+		default:
+			convertHelper<uint32_t>(input, output, format);
+			break;
+		}
 	} else {
 		assert(format.getBytesPerPixel() == 2);
 		convertHelper<uint16_t>(input, output, format);
 	}
 }
 
+void convert(const th_ycbcr_buffer& input, RawFrame& output)
+{
+	convert(input, output, getBestImpl());
+}
+
 } // namespace openmsx::yuv2rgb
@@ -9,8 +9,17 @@ class RawFrame;
 
 namespace yuv2rgb {
 
+/** Convert a YUV420 frame to RGB. For 32bpp output this uses the fastest
+  * implementation that's supported by the host CPU.
+  */
 void convert(const th_ycbcr_buffer& input, RawFrame& output);
 
+// The implementations for 32bpp output, for testing and benchmarking.
+// (SSE2 and AVX2 give identical results, scalar uses more precision.)
+enum class Impl { SCALAR, SSE2, AVX2 };
+[[nodiscard]] bool isSupported(Impl impl);
+void convert(const th_ycbcr_buffer& input, RawFrame& output, Impl impl);
+
 } // namespace yuv2rgb
 } // namespace openmsx
 
@@ -0,0 +1,132 @@
+// Correctness check and micro-benchmark for the yuv2rgb implementations.
+//
+// Like SoundChipTest.cc this is a standalone program, it's not part of the
+// regular openMSX build. With meson use:
+//    ninja yuv2rgbbench && ./yuv2rgbbench
+//
+// First all implementations that are supported by the host CPU convert the
+// same (pseudo random) frame. SSE2 and AVX2 must give identical results, the
+// scalar implementation uses more precision, so there only a small difference
+// is allowed (alpha is not compared). Then each implementation converts the
+// frame repeatedly and the speed (in megapixels per second) is reported.
+
+#include "yuv2rgb.hh"
+#include "RawFrame.hh"
+#include "PixelFormat.hh"
+#include "MemBuffer.hh"
+#include "Timer.hh"
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+
+using namespace openmsx;
+
+
+constexpr int WIDTH = 640;
+constexpr int HEIGHT = 480;
+constexpr int ITERATIONS = 500;
+constexpr int SCALAR_TOLERANCE = 4; // per color component (6-bit coefficients)
+
+struct Implementation
+{
+	const char* name;
+	yuv2rgb::Impl impl;
+};
+
+constexpr Implementation implementations[] = {
+	{ "scalar", yuv2rgb::Impl::SCALAR },
+	{ "SSE2",   yuv2rgb::Impl::SSE2   },
+	{ "AVX2",   yuv2rgb::Impl::AVX2   },
+};
+
+static const PixelFormat format32(32,
+	0x00FF0000, 16, 0,
+	0x0000FF00,  8, 0,
+	0x000000FF,  0, 0,
+	0xFF000000, 24, 0);
+
+struct Plane
+{
+	Plane(int width, int height)
+		: buf(width * height)
+	{
+		// Deterministic, but not too regular. Include the extreme values
+		// to also test the saturation.
+		uint32_t seed = width * 31 + height;
+		for (int i = 0; i < width * height; ++i) {
+			seed = seed * 1103515245 + 12345;
+			buf[i] = uint8_t(seed >> 16);
+		}
+		buf[0] = 0x00;
+		buf[1] = 0xFF;
+	}
+	MemBuffer<uint8_t, 32> buf;
+};
+
+static int maxDifference(RawFrame& a, RawFrame& b)
+{
+	int result = 0;
+	for (int y = 0; y < HEIGHT; ++y) {
+		auto* pa = a.getLinePtrDirect<uint32_t>(y);
+		auto* pb = b.getLinePtrDirect<uint32_t>(y);
+		for (int x = 0; x < WIDTH; ++x) {
+			for (int shift = 0; shift < 24; shift += 8) { // not alpha
+				int ca = (pa[x] >> shift) & 0xFF;
+				int cb = (pb[x] >> shift) & 0xFF;
+				result = std::max(result, std::abs(ca - cb));
+			}
+		}
+	}
+	return result;
+}
+
+int main()
+{
+	Plane yPlane(WIDTH, HEIGHT);
+	Plane uPlane(WIDTH / 2, HEIGHT / 2);
+	Plane vPlane(WIDTH / 2, HEIGHT / 2);
+	th_ycbcr_buffer buffer;
+	buffer[0] = { WIDTH,     HEIGHT,     WIDTH,     yPlane.buf.data() };
+	buffer[1] = { WIDTH / 2, HEIGHT / 2, WIDTH / 2, uPlane.buf.data() };
+	buffer[2] = { WIDTH / 2, HEIGHT / 2, WIDTH / 2, vPlane.buf.data() };
+
+	RawFrame reference(format32, WIDTH, HEIGHT);
+	yuv2rgb::convert(buffer, reference, yuv2rgb::Impl::SCALAR);
+	RawFrame reference2(format32, WIDTH, HEIGHT); // first vector result
+
+	int result = 0;
+	bool haveReference2 = false;
+	for (auto& i : implementations) {
+		if (!yuv2rgb::isSupported(i.impl)) {
+			std::cout << i.name << ": not supported\n";
+			continue;
+		}
+		RawFrame frame(format32, WIDTH, HEIGHT);
+		yuv2rgb::convert(buffer, frame, i.impl);
+
+		if (i.impl != yuv2rgb::Impl::SCALAR) {
+			int diff = maxDifference(reference, frame);
+			if (diff > SCALAR_TOLERANCE) {
+				std::cout << i.name << ": differs too much from scalar (" << diff << ")\n";
+				result = 1;
+			}
+			if (!haveReference2) {
+				yuv2rgb::convert(buffer, reference2, i.impl);
+				haveReference2 = true;
+			} else if (maxDifference(reference2, frame) != 0) {
+				std::cout << i.name << ": result differs from the other vector implementations\n";
+				result = 1;
+			}
+		}
+
+		uint64_t start = Timer::getTime();
+		for (int n = 0; n < ITERATIONS; ++n) {
+			yuv2rgb::convert(buffer, frame, i.impl);
+		}
+		uint64_t duration = Timer::getTime() - start;
+		double mpixels = double(WIDTH) * HEIGHT * ITERATIONS / duration;
+		std::cout << i.name << ": " << mpixels << " Mpixel/s\n";
+	}
+	return result;
+}
@@ -83,6 +83,26 @@ unsigned KonamiUltimateCollection::getFlashAddr(unsigned addr) const
 	return ((mapperReg & 0xC0) << (21 - 6)) | (bank << 13) | (addr & 0x1FFF);
 }
 
+// Everything that determines the read cache lines of one 8kB page, see
+// MSXDevice::switchDeviceRCache(). Games switch back and forth between a
+// small set of banks, this allows to restore the cache lines of a
+// previously selected bank in one go.
+unsigned KonamiUltimateCollection::getCacheConfig(unsigned page8kB) const
+{
+	return bankRegs[page8kB] | (offsetReg << 8) |
+	       ((mapperReg & 0xC0) << 16) | (sccMode << 24);
+}
+
+void KonamiUltimateCollection::switchBank(unsigned page8kB, byte value)
+{
+	unsigned oldConfig = getCacheConfig(page8kB);
+	bankRegs[page8kB] = value;
+	unsigned start = 0x4000 + 0x2000 * page8kB;
+	if (!switchDeviceRCache(start, 0x2000, oldConfig, getCacheConfig(page8kB))) {
+		invalidateDeviceRCache(start, 0x2000);
+	}
+}
+
 bool KonamiUltimateCollection::isSCCAccess(word addr) const
 {
 	if (sccMode & 0x10) return false;
@@ -138,6 +158,21 @@ const byte* KonamiUltimateCollection::getReadCacheLine(word addr) const
 		: unmappedRead;
 }
 
+const byte* KonamiUltimateCollection::getReadCacheLinePartial(
+	word addr, std::bitset<CacheLine::SIZE>& exceptions) const
+{
+	if (!isSCCAccess(addr)) return getReadCacheLine(addr);
+
+	// most SCC registers read as 0xFF, but the last two addresses of the
+	// SCC range read the flash
+	scc.getReadCacheExceptions(exceptions);
+	if (!isSCCAccess(addr | CacheLine::LOW)) {
+		exceptions.set(0xFE);
+		exceptions.set(0xFF);
+	}
+	return unmappedRead;
+}
+
 void KonamiUltimateCollection::writeMem(word addr, byte value, EmuTime::param time)
 {
 	unsigned page8kB = (addr >> 13) - 2;
@@ -182,8 +217,7 @@ void KonamiUltimateCollection::writeMem(word addr, byte value, EmuTime::param ti
 				// [0x5000,0x57FF] [0x7000,0x77FF]
 				// [0x9000,0x97FF] [0xB000,0xB7FF]
 				// Masking of the mapper bits is done on write
-				bankRegs[page8kB] = value;
-				invalidateDeviceRCache(0x4000 + 0x2000 * page8kB, 0x2000);
+				switchBank(page8kB, value);
 			}
 		} else {
 			// Konami
@@ -194,8 +228,7 @@ void KonamiUltimateCollection::writeMem(word addr, byte value, EmuTime::param ti
 				// [0x6000,0x7FFF] [0x8000,0x9FFF] [0xA000,0xBFFF]
 				if (!((addr < 0x5000) || ((0x5800 <= addr) && (addr < 0x6000)))) {
 					// Masking of the mapper bits is done on write
-					bankRegs[page8kB] = value;
-					invalidateDeviceRCache(0x4000 + 0x2000 * page8kB, 0x2000);
+					switchBank(page8kB, value);
 				}
 			}
 		}
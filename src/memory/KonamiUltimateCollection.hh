@@ -18,6 +18,8 @@ public:
 	byte peekMem(word address, EmuTime::param time) const override;
 	byte readMem(word address, EmuTime::param time) override;
 	const byte* getReadCacheLine(word address) const override;
+	const byte* getReadCacheLinePartial(
+		word address, std::bitset<CacheLine::SIZE>& exceptions) const override;
 	void writeMem(word address, byte value, EmuTime::param time) override;
 	byte* getWriteCacheLine(word address) const override;
 
@@ -27,6 +29,8 @@ public:
 private:
 	bool isSCCAccess(word addr) const;
 	unsigned getFlashAddr(unsigned addr) const;
+	unsigned getCacheConfig(unsigned page8kB) const;
+	void switchBank(unsigned page8kB, byte value);
 
 	bool isKonamiSCCmode()         const { return (mapperReg & 0x20) == 0; }
 	bool isFlashRomWriteEnabled()  const { return (mapperReg & 0x10) != 0; }
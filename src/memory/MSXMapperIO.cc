@@ -1,5 +1,6 @@
 #include "MSXMapperIO.hh"
 #include "MSXMotherBoard.hh"
+#include "MSXCPUInterface.hh"
 #include "HardwareConfig.hh"
 #include "XMLElement.hh"
 #include "MSXException.hh"
@@ -35,6 +36,12 @@ MSXMapperIO::MSXMapperIO(const DeviceConfig& config)
 	, mask(calcReadBackMask(getMotherBoard()))
 {
 	reset(EmuTime::dummy());
+	getCPUInterface().registerFastIO(*this);
+}
+
+MSXMapperIO::~MSXMapperIO()
+{
+	getCPUInterface().unregisterFastIO(*this);
 }
 
 void MSXMapperIO::registerMapper(MSXMemoryMapperInterface* mapper)
@@ -23,6 +23,7 @@ class MSXMapperIO final : public MSXDevice
 {
 public:
 	explicit MSXMapperIO(const DeviceConfig& config);
+	~MSXMapperIO() override;
 
 	byte readIO(word port, EmuTime::param time) override;
 	byte peekIO(word port, EmuTime::param time) const override;
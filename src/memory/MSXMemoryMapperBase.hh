@@ -30,6 +30,7 @@ public:
 	const byte* getReadCacheLine(word start) const override;
 	byte* getWriteCacheLine(word start) const override;
 	byte peekMem(word address, EmuTime::param time) const override;
+	int getMemorySegment(word address) const override { return registers[address >> 14]; }
 	unsigned getBaseSizeAlignment() const override;
 
 	// Subclasses _must_ override this method and
@@ -327,15 +327,39 @@ const byte* MegaFlashRomSCCPlus::getReadCacheLine(word addr) const
 		// read subslot register
 		return nullptr;
 	}
+	if (isSCCRead(addr)) {
+		return nullptr;
+	}
+	return getFlashReadCacheLine(addr);
+}
 
-	if ((configReg & 0xE0) == 0x00) {
-		SCCEnable enable = getSCCEnable();
-		if (((enable == EN_SCC)     && (0x9800 <= addr) && (addr < 0xA000)) ||
-		    ((enable == EN_SCCPLUS) && (0xB800 <= addr) && (addr < 0xC000))) {
-			return nullptr;
-		}
+const byte* MegaFlashRomSCCPlus::getReadCacheLinePartial(
+	word addr, std::bitset<CacheLine::SIZE>& exceptions) const
+{
+	if ((configReg & 0x10) &&
+	    ((addr & CacheLine::HIGH) == (0xFFFF & CacheLine::HIGH))) {
+		// only the subslot register itself isn't cacheable
+		exceptions.set(0xFFFF & CacheLine::LOW);
+		return getFlashReadCacheLine(addr);
 	}
+	if (isSCCRead(addr)) {
+		// most SCC registers read as 0xFF
+		scc.getReadCacheExceptions(exceptions);
+		return unmappedRead;
+	}
+	return getFlashReadCacheLine(addr);
+}
 
+bool MegaFlashRomSCCPlus::isSCCRead(word addr) const
+{
+	if ((configReg & 0xE0) != 0x00) return false;
+	SCCEnable enable = getSCCEnable();
+	return ((enable == EN_SCC)     && (0x9800 <= addr) && (addr < 0xA000)) ||
+	       ((enable == EN_SCCPLUS) && (0xB800 <= addr) && (addr < 0xC000));
+}
+
+const byte* MegaFlashRomSCCPlus::getFlashReadCacheLine(word addr) const
+{
 	if (((configReg & 0xC0) == 0x40) ||
 	    ((0x4000 <= addr) && (addr < 0xC000))) {
 		// read (flash)rom content
@@ -19,6 +19,8 @@ public:
 	byte peekMem(word address, EmuTime::param time) const override;
 	byte readMem(word address, EmuTime::param time) override;
 	const byte* getReadCacheLine(word address) const override;
+	const byte* getReadCacheLinePartial(
+		word address, std::bitset<CacheLine::SIZE>& exceptions) const override;
 	void writeMem(word address, byte value, EmuTime::param time) override;
 	byte* getWriteCacheLine(word address) const override;
 
@@ -32,6 +34,8 @@ private:
 
 	enum SCCEnable { EN_NONE, EN_SCC, EN_SCCPLUS };
 	SCCEnable getSCCEnable() const;
+	bool isSCCRead(word addr) const;
+	const byte* getFlashReadCacheLine(word addr) const;
 
 	unsigned getSubslot(unsigned address) const;
 	unsigned getFlashAddr(unsigned addr) const;
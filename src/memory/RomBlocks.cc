@@ -73,6 +73,12 @@ const byte* RomBlocks<BANK_SIZE>::getReadCacheLine(word address) const
 	return &bankPtr[address / BANK_SIZE][address & BANK_MASK];
 }
 
+template <unsigned BANK_SIZE>
+int RomBlocks<BANK_SIZE>::getMemorySegment(word address) const
+{
+	return blockNr[address / BANK_SIZE];
+}
+
 template <unsigned BANK_SIZE>
 void RomBlocks<BANK_SIZE>::setBank(byte region, const byte* adr, int block)
 {
@@ -83,7 +89,7 @@ void RomBlocks<BANK_SIZE>::setBank(byte region, const byte* adr, int block)
 	                       (adr <= &(*sram)[sram->getSize() - 1])) ||
 	        ((extraMem <= adr) && (adr <= &extraMem[extraSize - 1]))));
 	bankPtr[region] = adr;
-	blockNr[region] = block; // only for debuggable
+	blockNr[region] = block; // for debuggable and profiler
 	fillDeviceRCache(region * BANK_SIZE, BANK_SIZE, adr);
 }
 
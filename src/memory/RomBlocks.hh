@@ -21,6 +21,7 @@ public:
 	byte readMem(word address, EmuTime::param time) override;
 	byte peekMem(word address, EmuTime::param time) const override;
 	const byte* getReadCacheLine(word address) const override;
+	int getMemorySegment(word address) const override;
 
 	template<typename Archive>
 	void serialize(Archive& ar, unsigned version);
@@ -51,7 +52,8 @@ protected:
 	  * @param region number of 8kB region in Z80 address space
 	  *   (region i starts at Z80 address i * 0x2000)
 	  * @param adr pointer to memory, area must be at least 0x2000 bytes long
-	  * @param block Block number, only used for the 'romblock' debuggable.
+	  * @param block Block number, only used for the 'romblock' debuggable
+	  *   and the profiler.
 	  */
 	void setBank(byte region, const byte* adr, int block);
 
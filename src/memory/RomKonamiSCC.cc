@@ -86,6 +86,18 @@ const byte* RomKonamiSCC::getReadCacheLine(word address) const
 	}
 }
 
+const byte* RomKonamiSCC::getReadCacheLinePartial(
+	word address, std::bitset<CacheLine::SIZE>& exceptions) const
+{
+	if (sccEnabled && (0x9800 <= address) && (address < 0xA000)) {
+		// most SCC registers read as 0xFF
+		scc.getReadCacheExceptions(exceptions);
+		return unmappedRead;
+	} else {
+		return getReadCacheLine(address);
+	}
+}
+
 void RomKonamiSCC::writeMem(word address, byte value, EmuTime::param time)
 {
 	if ((address < 0x5000) || (address >= 0xC000)) {
@@ -96,17 +108,21 @@ void RomKonamiSCC::writeMem(word address, byte value, EmuTime::param time)
 		scc.writeMem(address & 0xFF, value, time);
 		return;
 	}
+	if ((address & 0x1800) == 0x1000) {
+		// page selection
+		setRom(address >> 13, value);
+	}
 	if ((address & 0xF800) == 0x9000) {
 		// SCC enable/disable
 		bool newSccEnabled = ((value & 0x3F) == 0x3F);
 		if (newSccEnabled != sccEnabled) {
 			sccEnabled = newSccEnabled;
-			invalidateDeviceRWCache(0x9800, 0x0800);
+			invalidateDeviceWCache(0x9800, 0x0800);
+		}
+		if (sccEnabled) {
+			// setRom() above made the SCC registers cacheable
+			invalidateDeviceRCache(0x9800, 0x0800);
 		}
-	}
-	if ((address & 0x1800) == 0x1000) {
-		// page selection
-		setRom(address >> 13, value);
 	}
 }
 
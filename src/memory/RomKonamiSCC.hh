@@ -16,6 +16,8 @@ public:
 	byte peekMem(word address, EmuTime::param time) const override;
 	byte readMem(word address, EmuTime::param time) override;
 	const byte* getReadCacheLine(word address) const override;
+	const byte* getReadCacheLinePartial(
+		word address, std::bitset<CacheLine::SIZE>& exceptions) const override;
 	void writeMem(word address, byte value, EmuTime::param time) override;
 	byte* getWriteCacheLine(word address) const override;
 
@@ -179,6 +179,7 @@ void MemOutputArchive::save(const std::string& s)
 
 MemBuffer<uint8_t> MemOutputArchive::releaseBuffer(size_t& size)
 {
+	lastDeltaBlocks.finishSnapshot();
 	return buffer.release(size);
 }
 
@@ -215,7 +216,7 @@ void MemOutputArchive::serialize_blob(const char* /*tag*/, const void* data,
                                       size_t len, bool diff)
 {
 	// Delta-compress in-memory blobs, see DeltaBlock.hh for more details.
-	if (len > SMALL_SIZE) {
+	if ((len > SMALL_SIZE) && !inlineBlobs) {
 		auto deltaBlockIdx = unsigned(deltaBlocks.size());
 		save(deltaBlockIdx); // see comment below in MemInputArchive
 		deltaBlocks.push_back(diff
@@ -382,6 +383,12 @@ XmlInputArchive::XmlInputArchive(const string& filename)
 	elems.emplace_back(&rootElem, 0);
 }
 
+XmlInputArchive::XmlInputArchive(XMLElement root)
+	: rootElem(std::move(root))
+{
+	elems.emplace_back(&rootElem, 0);
+}
+
 string_view XmlInputArchive::loadStr()
 {
 	if (!elems.back().first->getChildren().empty()) {
@@ -499,7 +506,7 @@ void XmlInputArchive::load(char& c)
 	c = i;
 }
 
-void XmlInputArchive::beginTag(const char* tag)
+const XMLElement& XmlInputArchive::findNextChild(const char* tag)
 {
 	auto* child = elems.back().first->findNextChild(
 		tag, elems.back().second);
@@ -511,7 +518,11 @@ void XmlInputArchive::beginTag(const char* tag)
 		throw XMLException("No child tag \"", tag,
 		                   "\" found at location \"", path, '\"');
 	}
-	elems.emplace_back(child, 0);
+	return *child;
+}
+void XmlInputArchive::beginTag(const char* tag)
+{
+	elems.emplace_back(&findNextChild(tag), 0);
 }
 void XmlInputArchive::endTag(const char* tag)
 {
@@ -525,6 +536,14 @@ void XmlInputArchive::endTag(const char* tag)
 	elems.pop_back();
 }
 
+XMLElement XmlInputArchive::takeElement(const char* tag)
+{
+	auto& elem = const_cast<XMLElement&>(findNextChild(tag));
+	XMLElement result = std::move(elem);
+	elem.clearName(); // mark this elem for later beginTag() calls
+	return result;
+}
+
 void XmlInputArchive::attribute(const char* name, string& t)
 {
 	try {
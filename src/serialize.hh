@@ -652,6 +652,12 @@ public:
 	bool needVersion() const { return false; }
 	bool isReverseSnapshot() const { return reverseSnapshot; }
 
+	/** Store large blobs inline in the buffer instead of delta-compressing
+	  * them. Then the buffer contains the complete serialized state (e.g.
+	  * to calculate a hash of it), but it can't be loaded anymore.
+	  */
+	void setInlineBlobs() { inlineBlobs = true; }
+
 	template <typename T> void save(const T& t)
 	{
 		put(&t, sizeof(t));
@@ -741,6 +747,7 @@ private:
 	LastDeltaBlocks& lastDeltaBlocks;
 	std::vector<std::shared_ptr<DeltaBlock>>& deltaBlocks;
 	const bool reverseSnapshot;
+	bool inlineBlobs = false;
 };
 
 class MemInputArchive final : public InputArchiveBase<MemInputArchive>
@@ -905,6 +912,16 @@ class XmlInputArchive final : public InputArchiveBase<XmlInputArchive>
 {
 public:
 	explicit XmlInputArchive(const std::string& filename);
+	/** Deserialize from an already parsed document, e.g. an element that
+	  * was earlier taken out of a file with takeElement().
+	  */
+	explicit XmlInputArchive(XMLElement root);
+
+	/** Take the next child element with the given tag out of the document,
+	  * without deserializing it. Together with the constructor above this
+	  * allows to only deserialize parts of a file when they're needed.
+	  */
+	XMLElement takeElement(const char* tag);
 
 	inline bool versionAtLeast(unsigned actual, unsigned required) const
 	{
@@ -974,6 +991,8 @@ public:
 	int countChildren() const;
 
 private:
+	const XMLElement& findNextChild(const char* tag);
+
 	XMLElement rootElem;
 	std::vector<std::pair<const XMLElement*, size_t>> elems;
 };
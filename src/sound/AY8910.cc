@@ -586,6 +586,7 @@ byte AY8910::peekRegister(unsigned reg, EmuTime::param time) const
 void AY8910::writeRegister(unsigned reg, byte value, EmuTime::param time)
 {
 	if (reg >= 16) return;
+	logRegister(VGMWriter::AY8910, 0, reg, value, time);
 	if ((reg < AY_PORTA) && (reg == AY_ESHAPE || regs[reg] != value)) {
 		// Update the output buffer before changing the register.
 		updateStream(time);
@@ -674,6 +675,24 @@ void AY8910::wrtReg(unsigned reg, byte value, EmuTime::param time)
 }
 
 void AY8910::generateChannels(float** bufs, unsigned num)
+{
+	SampleOutput outs[3] = {
+		SampleOutput(bufs[0]), SampleOutput(bufs[1]), SampleOutput(bufs[2])
+	};
+	generate(outs, num);
+	for (unsigned chan = 0; chan < 3; ++chan) {
+		if (!outs[chan]) bufs[chan] = nullptr;
+	}
+}
+
+bool AY8910::generateChannelDeltas(DeltaOutput* outs, unsigned num)
+{
+	generate(outs, num);
+	return true;
+}
+
+template<typename Output>
+void AY8910::generate(Output* outs, unsigned num)
 {
 	// Disable channels with volume 0: since the sample value doesn't matter,
 	// we can use the fastest path.
@@ -684,7 +703,7 @@ void AY8910::generateChannels(float** bufs, unsigned num)
 		    (amplitude.followsEnvelope(chan) &&
 		     !envelope.isChanging() &&
 		     (envelope.getVolume() == 0.0f))) {
-			bufs[chan] = nullptr;
+			outs[chan].disable();
 			tone[chan].advance(num);
 			chanEnable |= 0x09 << chan;
 		}
@@ -708,8 +727,8 @@ void AY8910::generateChannels(float** bufs, unsigned num)
 	Envelope initialEnvelope = envelope;
 	NoiseGenerator initialNoise = noise;
 	for (unsigned chan = 0; chan < 3; ++chan, chanEnable >>= 1) {
-		auto* buf = bufs[chan];
-		if (!buf) continue;
+		auto& out = outs[chan];
+		if (!out) continue;
 		ToneGenerator& t = tone[chan];
 		if (envelope.isChanging() && amplitude.followsEnvelope(chan)) {
 			envelopeUpdated = true;
@@ -722,14 +741,14 @@ void AY8910::generateChannels(float** bufs, unsigned num)
 				unsigned nextT = t.getNextEventTime();
 				while ((nextT <= remaining) || (nextE <= remaining)) {
 					if (nextT < nextE) {
-						addFill(buf, val, nextT);
+						out.fill(val, nextT);
 						remaining -= nextT;
 						nextE -= nextT;
 						envelope.advanceFast(nextT);
 						t.doNextEvent(*this);
 						nextT = t.getNextEventTime();
 					} else if (nextE < nextT) {
-						addFill(buf, val, nextE);
+						out.fill(val, nextE);
 						remaining -= nextE;
 						nextT -= nextE;
 						t.advanceFast(nextE);
@@ -737,7 +756,7 @@ void AY8910::generateChannels(float** bufs, unsigned num)
 						nextE = envelope.getNextEventTime();
 					} else {
 						assert(nextT == nextE);
-						addFill(buf, val, nextT);
+						out.fill(val, nextT);
 						remaining -= nextT;
 						t.doNextEvent(*this);
 						nextT = t.getNextEventTime();
@@ -748,7 +767,7 @@ void AY8910::generateChannels(float** bufs, unsigned num)
 				}
 				if (remaining) {
 					// last interval (without events)
-					addFill(buf, val, remaining);
+					out.fill(val, remaining);
 					t.advanceFast(remaining);
 					envelope.advanceFast(remaining);
 				}
@@ -759,7 +778,7 @@ void AY8910::generateChannels(float** bufs, unsigned num)
 				unsigned remaining = num;
 				unsigned next = envelope.getNextEventTime();
 				while (next <= remaining) {
-					addFill(buf, val, next);
+					out.fill(val, next);
 					remaining -= next;
 					envelope.doNextEvent();
 					val = envelope.getVolume();
@@ -767,7 +786,7 @@ void AY8910::generateChannels(float** bufs, unsigned num)
 				}
 				if (remaining) {
 					// last interval (without events)
-					addFill(buf, val, remaining);
+					out.fill(val, remaining);
 					envelope.advanceFast(remaining);
 				}
 				t.advance(num);
@@ -782,7 +801,7 @@ void AY8910::generateChannels(float** bufs, unsigned num)
 				unsigned nextE = envelope.getNextEventTime();
 				unsigned next = std::min(std::min(nextT, nextN), nextE);
 				while (next <= remaining) {
-					addFill(buf, val, next);
+					out.fill(val, next);
 					remaining -= next;
 					nextT -= next;
 					nextN -= next;
@@ -810,7 +829,7 @@ void AY8910::generateChannels(float** bufs, unsigned num)
 				}
 				if (remaining) {
 					// last interval (without events)
-					addFill(buf, val, remaining);
+					out.fill(val, remaining);
 					t.advanceFast(remaining);
 					noise.advanceFast(remaining);
 					envelope.advanceFast(remaining);
@@ -825,14 +844,14 @@ void AY8910::generateChannels(float** bufs, unsigned num)
 				unsigned nextN = noise.getNextEventTime();
 				while ((nextN <= remaining) || (nextE <= remaining)) {
 					if (nextN < nextE) {
-						addFill(buf, val, nextN);
+						out.fill(val, nextN);
 						remaining -= nextN;
 						nextE -= nextN;
 						envelope.advanceFast(nextN);
 						noise.doNextEvent();
 						nextN = noise.getNextEventTime();
 					} else if (nextE < nextN) {
-						addFill(buf, val, nextE);
+						out.fill(val, nextE);
 						remaining -= nextE;
 						nextN -= nextE;
 						noise.advanceFast(nextE);
@@ -840,7 +859,7 @@ void AY8910::generateChannels(float** bufs, unsigned num)
 						nextE = envelope.getNextEventTime();
 					} else {
 						assert(nextN == nextE);
-						addFill(buf, val, nextN);
+						out.fill(val, nextN);
 						remaining -= nextN;
 						noise.doNextEvent();
 						nextN = noise.getNextEventTime();
@@ -851,7 +870,7 @@ void AY8910::generateChannels(float** bufs, unsigned num)
 				}
 				if (remaining) {
 					// last interval (without events)
-					addFill(buf, val, remaining);
+					out.fill(val, remaining);
 					noise.advanceFast(remaining);
 					envelope.advanceFast(remaining);
 				}
@@ -868,7 +887,7 @@ void AY8910::generateChannels(float** bufs, unsigned num)
 				unsigned remaining = num;
 				unsigned next = t.getNextEventTime();
 				while (next <= remaining) {
-					addFill(buf, val, next);
+					out.fill(val, next);
 					val = volume - val;
 					remaining -= next;
 					t.doNextEvent(*this);
@@ -876,13 +895,13 @@ void AY8910::generateChannels(float** bufs, unsigned num)
 				}
 				if (remaining) {
 					// last interval (without events)
-					addFill(buf, val, remaining);
+					out.fill(val, remaining);
 					t.advanceFast(remaining);
 				}
 
 			} else if ((chanEnable & 0x09) == 0x09) {
 				// no noise, channel disabled: always 1.
-				addFill(buf, volume, num);
+				out.fill(volume, num);
 				t.advance(num);
 
 			} else if ((chanEnable & 0x09) == 0x00) {
@@ -895,7 +914,7 @@ void AY8910::generateChannels(float** bufs, unsigned num)
 				unsigned nextT = t.getNextEventTime();
 				while ((nextN <= remaining) || (nextT <= remaining)) {
 					if (nextT < nextN) {
-						addFill(buf, val2, nextT);
+						out.fill(val2, nextT);
 						remaining -= nextT;
 						nextN -= nextT;
 						noise.advanceFast(nextT);
@@ -904,7 +923,7 @@ void AY8910::generateChannels(float** bufs, unsigned num)
 						val1 = volume - val1;
 						val2 = val1 * noise.getOutput();
 					} else if (nextN < nextT) {
-						addFill(buf, val2, nextN);
+						out.fill(val2, nextN);
 						remaining -= nextN;
 						nextT -= nextN;
 						t.advanceFast(nextN);
@@ -913,7 +932,7 @@ void AY8910::generateChannels(float** bufs, unsigned num)
 						val2 = val1 * noise.getOutput();
 					} else {
 						assert(nextT == nextN);
-						addFill(buf, val2, nextT);
+						out.fill(val2, nextT);
 						remaining -= nextT;
 						t.doNextEvent(*this);
 						nextT = t.getNextEventTime();
@@ -925,7 +944,7 @@ void AY8910::generateChannels(float** bufs, unsigned num)
 				}
 				if (remaining) {
 					// last interval (without events)
-					addFill(buf, val2, remaining);
+					out.fill(val2, remaining);
 					t.advanceFast(remaining);
 					noise.advanceFast(remaining);
 				}
@@ -937,7 +956,7 @@ void AY8910::generateChannels(float** bufs, unsigned num)
 				auto val = noise.getOutput() * volume;
 				unsigned next = noise.getNextEventTime();
 				while (next <= remaining) {
-					addFill(buf, val, next);
+					out.fill(val, next);
 					remaining -= next;
 					noise.doNextEvent();
 					val = noise.getOutput() * volume;
@@ -945,7 +964,7 @@ void AY8910::generateChannels(float** bufs, unsigned num)
 				}
 				if (remaining) {
 					// last interval (without events)
-					addFill(buf, val, remaining);
+					out.fill(val, remaining);
 					noise.advanceFast(remaining);
 				}
 				t.advance(num);
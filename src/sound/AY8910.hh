@@ -161,6 +161,11 @@ private:
 	void generateChannels(float** bufs, unsigned num) override;
 	float getAmplificationFactorImpl() const override;
 
+	// ResampledSoundDevice
+	bool generateChannelDeltas(DeltaOutput* outs, unsigned num) override;
+
+	template<typename Output> void generate(Output* outs, unsigned num);
+
 	// Observer<Setting>
 	void update(const Setting& setting) override;
 
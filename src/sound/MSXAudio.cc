@@ -1,4 +1,5 @@
 #include "MSXAudio.hh"
+#include "MSXCPUInterface.hh"
 #include "Y8950Periphery.hh"
 #include "DACSound8U.hh"
 #include "StringOp.hh"
@@ -25,10 +26,12 @@ MSXAudio::MSXAudio(const DeviceConfig& config)
 			config);
 	}
 	powerUp(getCurrentTime());
+	getCPUInterface().registerFastIO(*this);
 }
 
 MSXAudio::~MSXAudio()
 {
+	getCPUInterface().unregisterFastIO(*this);
 	// delete soon, because PanasonicAudioPeriphery still uses
 	// this object in its destructor
 	periphery.reset();
@@ -1,5 +1,6 @@
 #include "MSXFmPac.hh"
 #include "CacheLine.hh"
+#include "MSXCPUInterface.hh"
 #include "serialize.hh"
 
 namespace openmsx {
@@ -12,6 +13,12 @@ MSXFmPac::MSXFmPac(const DeviceConfig& config)
 	, romBlockDebug(*this, &bank, 0x4000, 0x4000, 14)
 {
 	reset(getCurrentTime());
+	getCPUInterface().registerFastIO(*this);
+}
+
+MSXFmPac::~MSXFmPac()
+{
+	getCPUInterface().unregisterFastIO(*this);
 }
 
 void MSXFmPac::reset(EmuTime::param time)
@@ -12,6 +12,7 @@ class MSXFmPac final : public MSXMusicBase
 {
 public:
 	explicit MSXFmPac(const DeviceConfig& config);
+	~MSXFmPac() override;
 
 	void reset(EmuTime::param time) override;
 	void writeIO(word port, byte value, EmuTime::param time) override;
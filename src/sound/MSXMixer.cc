@@ -11,6 +11,7 @@
 #include "BooleanSetting.hh"
 #include "CommandException.hh"
 #include "AviRecorder.hh"
+#include "VGMWriter.hh"
 #include "Filename.hh"
 #include "CliComm.hh"
 #include "stl.hh"
@@ -46,6 +47,11 @@ MSXMixer::MSXMixer(Mixer& mixer_, MSXMotherBoard& motherBoard_,
 	, throttleManager(globalSettings.getThrottleManager())
 	, prevTime(getCurrentTime(), 44100)
 	, soundDeviceInfo(commandController.getMachineInfoCommand())
+	, registerLogSetting(
+		commandController, "vgm_log",
+		"filename to log the sound chip register writes to (VGM format), "
+		"set to an empty string to stop logging",
+		std::string_view{}, Setting::DONT_SAVE)
 	, recorder(nullptr)
 	, synchronousCounter(0)
 {
@@ -60,6 +66,7 @@ MSXMixer::MSXMixer(Mixer& mixer_, MSXMotherBoard& motherBoard_,
 	masterVolume.attach(*this);
 	speedSetting.attach(*this);
 	throttleManager.attach(*this);
+	registerLogSetting.attach(*this);
 }
 
 MSXMixer::~MSXMixer()
@@ -69,6 +76,10 @@ MSXMixer::~MSXMixer()
 	}
 	assert(infos.empty());
 
+	registerLogSetting.detach(*this);
+	if (registerLog) {
+		registerLog->flush(getCurrentTime());
+	}
 	throttleManager.detach(*this);
 	speedSetting.detach(*this);
 	masterVolume.detach(*this);
@@ -83,6 +94,7 @@ void MSXMixer::registerSound(SoundDevice& device, float volume,
 	const string& name = device.getName();
 	SoundDeviceInfo info;
 	info.device = &device;
+	device.setRegisterLog(registerLog.get());
 	info.defaultVolume = volume;
 	info.volumeSetting = std::make_unique<IntegerSetting>(
 		commandController, name + "_volume",
@@ -180,6 +192,9 @@ void MSXMixer::updateStream(EmuTime::param time)
 	if (recorder) {
 		recorder->addWave(count, mixBuffer);
 	}
+	if (outputSink) {
+		outputSink(count, mixBuffer);
+	}
 
 	prevTime += count;
 }
@@ -600,6 +615,14 @@ void MSXMixer::setRecorder(AviRecorder* newRecorder)
 	recorder = newRecorder;
 }
 
+void MSXMixer::setOutputSink(OutputSink sink)
+{
+	if (bool(outputSink) != bool(sink)) {
+		setSynchronousMode(bool(sink));
+	}
+	outputSink = std::move(sink);
+}
+
 void MSXMixer::update(const Setting& setting)
 {
 	if (&setting == &masterVolume) {
@@ -621,6 +644,8 @@ void MSXMixer::update(const Setting& setting)
 				return (i.volumeSetting .get() == &setting) ||
 				       (i.balanceSetting.get() == &setting); });
 		updateVolumeParams(*it);
+	} else if (&setting == &registerLogSetting) {
+		changeRegisterLogSetting();
 	} else if (dynamic_cast<const StringSetting*>(&setting)) {
 		changeRecordSetting(setting);
 	} else if (dynamic_cast<const BooleanSetting*>(&setting)) {
@@ -647,6 +672,24 @@ void MSXMixer::changeRecordSetting(const Setting& setting)
 	UNREACHABLE;
 }
 
+void MSXMixer::changeRegisterLogSetting()
+{
+	auto time = getCurrentTime();
+	if (registerLog) {
+		registerLog->flush(time);
+		registerLog.reset();
+	}
+	auto filename = registerLogSetting.getString();
+	if (!filename.empty()) {
+		registerLog = std::make_unique<VGMWriter>(
+			Filename(string(filename)), time,
+			commandController.getCliComm());
+	}
+	for (auto& info : infos) {
+		info.device->setRegisterLog(registerLog.get());
+	}
+}
+
 void MSXMixer::changeMuteSetting(const Setting& setting)
 {
 	for (auto& info : infos) {
@@ -4,8 +4,10 @@
 #include "Schedulable.hh"
 #include "Observer.hh"
 #include "InfoTopic.hh"
+#include "StringSetting.hh"
 #include "EmuTime.hh"
 #include "DynamicClock.hh"
+#include <functional>
 #include <vector>
 #include <memory>
 
@@ -18,10 +20,10 @@ class MSXCommandController;
 class GlobalSettings;
 class ThrottleManager;
 class IntegerSetting;
-class StringSetting;
 class BooleanSetting;
 class Setting;
 class AviRecorder;
+class VGMWriter;
 
 class MSXMixer final : private Schedulable, private Observer<Setting>
                      , private Observer<ThrottleManager>
@@ -84,6 +86,13 @@ public:
 	void mute();
 	void unmute();
 
+	/** Is the generated sound not used at all? True when muted (e.g.
+	  * while fast-forwarding) and not recording.
+	  */
+	bool isOutputUnused() const {
+		return (muteCount || !fragmentSize) && !recorder && !outputSink;
+	}
+
 	// Called by Mixer or SoundDriver
 
 	/** Set new fragment size and sample frequency.
@@ -106,6 +115,14 @@ public:
 	bool needStereoRecording() const;
 	void setRecorder(AviRecorder* recorder);
 
+	/** Also pass the mixed output (stereo, at the host sample rate) to
+	  * the given function. Used to render without a sound driver, see
+	  * SoundChipTest.cc. Like recording, this makes the mixer run at
+	  * 100% emutime speed. Pass an empty function to stop.
+	  */
+	using OutputSink = std::function<void(unsigned num, const float* data)>;
+	void setOutputSink(OutputSink sink);
+
 	// Returns the nominal host sample rate (not adjusted for speed setting)
 	unsigned getSampleRate() const { return hostSampleRate; }
 
@@ -143,6 +160,7 @@ private:
 
 	void changeRecordSetting(const Setting& setting);
 	void changeMuteSetting(const Setting& setting);
+	void changeRegisterLogSetting();
 
 	unsigned fragmentSize;
 	unsigned hostSampleRate; // requested freq by sound driver,
@@ -168,7 +186,11 @@ private:
 		void tabCompletion(std::vector<std::string>& tokens) const override;
 	} soundDeviceInfo;
 
+	StringSetting registerLogSetting;
+	std::unique_ptr<VGMWriter> registerLog;
+
 	AviRecorder* recorder;
+	OutputSink outputSink;
 	unsigned synchronousCounter;
 
 	unsigned muteCount;
@@ -3,6 +3,7 @@
 #include "LedStatus.hh"
 #include "CassettePort.hh"
 #include "MSXMotherBoard.hh"
+#include "MSXCPUInterface.hh"
 #include "JoystickPort.hh"
 #include "RenShaTurbo.hh"
 #include "serialize.hh"
@@ -26,10 +27,12 @@ MSXPSG::MSXPSG(const DeviceConfig& config)
 	ay8910 = std::make_unique<AY8910>("PSG", *this, config, getCurrentTime());
 
 	reset(getCurrentTime());
+	getCPUInterface().registerFastIO(*this);
 }
 
 MSXPSG::~MSXPSG()
 {
+	getCPUInterface().unregisterFastIO(*this);
 	powerDown(EmuTime::dummy());
 }
 
@@ -1,4 +1,5 @@
 #include "MSXTurboRPCM.hh"
+#include "MSXCPUInterface.hh"
 #include "MSXMotherBoard.hh"
 #include "MSXMixer.hh"
 #include "serialize.hh"
@@ -15,10 +16,12 @@ MSXTurboRPCM::MSXTurboRPCM(const DeviceConfig& config)
 	, hwMute(false)
 {
 	reset(getCurrentTime());
+	getCPUInterface().registerFastIO(*this);
 }
 
 MSXTurboRPCM::~MSXTurboRPCM()
 {
+	getCPUInterface().unregisterFastIO(*this);
 	hardwareMute(false);
 }
 
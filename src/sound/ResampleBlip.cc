@@ -24,6 +24,21 @@ bool ResampleBlip<CHANNELS>::generateOutput(float* dataOut, unsigned hostNum,
                                             EmuTime::param time)
 {
 	unsigned emuNum = emuClock.getTicksTill(time);
+	if ((emuNum > 0) && (CHANNELS == 1)) {
+		// Devices that generate constant-valued segments (e.g. square
+		// waves) can directly produce the amplitude changes. This avoids
+		// rendering (and scanning) the samples at the native rate.
+		EmuTime emu1 = emuClock.getFastAdd(1); // time of 1st emu-sample
+		assert(emu1 > hostClock.getTime());
+		FP pos1;
+		hostClock.getTicksTill(emu1, pos1);
+		if (input.generateDeltas(blip[0], pos1, step, emuNum, lastInput[0])) {
+			emuClock += emuNum;
+			assert(emuClock.getTime() <= time);
+			assert(emuClock.getFastAdd(1) > time);
+			emuNum = 0;
+		}
+	}
 	if (emuNum > 0) {
 		// 3 extra for padding, CHANNELS extra for sentinel
 		// Clang will produce a link error if the length expression is put
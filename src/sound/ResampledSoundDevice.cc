@@ -8,6 +8,7 @@
 #include "GlobalSettings.hh"
 #include "EnumSetting.hh"
 #include "unreachable.hh"
+#include "vla.hh"
 #include <cassert>
 #include <memory>
 
@@ -46,6 +47,42 @@ bool ResampledSoundDevice::generateInput(float* buffer, unsigned num)
 	return mixChannels(buffer, num);
 }
 
+bool ResampledSoundDevice::generateDeltas(
+	BlipBuffer& blip, BlipPos pos, BlipPos step, unsigned num, float& last)
+{
+	// Muted, recorded or panned channels need their individual output.
+	if (!isPlainMonoMix()) return false;
+
+	assert(num > 0);
+	unsigned channels = getNumChannels();
+	VLA(DeltaOutput, outs, channels);
+	for (unsigned i = 0; i < channels; ++i) {
+		outs[i] = DeltaOutput(blip, pos, step);
+	}
+	if (!generateChannelDeltas(outs, num)) return false;
+
+	// Channels are mixed by summing them, so the deltas of the individual
+	// channels can be added separately. Only the step between the previous
+	// and the first sample of this batch must be calculated on the sum.
+	float first = 0.0f;
+	float newLast = 0.0f;
+	for (unsigned i = 0; i < channels; ++i) {
+		first   += outs[i].getFirst();
+		newLast += outs[i].getLast();
+	}
+	if (first != last) {
+		blip.addDelta(BlipBuffer::TimeIndex(pos), first - last);
+	}
+	last = newLast;
+	return true;
+}
+
+bool ResampledSoundDevice::generateChannelDeltas(
+	DeltaOutput* /*outs*/, unsigned /*num*/)
+{
+	return false;
+}
+
 
 void ResampledSoundDevice::update(const Setting& setting)
 {
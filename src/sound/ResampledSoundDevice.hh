@@ -2,6 +2,7 @@
 #define RESAMPLEDSOUNDDEVICE_HH
 
 #include "SoundDevice.hh"
+#include "BlipBuffer.hh"
 #include "Observer.hh"
 #include <memory>
 
@@ -23,7 +24,75 @@ public:
 	  */
 	bool generateInput(float* buffer, unsigned num);
 
+	using BlipPos = FixedPoint<16>;
+
+	/** Alternative for generateInput() used by the blip resampler.
+	  * Instead of first rendering 'num' samples at the native rate, the
+	  * amplitude changes of the (mono) output are directly added to the
+	  * given BlipBuffer.
+	  * @param blip Destination for the amplitude changes.
+	  * @param pos Position (in output samples) of the first native sample.
+	  * @param step Distance (in output samples) between native samples.
+	  * @param num Number of native samples.
+	  * @param last Output value right before the first native sample, on
+	  *             return it's updated to the value of the last sample.
+	  * @result false iff this device (currently) can't generate deltas,
+	  *         in that case nothing was generated and the caller must
+	  *         fall back to generateInput().
+	  */
+	bool generateDeltas(BlipBuffer& blip, BlipPos pos, BlipPos step,
+	                    unsigned num, float& last);
+
 protected:
+	/** Output of a single channel as samples at the native rate. */
+	class SampleOutput {
+	public:
+		explicit SampleOutput(float* buf_ = nullptr) : buf(buf_) {}
+		explicit operator bool() const { return buf != nullptr; }
+		void disable() { buf = nullptr; }
+		void fill(float value, unsigned num) { addFill(buf, value, num); }
+
+	private:
+		float* buf;
+	};
+
+	/** Output of a single channel as amplitude changes in a BlipBuffer.
+	  * Has the same interface as SampleOutput, so that a device can use
+	  * the same (templatized) code to implement both generateChannels()
+	  * and generateChannelDeltas().
+	  */
+	class DeltaOutput {
+	public:
+		DeltaOutput() = default;
+		DeltaOutput(BlipBuffer& blip_, BlipPos pos_, BlipPos step_)
+			: blip(&blip_), pos(pos_), step(step_) {}
+		explicit operator bool() const { return enabled; }
+		void disable() { enabled = false; }
+		void fill(float value, unsigned num) {
+			if (idx == 0) {
+				// first value: discontinuity is handled by caller
+				first = last = value;
+			} else if (value != last) {
+				blip->addDelta(BlipBuffer::TimeIndex(pos + step * int(idx)),
+				               value - last);
+				last = value;
+			}
+			idx += num;
+		}
+		float getFirst() const { return first; }
+		float getLast() const { return last; }
+
+	private:
+		BlipBuffer* blip = nullptr;
+		BlipPos pos;
+		BlipPos step;
+		unsigned idx = 0;
+		float first = 0.0f;
+		float last = 0.0f;
+		bool enabled = true;
+	};
+
+
 	ResampledSoundDevice(MSXMotherBoard& motherBoard, std::string_view name,
 	                     std::string_view description, unsigned channels,
 	                     unsigned inputSampleRate, bool stereo);
@@ -39,6 +108,17 @@ protected:
 
 	void createResampler();
 
+	/** Can optionally be implemented by devices whose output consists of
+	  * constant-valued segments (e.g. square waves). Same as
+	  * generateChannels(), but each channel reports its amplitude changes.
+	  * Unlike generateChannels(), the channels are not summed into
+	  * buffers, so 'outs[i].fill()' must be called with the actual
+	  * channel value, and not calling fill() means the channel is silent.
+	  * @result false iff not implemented (the default). In that case the
+	  *         device state must not have been changed.
+	  */
+	virtual bool generateChannelDeltas(DeltaOutput* outs, unsigned num);
+
 private:
 	EnumSetting<ResampleType>& resampleSetting;
 	std::unique_ptr<ResampleAlgo> algo;
@@ -250,6 +250,31 @@ byte SCC::peekMem(byte address, EmuTime::param time) const
 	return result;
 }
 
+void SCC::getReadCacheExceptions(std::bitset<CacheLine::SIZE>& exceptions) const
+{
+	static_assert(CacheLine::SIZE == 0x100);
+	auto set = [&](unsigned begin, unsigned end) {
+		for (unsigned i = begin; i < end; ++i) exceptions.set(i);
+	};
+	// see peekMem() and readMem()
+	switch (currentChipMode) {
+	case SCC_Real:
+		set(0x00, 0x80); // wave form 1..4
+		set(0xE0, 0x100); // deformation register
+		break;
+	case SCC_Compatible:
+		set(0x00, 0x80); // wave form 1..4
+		set(0xA0, 0xE0); // wave form 5, deformation register
+		break;
+	case SCC_plusmode:
+		set(0x00, 0xA0); // wave form 1..5
+		set(0xC0, 0xE0); // deformation register
+		break;
+	default:
+		UNREACHABLE;
+	}
+}
+
 byte SCC::readWave(unsigned channel, unsigned address, EmuTime::param time) const
 {
 	if (!rotate[channel]) {
@@ -294,7 +319,7 @@ void SCC::writeMem(byte address, byte value, EmuTime::param time)
 	case SCC_Real:
 		if (address < 0x80) {
 			// 0x00..0x7F : write wave form 1..4
-			writeWave(address >> 5, address, value);
+			writeWave(address >> 5, address, value, time);
 		} else if (address < 0xA0) {
 			// 0x80..0x9F : freq volume block
 			setFreqVol(address, value, time);
@@ -308,7 +333,7 @@ void SCC::writeMem(byte address, byte value, EmuTime::param time)
 	case SCC_Compatible:
 		if (address < 0x80) {
 			// 0x00..0x7F : write wave form 1..4
-			writeWave(address >> 5, address, value);
+			writeWave(address >> 5, address, value, time);
 		} else if (address < 0xA0) {
 			// 0x80..0x9F : freq volume block
 			setFreqVol(address, value, time);
@@ -324,7 +349,7 @@ void SCC::writeMem(byte address, byte value, EmuTime::param time)
 	case SCC_plusmode:
 		if (address < 0xA0) {
 			// 0x00..0x9F : write wave form 1..5
-			writeWave(address >> 5, address, value);
+			writeWave(address >> 5, address, value, time);
 		} else if (address < 0xC0) {
 			// 0xA0..0xBF : freq volume block
 			setFreqVol(address, value, time);
@@ -353,12 +378,19 @@ inline float SCC::adjust(signed char wav, byte vol)
 	return float((int(wav) * vol) >> 4);
 }
 
-void SCC::writeWave(unsigned channel, unsigned address, byte value)
+void SCC::writeWave(unsigned channel, unsigned address, byte value,
+                    EmuTime::param time)
 {
 	// write to channel 5 only possible in SCC+ mode
 	assert(channel < 5);
 	assert((channel != 4) || (currentChipMode == SCC_plusmode));
 
+	// VGM port 0 has the K051649 layout (waveform 4 and 5 are shared),
+	// port 4 is the K052539 layout with all 5 waveforms (0x00-0x9F).
+	logRegister(VGMWriter::K051649,
+	            (currentChipMode == SCC_plusmode) ? 4 : 0,
+	            channel * 32 + (address & 0x1F), value, time);
+
 	if (!readOnly[channel]) {
 		unsigned p = address & 0x1F;
 		wave[channel][p] = value;
@@ -374,6 +406,14 @@ void SCC::writeWave(unsigned channel, unsigned address, byte value)
 void SCC::setFreqVol(unsigned address, byte value, EmuTime::param time)
 {
 	address &= 0x0F; // region is visible twice
+	if (address < 0x0A) {
+		logRegister(VGMWriter::K051649, 1, address, value, time);
+	} else if (address < 0x0F) {
+		logRegister(VGMWriter::K051649, 2, address - 0x0A, value, time);
+	} else {
+		logRegister(VGMWriter::K051649, 3, 0, value, time);
+	}
+
 	if (address < 0x0A) {
 		// change frequency
 		unsigned channel = address / 2;
@@ -419,6 +459,7 @@ void SCC::setDeformReg(byte value, EmuTime::param time)
 	if (value == deformValue) {
 		return;
 	}
+	logRegister(VGMWriter::K051649, 5, 0, value, time);
 	deformTimer.advance(time);
 	setDeformRegHelper(value);
 }
@@ -464,6 +505,25 @@ void SCC::setDeformRegHelper(byte value)
 }
 
 void SCC::generateChannels(float** bufs, unsigned num)
+{
+	SampleOutput outs[5] = {
+		SampleOutput(bufs[0]), SampleOutput(bufs[1]), SampleOutput(bufs[2]),
+		SampleOutput(bufs[3]), SampleOutput(bufs[4])
+	};
+	generate(outs, num);
+	for (unsigned i = 0; i < 5; ++i) {
+		if (!outs[i]) bufs[i] = nullptr; // channel muted
+	}
+}
+
+bool SCC::generateChannelDeltas(DeltaOutput* outs, unsigned num)
+{
+	generate(outs, num);
+	return true;
+}
+
+template<typename Output>
+void SCC::generate(Output* outs, unsigned num)
 {
 	unsigned enable = ch_enable;
 	for (unsigned i = 0; i < 5; ++i, enable >>= 1) {
@@ -473,22 +533,41 @@ void SCC::generateChannels(float** bufs, unsigned num)
 			unsigned pos2 = pos[i];
 			unsigned incr2 = incr[i];
 			unsigned period2 = period[i] + 1;
-			for (unsigned j = 0; j < num; ++j) {
-				bufs[i][j] += out2;
-				count2 += incr2;
+			if (incr2 == 0) {
+				// frozen channel, output stays constant
+				outs[i].fill(out2, num);
+				continue;
+			}
+			// Output only changes when the waveform index changes,
+			// so produce whole runs of equal samples at once.
+			unsigned remaining = num;
+			while (true) {
+				// number of samples till the next waveform index
+				unsigned next = (count2 < period2)
+				              ? (period2 - count2 + incr2 - 1) / incr2
+				              : 1;
+				if (next > remaining) break;
+				outs[i].fill(out2, next);
+				remaining -= next;
+				count2 += next * incr2;
 				// Note: only for very small periods
 				//       this will take more than 1 iteration
-				while (unlikely(count2 >= period2)) {
+				do {
 					count2 -= period2;
 					pos2 = (pos2 + 1) % 32;
-					out2 = volAdjustedWave[i][pos2];
-				}
+				} while (unlikely(count2 >= period2));
+				out2 = volAdjustedWave[i][pos2];
+			}
+			if (remaining) {
+				// last interval (without events)
+				outs[i].fill(out2, remaining);
+				count2 += remaining * incr2;
 			}
 			out[i] = out2;
 			count[i] = count2;
 			pos[i] = pos2;
 		} else {
-			bufs[i] = nullptr; // channel muted
+			outs[i].disable();
 			// Update phase counter.
 			unsigned newCount = count[i] + num * incr[i];
 			count[i] = newCount % (period[i] + 1);
@@ -530,7 +609,7 @@ void SCC::Debuggable::write(unsigned address, byte value, EmuTime::param time)
 	auto& scc = OUTER(SCC, debuggable);
 	if (address < 0xA0) {
 		// read wave form 1..5
-		scc.writeWave(address >> 5, address, value);
+		scc.writeWave(address >> 5, address, value, time);
 	} else if (address < 0xC0) {
 		// freq volume block
 		scc.setFreqVol(address, value, time);
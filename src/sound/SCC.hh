@@ -3,8 +3,10 @@
 
 #include "ResampledSoundDevice.hh"
 #include "SimpleDebuggable.hh"
+#include "CacheLine.hh"
 #include "Clock.hh"
 #include "openmsx.hh"
+#include <bitset>
 
 namespace openmsx {
 
@@ -22,6 +24,12 @@ public:
 	void reset(EmuTime::param time);
 	byte readMem(byte address,EmuTime::param time);
 	byte peekMem(byte address,EmuTime::param time) const;
+	/** Set the bits for the addresses (in the 256 byte register window)
+	  * that can't be cached, for the current chip mode: the wave data
+	  * (rotation) and the deformation register (reading has a side
+	  * effect). All other addresses always read as 0xFF.
+	  */
+	void getReadCacheExceptions(std::bitset<CacheLine::SIZE>& exceptions) const;
 	void writeMem(byte address, byte value, EmuTime::param time);
 	void setChipMode(ChipMode newMode);
 
@@ -33,9 +41,15 @@ private:
 	float getAmplificationFactorImpl() const override;
 	void generateChannels(float** bufs, unsigned num) override;
 
+	// ResampledSoundDevice
+	bool generateChannelDeltas(DeltaOutput* outs, unsigned num) override;
+
+	template<typename Output> void generate(Output* outs, unsigned num);
+
 	inline float adjust(signed char wav, byte vol);
 	byte readWave(unsigned channel, unsigned address, EmuTime::param time) const;
-	void writeWave(unsigned channel, unsigned address, byte value);
+	void writeWave(unsigned channel, unsigned address, byte value,
+	               EmuTime::param time);
 	void setDeformReg(byte value, EmuTime::param time);
 	void setDeformRegHelper(byte value);
 	void setFreqVol(unsigned address, byte value, EmuTime::param time);
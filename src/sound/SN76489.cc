@@ -140,6 +140,7 @@ void SN76489::reset(EmuTime::param time)
 
 void SN76489::write(byte value, EmuTime::param time)
 {
+	logRegister(VGMWriter::SN76489, 0, 0, value, time);
 	if (value & 0x80) {
 		registerLatch = (value & 0x70) >> 4;
 	}
@@ -0,0 +1,1015 @@
+// Benchmark and regression test for the sound chip emulation cores.
+//
+// Like YM2413Test.cc this is a standalone program, it's not part of the
+// regular openMSX build. It does link against the other openMSX objects
+// (everything except main.cc), with meson use:
+//    ninja soundchipbench && ./soundchipbench [options] [<chip>[=<log>]...]
+//
+// For each chip a register log is played: the register writes are applied
+// at the requested sample positions and in between the chip's output is
+// generated (at the chip's native sample rate) via generateChannels(). For
+// each run the speed (in samples per second) and a sha1 sum of the output
+// is reported. Then the log is played once more on a new instance of the
+// chip, now the output goes through the MSXMixer (volume, balance,
+// resampling to 44100Hz) like in the emulator, and that output gets a sha1
+// sum as well. The sha1 sums are compared against the golden data file,
+// so optimizations can quickly be verified to not change the output. (This
+// also covers the YMF278 wave part: the built-in YMF278 log uses all sample
+// formats, LFO/vibrato and AM on all 24 slots.)
+//
+// Options:
+//   -golden <file>  golden data file (default: SoundChipTest.golden)
+//   -update         store the current results in the golden data file
+//                   (without it, a missing file or entry is an error)
+//   -wav <prefix>   also write the output of the mixer to <prefix><chip>.wav
+//   -list           list the supported chips
+//
+// The VLM5030 needs its voice ROM, which is not distributed with openMSX.
+// Without the ROM that chip is skipped, so SoundChipTest.golden has no entry
+// for it.
+//
+// Without a log file, a built-in log is played. This log plays random notes
+// on all voices of the chip for one minute. A log file is a text file with
+// one register write per line:
+//    <sample> <register> <value>
+// The sample number is (in decimal) the position of the write in the chip's
+// native samples. Register and value can be given in decimal or in hex (with
+// a 0x prefix). Empty lines and lines starting with '#' are ignored. The
+// log must be sorted on sample number. After the last write, one more second
+// of output is generated.
+//
+// A log can also be a VGM file (e.g. recorded with the 'vgm_log' setting).
+// Then the register writes for the (first instance of the) chip are taken
+// from the VGM file. The result is an offline render of the VGM file, at
+// maximum speed and without the rest of the emulator.
+//
+// The meaning of 'register' is chip specific:
+//   - YMF262: register 0x000-0x1FF
+//   - YMF278: the registers of the wave part (the FM part is a YMF262)
+//   - Y8950: registers 0x00-0xFF, the DAC of the MSX-AUDIO is not used
+//   - SN76489: ignored, the value is written to the single data port
+//   - VLM5030: 0 -> latch data, 1 -> control pins (RST/ST/VCU)
+//   - all others: the chip's register number
+
+#include "AY8910.hh"
+#include "AY8910Periphery.hh"
+#include "SCC.hh"
+#include "YM2413.hh"
+#include "YMF262.hh"
+#include "YMF278.hh"
+#include "MSXAudio.hh"
+#include "YM2151.hh"
+#include "SN76489.hh"
+#include "VLM5030.hh"
+#include "MSXMixer.hh"
+#include "Reactor.hh"
+#include "Interpreter.hh"
+#include "MSXMotherBoard.hh"
+#include "HardwareConfig.hh"
+#include "DeviceConfig.hh"
+#include "XMLElement.hh"
+#include "DynamicClock.hh"
+#include "MSXException.hh"
+#include "MemBuffer.hh"
+#include "Thread.hh"
+#include "Timer.hh"
+#include "WavWriter.hh"
+#include "File.hh"
+#include "Filename.hh"
+#include "endian.hh"
+#include "sha1.hh"
+#include "Math.hh"
+#include "ranges.hh"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace openmsx;
+
+
+constexpr unsigned BATCH = 512; // samples per generateChannels() call
+constexpr unsigned BUILTIN_SECONDS = 60;
+
+struct RegWrite
+{
+	unsigned sample;
+	unsigned reg;
+	unsigned value;
+};
+using Log = std::vector<RegWrite>;
+
+// Collects register writes at the current position of a built-in log.
+struct LogWriter
+{
+	void operator()(unsigned reg, unsigned value) {
+		log.push_back({sample, reg, value});
+	}
+	Log& log;
+	unsigned sample;
+};
+
+// Frequency (in Hz) of a note, note 0 is C0, note 57 is A4 (440Hz).
+static double noteFreq(unsigned note)
+{
+	return 440.0 * std::pow(2.0, (int(note) - 57) / 12.0);
+}
+
+// Find the block (octave) and f-number for the OPL/OPLL family of chips.
+static std::pair<unsigned, unsigned> calcBlockFnum(
+	unsigned note, double sampleRate, unsigned fnumBits)
+{
+	double f = noteFreq(note);
+	for (unsigned block = 0; block < 8; ++block) {
+		auto fnum = unsigned(f * (1 << (fnumBits + 10 - block)) / sampleRate + 0.5);
+		if (fnum < (1u << fnumBits)) return {block, fnum};
+	}
+	return {7, (1u << fnumBits) - 1};
+}
+
+
+class Chip
+{
+public:
+	// The chips are created at this time. The core is rendered with all
+	// writes at this time, so the MSXMixer doesn't get involved.
+	static constexpr auto startTime = EmuTime::zero();
+
+	virtual ~Chip() = default;
+	virtual ResampledSoundDevice& getDevice() = 0;
+	virtual void write(unsigned reg, unsigned value, EmuTime::param time) = 0;
+
+	/** Create a log that plays random notes on all voices. */
+	Log createLog(unsigned samples);
+
+	/** Convert a VGM command to register write(s) for this chip. */
+	virtual void convertVGM(LogWriter& /*w*/, uint8_t /*cmd*/, const uint8_t* /*args*/) {}
+
+protected:
+	virtual unsigned getNumVoices() const = 0;
+	virtual void setup(LogWriter& w) = 0;
+	virtual void keyOn(LogWriter& w, unsigned voice, unsigned note) = 0;
+	virtual void keyOff(LogWriter& w, unsigned voice) = 0;
+};
+
+Log Chip::createLog(unsigned samples)
+{
+	Log log;
+	LogWriter w{log, 0};
+	setup(w);
+
+	unsigned numVoices = getNumVoices();
+	unsigned step = getDevice().getInputRate() / 8; // 8 notes per second
+	uint32_t random = 12345;
+	for (unsigned i = 0; (w.sample = (i + 1) * step) < samples; ++i) {
+		random = random * 1103515245 + 12345;
+		unsigned voice = i % numVoices;
+		keyOff(w, voice);
+		if (((random >> 16) % 8) != 0) { // sometimes leave a voice silent
+			keyOn(w, voice, 36 + (random >> 20) % 48);
+		}
+	}
+	return log;
+}
+
+
+static XMLElement createConfig(const char* name)
+{
+	XMLElement xml(name);
+	xml.addAttribute("id", name);
+	xml.addChild("sound").addChild("volume", "32767");
+	return xml;
+}
+
+// Keeps the XML data alive as long as the device.
+struct ChipConfig
+{
+	ChipConfig(HardwareConfig& hwConf, XMLElement xml_)
+		: xml(std::move(xml_)), config(hwConf, xml) {}
+	XMLElement xml;
+	DeviceConfig config;
+};
+
+
+class AY8910Chip final : public Chip, private ChipConfig
+{
+public:
+	explicit AY8910Chip(HardwareConfig& hwConf)
+		: ChipConfig(hwConf, createConfig("PSG"))
+		, ay8910("PSG", periphery, config, startTime) {}
+
+	ResampledSoundDevice& getDevice() override { return ay8910; }
+	void write(unsigned reg, unsigned value, EmuTime::param time) override {
+		ay8910.writeRegister(reg, value, time);
+	}
+	void convertVGM(LogWriter& w, uint8_t cmd, const uint8_t* args) override {
+		if ((cmd == 0xA0) && !(args[0] & 0x80)) w(args[0], args[1]);
+	}
+
+private:
+	unsigned getNumVoices() const override { return 3; }
+	void setup(LogWriter& w) override {
+		w(6, 0x0F); // noise period
+		w(7, 0xB0); // tone on A/B/C, noise on C
+		w(11, 0x00); w(12, 0x08); w(13, 0x0E); // envelope
+	}
+	void keyOn(LogWriter& w, unsigned voice, unsigned note) override {
+		auto period = unsigned(3579545 / 2 / (16 * noteFreq(note)));
+		w(2 * voice + 0, period & 0xFF);
+		w(2 * voice + 1, (period >> 8) & 0x0F);
+		w(8 + voice, (voice == 2) ? 0x10 : 0x0D); // C uses the envelope
+	}
+	void keyOff(LogWriter& w, unsigned voice) override {
+		w(8 + voice, 0x00);
+	}
+
+	struct Periphery final : AY8910Periphery {} periphery;
+	AY8910 ay8910;
+};
+
+
+class SCCChip final : public Chip, private ChipConfig
+{
+public:
+	explicit SCCChip(HardwareConfig& hwConf)
+		: ChipConfig(hwConf, createConfig("SCC"))
+		, scc("SCC", config, startTime) {}
+
+	ResampledSoundDevice& getDevice() override { return scc; }
+	void write(unsigned reg, unsigned value, EmuTime::param time) override {
+		scc.writeMem(reg, value, time);
+	}
+	void convertVGM(LogWriter& w, uint8_t cmd, const uint8_t* args) override {
+		if (cmd != 0xD2) return;
+		switch (args[0]) { // port, only the first chip
+		case 0: w(args[1] & 0x7F, args[2]); break; // waveform
+		case 1: w(0x80 + args[1], args[2]); break; // frequency
+		case 2: w(0x8A + args[1], args[2]); break; // volume
+		case 3: w(0x8F,           args[2]); break; // key on/off
+		case 4: // K052539 waveform, this SCC shares waveform 4 and 5
+			if (args[1] < 0x80) w(args[1], args[2]);
+			break;
+		case 5: w(0xE0,           args[2]); break; // deformation
+		}
+	}
+
+private:
+	unsigned getNumVoices() const override { return 5; }
+	void setup(LogWriter& w) override {
+		for (unsigned i = 0; i < 32; ++i) {
+			w(0x00 + i, (i < 16) ? 0x7F : 0x80);                      // square
+			w(0x20 + i, (i * 8 - 128) & 0xFF);                         // saw
+			w(0x40 + i, (((i < 16) ? i : 31 - i) * 16 - 128) & 0xFF);  // triangle
+			w(0x60 + i, int(std::sin(i * M_PI / 16) * 127) & 0xFF);    // sine
+		}
+		w(0x8F, 0x1F);
+	}
+	void keyOn(LogWriter& w, unsigned voice, unsigned note) override {
+		auto period = unsigned(3579545 / (32 * noteFreq(note))) - 1;
+		w(0x80 + 2 * voice, period & 0xFF);
+		w(0x81 + 2 * voice, (period >> 8) & 0x0F);
+		w(0x8A + voice, 0x0C);
+	}
+	void keyOff(LogWriter& w, unsigned voice) override {
+		w(0x8A + voice, 0x00);
+	}
+
+	SCC scc;
+};
+
+
+class YM2413Chip final : public Chip, private ChipConfig
+{
+public:
+	YM2413Chip(HardwareConfig& hwConf, bool alternative)
+		: ChipConfig(hwConf, createConfig(alternative))
+		, ym2413("MSX-MUSIC", config) {}
+
+	ResampledSoundDevice& getDevice() override { return ym2413; }
+	void write(unsigned reg, unsigned value, EmuTime::param time) override {
+		ym2413.writeReg(reg, value, time);
+	}
+	void convertVGM(LogWriter& w, uint8_t cmd, const uint8_t* args) override {
+		if (cmd == 0x51) w(args[0], args[1]);
+	}
+
+private:
+	static XMLElement createConfig(bool alternative) {
+		auto xml = ::createConfig("MSX-MUSIC");
+		xml.addChild("alternative", alternative ? "true" : "false");
+		return xml;
+	}
+
+	unsigned getNumVoices() const override { return 6; }
+	void setup(LogWriter& w) override {
+		// user instrument
+		static constexpr byte inst[8] = {
+			0x61, 0x61, 0x1E, 0x17, 0xF0, 0x7F, 0x00, 0x17 };
+		for (unsigned i = 0; i < 8; ++i) w(i, inst[i]);
+		// rhythm section
+		w(0x16, 0x20); w(0x17, 0x50); w(0x18, 0xC0);
+		w(0x26, 0x05); w(0x27, 0x05); w(0x28, 0x01);
+		w(0x36, 0x00); w(0x37, 0x00); w(0x38, 0x00);
+		w(0x0E, 0x20);
+	}
+	void keyOn(LogWriter& w, unsigned voice, unsigned note) override {
+		auto [block, fnum] = calcBlockFnum(note, 3579545 / 72.0, 9);
+		w(0x30 + voice, ((voice * 3) % 16) << 4); // instrument, max volume
+		w(0x10 + voice, fnum & 0xFF);
+		w(0x20 + voice, 0x10 | (block << 1) | (fnum >> 8));
+		w(0x0E, 0x20 | (1 << (voice % 5))); // also trigger a drum
+	}
+	void keyOff(LogWriter& w, unsigned voice) override {
+		w(0x20 + voice, 0x00);
+		w(0x0E, 0x20);
+	}
+
+	YM2413 ym2413;
+};
+
+
+// Common code for the OPL family (Y8950 and YMF262).
+static constexpr byte oplSlotOffset[9] = { 0, 1, 2, 8, 9, 10, 16, 17, 18 };
+
+static void oplSetupVoice(LogWriter& w, unsigned base, unsigned voice, bool opl3)
+{
+	unsigned mod = base + oplSlotOffset[voice];
+	unsigned car = mod + 3;
+	w(0x20 + mod, 0x21); w(0x20 + car, 0x01 + (voice % 3)); // MUL, EG-type
+	w(0x40 + mod, 0x18); w(0x40 + car, 0x00);               // KSL, TL
+	w(0x60 + mod, 0xF4); w(0x60 + car, 0xF3);               // AR, DR
+	w(0x80 + mod, 0x26); w(0x80 + car, 0x27);               // SL, RR
+	if (opl3) {
+		w(0xE0 + mod, voice % 8); w(0xE0 + car, 0); // waveform
+		w(base + 0xC0 + voice, 0x30 | ((voice % 4) << 1)); // L+R, FB
+	} else {
+		w(base + 0xC0 + voice, (voice % 4) << 1); // FB
+	}
+}
+
+class YMF262Chip final : public Chip, private ChipConfig
+{
+public:
+	explicit YMF262Chip(HardwareConfig& hwConf)
+		: ChipConfig(hwConf, createConfig("YMF262"))
+		, ymf262("YMF262", config, false) {}
+
+	ResampledSoundDevice& getDevice() override { return ymf262; }
+	void write(unsigned reg, unsigned value, EmuTime::param time) override {
+		ymf262.writeReg(reg, value, time);
+	}
+	void convertVGM(LogWriter& w, uint8_t cmd, const uint8_t* args) override {
+		if ((cmd == 0x5E) || (cmd == 0x5F)) {
+			w(((cmd & 1) << 8) | args[0], args[1]);
+		} else if ((cmd == 0xD0) && (args[0] < 2)) { // YMF278B FM part
+			w((args[0] << 8) | args[1], args[2]);
+		}
+	}
+
+private:
+	unsigned getNumVoices() const override { return 18; }
+	void setup(LogWriter& w) override {
+		w(0x105, 0x01); // OPL3 mode
+		w(0x0BD, 0xC0); // deep AM/vibrato
+		for (unsigned voice = 0; voice < 18; ++voice) {
+			oplSetupVoice(w, (voice / 9) * 0x100, voice % 9, true);
+		}
+	}
+	void keyOn(LogWriter& w, unsigned voice, unsigned note) override {
+		auto [block, fnum] = calcBlockFnum(note, 14318180 / 288.0, 10);
+		unsigned reg = (voice / 9) * 0x100 + voice % 9;
+		w(0xA0 + reg, fnum & 0xFF);
+		w(0xB0 + reg, 0x20 | (block << 2) | (fnum >> 8));
+	}
+	void keyOff(LogWriter& w, unsigned voice) override {
+		w(0xB0 + (voice / 9) * 0x100 + voice % 9, 0x00);
+	}
+
+	YMF262 ymf262;
+};
+
+
+class Y8950Chip final : public Chip, private ChipConfig
+{
+public:
+	explicit Y8950Chip(HardwareConfig& hwConf)
+		: ChipConfig(hwConf, createConfig("MSX-AUDIO"))
+		, msxAudio(config)
+		, device(dynamic_cast<ResampledSoundDevice&>(
+			*hwConf.getMotherBoard().getMSXMixer().findDevice(msxAudio.getName()))) {}
+
+	ResampledSoundDevice& getDevice() override { return device; }
+	void write(unsigned reg, unsigned value, EmuTime::param time) override {
+		msxAudio.writeIO(0, reg, time);
+		msxAudio.writeIO(1, value, time);
+	}
+	void convertVGM(LogWriter& w, uint8_t cmd, const uint8_t* args) override {
+		if (cmd == 0x5C) w(args[0], args[1]);
+	}
+
+private:
+	unsigned getNumVoices() const override { return 9; }
+	void setup(LogWriter& w) override {
+		w(0xBD, 0xC0); // deep AM/vibrato
+		for (unsigned voice = 0; voice < 9; ++voice) {
+			oplSetupVoice(w, 0, voice, false);
+		}
+	}
+	void keyOn(LogWriter& w, unsigned voice, unsigned note) override {
+		auto [block, fnum] = calcBlockFnum(note, 3579545 / 72.0, 10);
+		w(0xA0 + voice, fnum & 0xFF);
+		w(0xB0 + voice, 0x20 | (block << 2) | (fnum >> 8));
+	}
+	void keyOff(LogWriter& w, unsigned voice) override {
+		w(0xB0 + voice, 0x00);
+	}
+
+	MSXAudio msxAudio;
+	ResampledSoundDevice& device;
+};
+
+
+class YMF278Chip final : public Chip, private ChipConfig
+{
+public:
+	explicit YMF278Chip(HardwareConfig& hwConf)
+		: ChipConfig(hwConf, createConfig())
+		, ymf278("YMF278", 2048, config) {}
+
+	ResampledSoundDevice& getDevice() override { return ymf278; }
+	void write(unsigned reg, unsigned value, EmuTime::param time) override {
+		ymf278.writeReg(reg, value, time);
+	}
+	void convertVGM(LogWriter& w, uint8_t cmd, const uint8_t* args) override {
+		if ((cmd == 0xD0) && (args[0] == 2)) w(args[1], args[2]);
+	}
+
+private:
+	static XMLElement createConfig() {
+		auto xml = ::createConfig("YMF278");
+		xml.addChild("rom").addChild("size", "2048"); // empty 2MB ROM
+		return xml;
+	}
+
+	// Wave headers at the start of RAM (0x200000), sample data behind it.
+	static constexpr unsigned RAM_BASE    = 0x200000;
+	static constexpr unsigned SAMPLE_ADDR = RAM_BASE + 0x1000;
+	static constexpr unsigned SAMPLE_LEN  = 0x2000; // in samples
+	static constexpr unsigned LOOP_LEN    = 0x0800; // in samples
+
+	unsigned getNumVoices() const override { return 24; }
+	void setup(LogWriter& w) override {
+		w(0x02, 0x11); // headers at 0x200000, memory access
+		auto setAddr = [&](unsigned addr) {
+			w(0x03, (addr >> 16) & 0x3F);
+			w(0x04, (addr >>  8) & 0xFF);
+			w(0x05, (addr >>  0) & 0xFF);
+		};
+		// one waveform per sample format (8, 12 and 16 bit)
+		setAddr(SAMPLE_ADDR);
+		uint32_t x = 12345;
+		for (unsigned i = 0; i < 2 * SAMPLE_LEN; ++i) {
+			x = x * 1103515245 + 12345;
+			w(0x06, (x >> 16) & 0xFF);
+		}
+		setAddr(RAM_BASE);
+		for (unsigned slot = 0; slot < 24; ++slot) {
+			unsigned bits = slot % 3;
+			unsigned loop = SAMPLE_LEN - LOOP_LEN;
+			unsigned end = (SAMPLE_LEN ^ 0xFFFF) + 1; // 2s complement
+			byte hdr[12] = {
+				byte((bits << 6) | ((SAMPLE_ADDR >> 16) & 0x3F)),
+				byte(SAMPLE_ADDR >> 8), byte(SAMPLE_ADDR),
+				byte(loop >> 8), byte(loop),
+				byte(end >> 8), byte(end),
+				byte((slot % 8) << 3 | (slot % 4)), // LFO, VIB
+				0xF2, 0x21, 0x07,                   // AR/D1R, DL/D2R, RC/RR
+				byte(slot % 8),                     // AM
+			};
+			for (auto& h : hdr) w(0x06, h);
+		}
+		for (unsigned slot = 0; slot < 24; ++slot) {
+			w(0x50 + slot, 0x01);        // TL, no interpolation
+			w(0x20 + slot, 0x01);        // wave bit 8
+			w(0x08 + slot, 0x80 + slot); // wave 384+slot (loads header)
+		}
+	}
+	void keyOn(LogWriter& w, unsigned voice, unsigned note) override {
+		// sample rate is 44.1kHz when OCT=0 and FN=0, call that C4
+		int oct = int(note / 12) - 4;
+		auto fnum = unsigned(1024 * (std::pow(2.0, (note % 12) / 12.0) - 1.0));
+		w(0x38 + voice, ((oct & 0x0F) << 4) | (fnum >> 7));
+		w(0x20 + voice, ((fnum & 0x7F) << 1) | 1);
+		w(0x68 + voice, 0x80 | (voice % 16)); // key-on, pan
+	}
+	void keyOff(LogWriter& w, unsigned voice) override {
+		w(0x68 + voice, voice % 16);
+	}
+
+	YMF278 ymf278;
+};
+
+
+class YM2151Chip final : public Chip, private ChipConfig
+{
+public:
+	explicit YM2151Chip(HardwareConfig& hwConf)
+		: ChipConfig(hwConf, createConfig("YM2151"))
+		, ym2151("YM2151", "YM2151", config, startTime) {}
+
+	ResampledSoundDevice& getDevice() override { return ym2151; }
+	void write(unsigned reg, unsigned value, EmuTime::param time) override {
+		ym2151.writeReg(reg, value, time);
+	}
+	void convertVGM(LogWriter& w, uint8_t cmd, const uint8_t* args) override {
+		if (cmd == 0x54) w(args[0], args[1]);
+	}
+
+private:
+	unsigned getNumVoices() const override { return 8; }
+	void setup(LogWriter& w) override {
+		w(0x18, 0xC0); w(0x19, 0x40); w(0x19, 0xA0); w(0x1B, 0x02); // LFO
+		w(0x0F, 0x00); // noise off
+		for (unsigned ch = 0; ch < 8; ++ch) {
+			w(0x20 + ch, 0xC0 | ((ch % 4) << 3) | (ch % 8)); // RL, FB, CON
+			w(0x38 + ch, 0x31);                              // PMS, AMS
+			for (unsigned op = 0; op < 4; ++op) {
+				unsigned r = op * 8 + ch;
+				w(0x40 + r, op + 1);                       // DT1, MUL
+				w(0x60 + r, (op == 3) ? 0x00 : 0x20);      // TL
+				w(0x80 + r, 0x1F);                         // KS, AR
+				w(0xA0 + r, 0x85);                         // AMS-EN, D1R
+				w(0xC0 + r, 0x02);                         // DT2, D2R
+				w(0xE0 + r, 0x27);                         // D1L, RR
+			}
+		}
+	}
+	void keyOn(LogWriter& w, unsigned voice, unsigned note) override {
+		// YM2151 octaves start at C#
+		static constexpr byte noteCode[12] = {
+			0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14 };
+		unsigned n = note - 1;
+		unsigned oct = std::min(n / 12, 7u);
+		w(0x28 + voice, (oct << 4) | noteCode[n % 12]);
+		w(0x30 + voice, 0x00);
+		w(0x08, 0x78 | voice);
+	}
+	void keyOff(LogWriter& w, unsigned voice) override {
+		w(0x08, voice);
+	}
+
+	YM2151 ym2151;
+};
+
+
+class SN76489Chip final : public Chip, private ChipConfig
+{
+public:
+	explicit SN76489Chip(HardwareConfig& hwConf)
+		: ChipConfig(hwConf, createConfig("SN76489"))
+		, sn76489(config) {}
+
+	ResampledSoundDevice& getDevice() override { return sn76489; }
+	void write(unsigned /*reg*/, unsigned value, EmuTime::param time) override {
+		sn76489.write(value, time);
+	}
+	void convertVGM(LogWriter& w, uint8_t cmd, const uint8_t* args) override {
+		if (cmd == 0x50) w(0, args[0]);
+	}
+
+private:
+	unsigned getNumVoices() const override { return 4; }
+	void setup(LogWriter& /*w*/) override {}
+	void keyOn(LogWriter& w, unsigned voice, unsigned note) override {
+		if (voice == 3) {
+			w(0, 0xE0 | (note % 8)); // noise control
+		} else {
+			auto period = unsigned(3579545 / (32 * noteFreq(note)));
+			w(0, 0x80 | (voice << 5) | (period & 0x0F));
+			w(0, (period >> 4) & 0x3F);
+		}
+		w(0, 0x90 | (voice << 5) | 0x02); // attenuation
+	}
+	void keyOff(LogWriter& w, unsigned voice) override {
+		w(0, 0x90 | (voice << 5) | 0x0F);
+	}
+
+	SN76489 sn76489;
+};
+
+
+class VLM5030Chip final : public Chip, private ChipConfig
+{
+public:
+	explicit VLM5030Chip(HardwareConfig& hwConf)
+		: ChipConfig(hwConf, createConfig("VLM5030"))
+		, vlm5030("VLM5030", "VLM5030", "", config) {}
+
+	ResampledSoundDevice& getDevice() override { return vlm5030; }
+	void write(unsigned reg, unsigned value, EmuTime::param time) override {
+		if (reg == 0) {
+			vlm5030.writeData(value);
+		} else {
+			vlm5030.writeControl(value, time);
+		}
+	}
+
+private:
+	unsigned getNumVoices() const override { return 1; }
+	void setup(LogWriter& /*w*/) override {}
+	void keyOn(LogWriter& w, unsigned /*voice*/, unsigned note) override {
+		// speak one of the phrases in the voice ROM
+		w(0, (note % 64) * 2);
+		w(1, 0x02); // ST high
+		w(1, 0x00); // ST low
+	}
+	void keyOff(LogWriter& /*w*/, unsigned /*voice*/) override {}
+
+	VLM5030 vlm5030;
+};
+
+
+struct ChipInfo
+{
+	const char* name;
+	std::unique_ptr<Chip> (*create)(HardwareConfig& hwConf);
+};
+
+template<typename T> static std::unique_ptr<Chip> create(HardwareConfig& hwConf)
+{
+	return std::make_unique<T>(hwConf);
+}
+
+static const ChipInfo chips[] = {
+	{ "AY8910",           create<AY8910Chip> },
+	{ "SCC",              create<SCCChip> },
+	{ "YM2413Okazaki",    [](HardwareConfig& h) -> std::unique_ptr<Chip> {
+	                          return std::make_unique<YM2413Chip>(h, false); } },
+	{ "YM2413Burczynski", [](HardwareConfig& h) -> std::unique_ptr<Chip> {
+	                          return std::make_unique<YM2413Chip>(h, true); } },
+	{ "YMF262",           create<YMF262Chip> },
+	{ "YMF278",           create<YMF278Chip> },
+	{ "Y8950",            create<Y8950Chip> },
+	{ "YM2151",           create<YM2151Chip> },
+	{ "SN76489",          create<SN76489Chip> },
+	{ "VLM5030",          create<VLM5030Chip> },
+};
+
+
+// Length of a VGM command (including the command byte), 0 if unknown.
+static size_t vgmCommandLength(span<const uint8_t> data, size_t pos)
+{
+	uint8_t cmd = data[pos];
+	if (cmd == 0x67) { // data block
+		if (pos + 7 > data.size()) return 0;
+		return 7 + (Endian::read_UA_L32(&data[pos + 3]) & 0x7FFFFFFF);
+	}
+	if ((0x30 <= cmd) && (cmd <= 0x3F)) return 2;
+	if ((0x40 <= cmd) && (cmd <= 0x4E)) return 3;
+	if ((0x4F <= cmd) && (cmd <= 0x50)) return 2;
+	if ((0x51 <= cmd) && (cmd <= 0x5F)) return 3;
+	if ((0x70 <= cmd) && (cmd <= 0x8F)) return 1;
+	if ((0xA0 <= cmd) && (cmd <= 0xBF)) return 3;
+	if ((0xC0 <= cmd) && (cmd <= 0xDF)) return 4;
+	if (0xE0 <= cmd) return 5;
+	switch (cmd) {
+		case 0x61: return 3;
+		case 0x62: case 0x63: return 1;
+		case 0x68: return 12;
+		case 0x90: case 0x91: case 0x95: return 5;
+		case 0x92: return 6;
+		case 0x93: return 11;
+		case 0x94: return 2;
+		default: return 0;
+	}
+}
+
+static Log parseVGM(span<const uint8_t> data, Chip& chip, const std::string& filename)
+{
+	auto read32 = [&](size_t pos) {
+		return (pos + 4 <= data.size()) ? Endian::read_UA_L32(&data[pos]) : 0;
+	};
+	size_t pos = ((read32(0x08) >= 0x150) && read32(0x34))
+	           ? 0x34 + read32(0x34) : 0x40;
+
+	unsigned rate = chip.getDevice().getInputRate();
+	uint64_t vgmSample = 0; // VGM time is in 44100Hz samples
+	Log log;
+	LogWriter w{log, 0};
+	while ((pos < data.size()) && (data[pos] != 0x66)) { // 0x66: end of data
+		uint8_t cmd = data[pos];
+		size_t len = vgmCommandLength(data, pos);
+		if ((len == 0) || (pos + len > data.size())) {
+			throw MSXException(filename, ": invalid VGM command at offset ", pos);
+		}
+		const uint8_t* args = &data[pos + 1];
+		if (cmd == 0x61) {
+			vgmSample += args[0] | (args[1] << 8);
+		} else if (cmd == 0x62) {
+			vgmSample += 735;
+		} else if (cmd == 0x63) {
+			vgmSample += 882;
+		} else if ((cmd & 0xF0) == 0x70) {
+			vgmSample += (cmd & 0x0F) + 1;
+		} else if ((cmd & 0xF0) == 0x80) {
+			vgmSample += cmd & 0x0F;
+		} else {
+			w.sample = unsigned(vgmSample * rate / 44100);
+			chip.convertVGM(w, cmd, args);
+		}
+		pos += len;
+	}
+	return log;
+}
+
+static Log loadLog(const std::string& filename, Chip& chip)
+{
+	File file(filename); // transparently decompresses .vgz files
+	auto data = file.mmap();
+	if ((data.size() >= 0x40) && (memcmp(data.data(), "Vgm ", 4) == 0)) {
+		return parseVGM(data, chip, filename);
+	}
+
+	std::istringstream text(std::string(data.begin(), data.end()));
+	Log log;
+	std::string line;
+	unsigned lineNum = 0;
+	while (std::getline(text, line)) {
+		++lineNum;
+		std::istringstream is(line);
+		std::string sample, reg, value;
+		if (!(is >> sample) || (sample[0] == '#')) continue;
+		if (!(is >> reg >> value)) {
+			throw MSXException(filename, ':', lineNum, ": syntax error");
+		}
+		RegWrite w;
+		w.sample = strtoul(sample.c_str(), nullptr, 10);
+		w.reg    = strtoul(reg   .c_str(), nullptr, 0);
+		w.value  = strtoul(value .c_str(), nullptr, 0);
+		if (!log.empty() && (w.sample < log.back().sample)) {
+			throw MSXException(filename, ':', lineNum, ": log not sorted");
+		}
+		log.push_back(w);
+	}
+	return log;
+}
+
+struct Result
+{
+	uint64_t samples;
+	uint64_t duration; // in us
+	std::string sha1;
+};
+
+// Render the chip alone, at its native sample rate. This is the benchmark.
+static Result play(Chip& chip, const Log& log, unsigned samples)
+{
+	auto& device = chip.getDevice();
+	unsigned channels = device.isStereo() ? 2 : 1;
+	MemBuffer<float, SSE2_ALIGNMENT> buf(channels * BATCH + 3);
+	SHA1 sha1;
+
+	auto generate = [&](unsigned num) {
+		while (num) {
+			unsigned n = std::min(num, BATCH);
+			if (!device.generateInput(buf.data(), n)) {
+				memset(buf.data(), 0, channels * n * sizeof(float));
+			}
+			sha1.update(reinterpret_cast<const uint8_t*>(buf.data()),
+			            channels * n * sizeof(float));
+			num -= n;
+		}
+	};
+
+	unsigned pos = 0;
+	uint64_t start = Timer::getTime();
+	for (auto& w : log) {
+		generate(w.sample - pos);
+		pos = w.sample;
+		chip.write(w.reg, w.value, Chip::startTime);
+	}
+	generate(samples - pos);
+	uint64_t duration = Timer::getTime() - start;
+
+	return {samples, std::max<uint64_t>(duration, 1), sha1.digest().toString()};
+}
+
+// Render the chip through the MSXMixer, like it's heard in the emulator
+// (volume, balance, resampling to the host sample rate, DC filter). The
+// scheduler isn't running, instead the mixer follows the emulated time of
+// the register writes. The chip's native samples are the ticks of that
+// clock.
+static std::string render(Chip& chip, const Log& log, unsigned samples,
+                          MSXMixer& mixer, Wav16Writer* wav)
+{
+	SHA1 sha1;
+	mixer.setOutputSink([&](unsigned num, const float* data) {
+		// always stereo
+		sha1.update(reinterpret_cast<const uint8_t*>(data),
+		            2 * num * sizeof(float));
+		if (wav) wav->write(data, 2, num, 1.0f, 1.0f);
+	});
+
+	DynamicClock clock(Chip::startTime, chip.getDevice().getInputRate());
+	auto generate = [&](EmuTime::param time) {
+		// MSXMixer::updateStream() handles at most 8192 samples
+		auto& hostClock = mixer.getHostSampleClock();
+		while (hostClock.getTicksTill(time) > BATCH) {
+			mixer.updateStream(hostClock + BATCH);
+		}
+		mixer.updateStream(time);
+	};
+
+	for (auto& w : log) {
+		EmuTime time = clock + w.sample;
+		generate(time);
+		chip.write(w.reg, w.value, time);
+	}
+	generate(clock + samples);
+
+	mixer.setOutputSink({});
+	return sha1.digest().toString();
+}
+
+
+// "chip log" -> sha1 of the output of the chip and of the mixer
+struct Sums
+{
+	std::string chip;
+	std::string mixer;
+};
+using Golden = std::map<std::string, Sums>;
+
+static Golden loadGolden(const std::string& filename, bool update)
+{
+	Golden result;
+	std::ifstream file(filename);
+	if (!file) {
+		// only acceptable when (re)creating the golden data
+		if (update) return result;
+		throw MSXException("Couldn't read golden data file: ", filename,
+		                   " (use -update to create it)");
+	}
+	std::string line;
+	while (std::getline(file, line)) {
+		std::istringstream is(line);
+		std::string chip, log;
+		Sums sums;
+		if ((is >> chip >> log >> sums.chip) && (chip[0] != '#')) {
+			is >> sums.mixer;
+			result[chip + ' ' + log] = sums;
+		}
+	}
+	return result;
+}
+
+static void saveGolden(const std::string& filename, const Golden& golden)
+{
+	std::ofstream file(filename);
+	if (!file) {
+		throw MSXException("Couldn't write golden data file: ", filename);
+	}
+	file << "# Golden output of SoundChipTest: <chip> <log> <sha1 chip> <sha1 mixer>\n";
+	for (auto& [key, sums] : golden) {
+		file << key << ' ' << sums.chip << ' ' << sums.mixer << '\n';
+	}
+}
+
+
+static int usage()
+{
+	std::cerr << "Usage: soundchipbench [-golden <file>] [-update] [-wav <prefix>] [-list] "
+	             "[<chip>[=<log>]...]\n";
+	return 1;
+}
+
+int main(int argc, char** argv)
+{
+	std::string goldenFile = "SoundChipTest.golden";
+	std::string wavPrefix;
+	bool update = false;
+	std::vector<std::pair<std::string, std::string>> runs; // chip, log
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		if (arg == "-golden") {
+			if (++i == argc) return usage();
+			goldenFile = argv[i];
+		} else if (arg == "-update") {
+			update = true;
+		} else if (arg == "-wav") {
+			if (++i == argc) return usage();
+			wavPrefix = argv[i];
+		} else if (arg == "-list") {
+			for (auto& c : chips) std::cout << c.name << '\n';
+			return 0;
+		} else if (arg[0] == '-') {
+			return usage();
+		} else {
+			auto eq = arg.find('=');
+			if (eq == std::string::npos) {
+				runs.emplace_back(arg, "");
+			} else {
+				runs.emplace_back(arg.substr(0, eq), arg.substr(eq + 1));
+			}
+		}
+	}
+	if (runs.empty()) {
+		for (auto& c : chips) runs.emplace_back(c.name, "");
+	}
+
+	int status = 0;
+	try {
+		Thread::setMainThread();
+		Reactor reactor;
+		reactor.init();
+		// The null driver has a fixed sample rate (44100Hz), other
+		// settings are at their default values.
+		reactor.getInterpreter().execute("set sound_driver null");
+		MSXMotherBoard motherBoard(reactor);
+		HardwareConfig hwConf(motherBoard, "SoundChipTest");
+		auto& mixer = motherBoard.getMSXMixer();
+
+		auto golden = loadGolden(goldenFile, update);
+		for (auto& [chipName, logName] : runs) {
+			auto it = ranges::find_if(chips, [&](auto& c) { return chipName == c.name; });
+			if (it == std::end(chips)) {
+				std::cerr << "Unknown chip: " << chipName << '\n';
+				return 1;
+			}
+			std::cout << std::left << std::setw(17) << chipName << ' '
+			          << std::setw(12) << (logName.empty() ? "builtin" : logName) << ' '
+			          << std::flush;
+
+			std::unique_ptr<Chip> chip;
+			try {
+				chip = it->create(hwConf);
+			} catch (MSXException& e) {
+				// e.g. the VLM5030 voice ROM is not available
+				std::cout << "skipped: " << e.getMessage() << '\n';
+				continue;
+			}
+			unsigned rate = chip->getDevice().getInputRate();
+			Log log;
+			unsigned samples;
+			if (logName.empty()) {
+				samples = BUILTIN_SECONDS * rate;
+				log = chip->createLog(samples);
+			} else {
+				log = loadLog(logName, *chip);
+				samples = (log.empty() ? 0 : log.back().sample) + rate;
+			}
+			auto result = play(*chip, log, samples);
+
+			double samplesPerSecond = result.samples * 1000000.0 / result.duration;
+			std::cout << std::right << std::setw(10) << uint64_t(samplesPerSecond)
+			          << " samples/s " << std::fixed << std::setprecision(1)
+			          << std::setw(7) << (samplesPerSecond / rate) << "x realtime  ";
+
+			// Render again, with a new instance, through the mixer.
+			// (First destroy the old one, the mixer doesn't allow two
+			// devices with the same name.)
+			chip.reset();
+			chip = it->create(hwConf);
+			std::unique_ptr<Wav16Writer> wav;
+			if (!wavPrefix.empty()) {
+				wav = std::make_unique<Wav16Writer>(
+					Filename(wavPrefix + chipName + ".wav"),
+					2, mixer.getSampleRate());
+			}
+			Sums sums{result.sha1, render(*chip, log, samples, mixer, wav.get())};
+
+			std::string key = chipName + ' ' + (logName.empty() ? "builtin" : logName);
+			auto g = golden.find(key);
+			if (update) {
+				golden[key] = sums;
+				std::cout << "updated\n";
+			} else if ((g == golden.end()) || g->second.mixer.empty()) {
+				// a run without reference data doesn't verify anything
+				std::cout << "MISSING (" << sums.chip << ' ' << sums.mixer
+				          << "), use -update\n";
+				status = 1;
+			} else if ((g->second.chip == sums.chip) && (g->second.mixer == sums.mixer)) {
+				std::cout << "ok\n";
+			} else {
+				std::cout << "MISMATCH";
+				if (g->second.chip  != sums.chip ) std::cout << " chip ("  << sums.chip  << ')';
+				if (g->second.mixer != sums.mixer) std::cout << " mixer (" << sums.mixer << ')';
+				std::cout << '\n';
+				status = 1;
+			}
+		}
+		if (update) saveGolden(goldenFile, golden);
+	} catch (MSXException& e) {
+		std::cerr << "Error: " << e.getMessage() << '\n';
+		return 1;
+	}
+	return status;
+}
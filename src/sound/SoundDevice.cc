@@ -185,6 +185,14 @@ void SoundDevice::muteChannel(unsigned channel, bool muted)
 	channelMuted[channel] = muted;
 }
 
+bool SoundDevice::isOutputMuted() const
+{
+	if (numRecordChannels != 0) return false;
+	return mixer.isOutputUnused() ||
+	       ranges::all_of(xrange(numChannels),
+	                      [&](auto i) { return channelMuted[i]; });
+}
+
 bool SoundDevice::mixChannels(float* dataOut, unsigned samples)
 {
 #ifdef __SSE2__
@@ -336,6 +344,13 @@ bool SoundDevice::mixChannels(float* dataOut, unsigned samples)
 	return true;
 }
 
+bool SoundDevice::isPlainMonoMix() const
+{
+	return (stereo == 1) && balanceCenter && (numRecordChannels == 0) &&
+	       ranges::none_of(xrange(numChannels),
+	                       [&](auto i) { return channelMuted[i]; });
+}
+
 const DynamicClock& SoundDevice::getHostSampleClock() const
 {
 	return mixer.getHostSampleClock();
@@ -2,7 +2,9 @@
 #define SOUNDDEVICE_HH
 
 #include "MSXMixer.hh"
+#include "VGMWriter.hh"
 #include "EmuTime.hh"
+#include "likely.hh"
 #include <memory>
 #include <string_view>
 
@@ -33,6 +35,11 @@ public:
 	  */
 	bool isStereo() const;
 
+	/** Gets the sample rate at which this device natively generates
+	  * its output (the rate of the samples passed to generateChannels()).
+	  */
+	unsigned getInputRate() const { return inputSampleRate; }
+
 	/** Gets this device its 'amplification factor'.
 	  *
 	  * Each sample generated by the 'updateBuffer' method will get
@@ -66,6 +73,11 @@ public:
 	void recordChannel(unsigned channel, const Filename& filename);
 	void muteChannel  (unsigned channel, bool muted);
 
+	/** Start (non-null) or stop (nullptr) logging the register writes of
+	  * this device. Called by MSXMixer.
+	  */
+	void setRegisterLog(VGMWriter* log) { registerLog = log; }
+
 protected:
 	/** Constructor.
 	  * @param mixer The Mixer object
@@ -106,7 +118,13 @@ protected:
 	void updateStream(EmuTime::param time);
 
 	void setInputRate(unsigned sampleRate) { inputSampleRate = sampleRate; }
-	unsigned getInputRate() const { return inputSampleRate; }
+
+	/** Returns true when nobody listens to the output of this device: the
+	  * mixer output is unused or all channels are muted, and no channel is
+	  * being recorded. Devices whose generateChannels() is expensive can
+	  * then skip generating the actual samples.
+	  */
+	bool isOutputMuted() const;
 
 public: // Will be called by Mixer:
 	/**
@@ -177,6 +195,24 @@ protected:
 	  */
 	bool mixChannels(float* dataOut, unsigned samples);
 
+	unsigned getNumChannels() const { return numChannels; }
+
+	/** Are all channels simply summed into a mono output? IOW none of
+	  * the channels is muted, recorded or has a non-center balance. In
+	  * that case mixChannels() doesn't need the individual channels.
+	  */
+	bool isPlainMonoMix() const;
+
+	/** Log a register write, if register logging is active.
+	  * See VGMWriter::write() for the meaning of the parameters.
+	  */
+	void logRegister(VGMWriter::Chip chip, unsigned port, unsigned reg,
+	                 unsigned value, EmuTime::param time) {
+		if (unlikely(registerLog != nullptr)) {
+			registerLog->write(*this, chip, port, reg, value, time);
+		}
+	}
+
 	/** See MSXMixer::getHostSampleClock(). */
 	const DynamicClock& getHostSampleClock() const;
 	double getEffectiveSpeed() const;
@@ -187,6 +223,7 @@ private:
 	const std::string description;
 
 	std::unique_ptr<Wav16Writer> writer[MAX_CHANNELS];
+	VGMWriter* registerLog = nullptr;
 
 	float softwareVolumeLeft = 1.0f;
 	float softwareVolumeRight = 1.0f;
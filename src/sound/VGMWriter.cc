@@ -0,0 +1,200 @@
+#include "VGMWriter.hh"
+#include "CliComm.hh"
+#include "MSXException.hh"
+#include "endian.hh"
+#include <algorithm>
+#include <cstring>
+
+namespace openmsx {
+
+constexpr unsigned HEADER_SIZE = 0x100;
+constexpr size_t BUFFER_SIZE = 0x10000;
+
+// Nominal clock frequencies of the chips as used in MSX machines.
+constexpr uint32_t clocks[VGMWriter::NUM_CHIPS] = {
+	3579545,  // SN76489
+	3579545,  // YM2413
+	3579545,  // YM2151
+	3579545,  // Y8950
+	14318180, // YMF262
+	33868800, // YMF278B (FM)
+	33868800, // YMF278B (wave)
+	1789773,  // AY8910
+	1789773,  // K051649
+};
+
+// Offset of the clock field in the VGM header.
+constexpr unsigned clockOffsets[VGMWriter::NUM_CHIPS] = {
+	0x0C, 0x10, 0x30, 0x58, 0x5C, 0x60, 0x60, 0x74, 0x9C,
+};
+
+VGMWriter::VGMWriter(const Filename& filename, EmuTime::param time,
+                     CliComm& cliComm_)
+	: file(filename, "wb")
+	, cliComm(cliComm_)
+	, clock(time)
+	, samples(0)
+	, bytes(0)
+	, sccPlus(false)
+	, failed(false)
+{
+	for (auto& d : devices) d = {nullptr, nullptr};
+	buffer.reserve(BUFFER_SIZE);
+	writeHeader();
+}
+
+VGMWriter::~VGMWriter()
+{
+	try {
+		flush(clock.getTime());
+	} catch (MSXException&) {
+		// ignore, can't throw from destructor
+	}
+}
+
+void VGMWriter::write(const SoundDevice& device, Chip chip, unsigned port,
+                      unsigned reg, unsigned value, EmuTime::param time)
+{
+	if (failed) return;
+	auto& devs = devices[chip];
+	unsigned instance;
+	if (!devs[0] || (devs[0] == &device)) {
+		devs[0] = &device;
+		instance = 0;
+	} else if (!devs[1] || (devs[1] == &device)) {
+		devs[1] = &device;
+		instance = 1;
+	} else {
+		return; // VGM supports at most two instances per chip type
+	}
+
+	writeWait(time);
+	auto r = uint8_t(reg);
+	auto v = uint8_t(value);
+	switch (chip) {
+	case SN76489:
+		writeData({uint8_t(instance ? 0x30 : 0x50), v});
+		break;
+	case YM2413:
+		writeData({uint8_t(instance ? 0xA1 : 0x51), r, v});
+		break;
+	case YM2151:
+		writeData({uint8_t(instance ? 0xA4 : 0x54), r, v});
+		break;
+	case Y8950:
+		writeData({uint8_t(instance ? 0xAC : 0x5C), r, v});
+		break;
+	case YMF262:
+		writeData({uint8_t((instance ? 0xAE : 0x5E) + (port & 1)), r, v});
+		break;
+	case YMF278B_FM:
+	case YMF278B_WAVE:
+		writeData({0xD0, uint8_t(port | (instance << 7)), r, v});
+		break;
+	case AY8910:
+		writeData({0xA0, uint8_t(r | (instance << 7)), v});
+		break;
+	case K051649:
+		if (port == 4) sccPlus = true;
+		writeData({0xD2, uint8_t(port | (instance << 7)), r, v});
+		break;
+	default:
+		break;
+	}
+}
+
+void VGMWriter::writeWait(EmuTime::param time)
+{
+	unsigned n = clock.getTicksTill(time);
+	clock += n;
+	samples += n;
+	while (n) {
+		if (n <= 16) {
+			writeData({uint8_t(0x70 + n - 1)});
+			n = 0;
+		} else if (n == 735) { // 1/60s
+			writeData({0x62});
+			n = 0;
+		} else if (n == 882) { // 1/50s
+			writeData({0x63});
+			n = 0;
+		} else {
+			unsigned m = std::min(n, 0xFFFFu);
+			writeData({0x61, uint8_t(m & 0xFF), uint8_t(m >> 8)});
+			n -= m;
+		}
+	}
+}
+
+void VGMWriter::writeData(std::initializer_list<uint8_t> data)
+{
+	buffer.insert(buffer.end(), data.begin(), data.end());
+	if (buffer.size() >= BUFFER_SIZE) {
+		writeBuffer();
+	}
+}
+
+void VGMWriter::writeBuffer()
+{
+	try {
+		file.seek(HEADER_SIZE + bytes);
+		file.write(buffer.data(), buffer.size());
+	} catch (MSXException& e) {
+		stopLogging(e);
+		return;
+	}
+	bytes += buffer.size();
+	buffer.clear();
+}
+
+void VGMWriter::flush(EmuTime::param time)
+{
+	if (failed) return;
+	writeWait(time);
+	writeBuffer();
+	if (failed) return;
+
+	try {
+		uint8_t end = 0x66; // end of sound data, overwritten by the next write
+		file.write(&end, 1);
+		writeHeader();
+		file.flush();
+	} catch (MSXException& e) {
+		stopLogging(e);
+	}
+}
+
+void VGMWriter::stopLogging(const MSXException& e)
+{
+	// Called from within the emulation of a sound chip, so don't throw.
+	failed = true;
+	buffer.clear();
+	cliComm.printWarning("Stopped logging sound chip registers to ",
+	                     file.getURL(), ": ", e.getMessage());
+}
+
+void VGMWriter::writeHeader()
+{
+	uint8_t header[HEADER_SIZE] = {};
+	memcpy(header, "Vgm ", 4);
+	Endian::write_UA_L32(&header[0x04], HEADER_SIZE + bytes + 1 - 0x04); // EOF offset
+	Endian::write_UA_L32(&header[0x08], 0x171); // version 1.71
+	Endian::write_UA_L32(&header[0x18], samples);
+	Endian::write_UA_L16(&header[0x28], 0x0003); // SN76489 feedback
+	header[0x2A] = 15;                           // SN76489 shift register width
+	Endian::write_UA_L32(&header[0x34], HEADER_SIZE - 0x34); // data offset
+	header[0x78] = 0x00; // AY8910 type: AY-3-8910A
+	header[0x79] = 0x01; // AY8910 flags: legacy output
+	for (unsigned chip = 0; chip < NUM_CHIPS; ++chip) {
+		if (!devices[chip][0]) continue;
+		uint32_t c = clocks[chip];
+		if (devices[chip][1])                 c |= 0x40000000; // dual chip
+		if ((chip == K051649) && sccPlus)     c |= 0x80000000; // K052539
+		auto* p = &header[clockOffsets[chip]];
+		Endian::write_UA_L32(p, Endian::read_UA_L32(p) | c);
+	}
+	file.seek(0);
+	file.write(header, sizeof(header));
+}
+
+} // namespace openmsx
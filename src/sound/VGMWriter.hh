@@ -0,0 +1,93 @@
+#ifndef VGMWRITER_HH
+#define VGMWRITER_HH
+
+#include "File.hh"
+#include "Clock.hh"
+#include "EmuTime.hh"
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace openmsx {
+
+class CliComm;
+class Filename;
+class MSXException;
+class SoundDevice;
+
+/** Writes the register writes of sound chips to a VGM file.
+  *
+  * VGM is a widely supported format to log the register writes of sound
+  * chips, timestamped with a resolution of 44100Hz. Only chips that are
+  * supported by the VGM format (version 1.71) can be logged. Per chip type
+  * at most two instances are logged (VGM 'dual chip' support), writes to
+  * further instances are ignored.
+  *
+  * Only the register writes are logged. So the state of the chips when
+  * logging starts and the content of sample ROMs (e.g. MoonSound) are not
+  * part of the log.
+  *
+  * Errors while writing (e.g. disk full) don't propagate to the emulated
+  * sound chips. Instead a warning is printed and logging stops.
+  */
+class VGMWriter
+{
+public:
+	enum Chip {
+		SN76489,
+		YM2413,
+		YM2151,
+		Y8950,
+		YMF262,
+		YMF278B_FM,   // FM part of YMF278B, VGM port 0 and 1
+		YMF278B_WAVE, // wave part of YMF278B, VGM port 2
+		AY8910,
+		K051649,      // SCC, VGM port 4 is the K052539 (SCC+) waveform
+		NUM_CHIPS
+	};
+
+	VGMWriter(const Filename& filename, EmuTime::param time, CliComm& cliComm);
+	~VGMWriter();
+
+	/** Log a register write.
+	  * @param device The sound device that is written, used to distinguish
+	  *               multiple instances of the same chip.
+	  * @param chip The type of the chip.
+	  * @param port The VGM port number, only used for chips that have more
+	  *             than one register bank (YMF262, YMF278B and K051649).
+	  * @param reg The register number.
+	  * @param value The value that is written.
+	  * @param time The moment of the write, must be increasing.
+	  */
+	void write(const SoundDevice& device, Chip chip, unsigned port,
+	           unsigned reg, unsigned value, EmuTime::param time);
+
+	/** Flush data to file and update header. Try to make (possibly)
+	  * incomplete file already usable for external programs.
+	  * @param time Logged duration is extended up to this moment.
+	  */
+	void flush(EmuTime::param time);
+
+private:
+	void writeWait(EmuTime::param time);
+	void writeData(std::initializer_list<uint8_t> data);
+	void writeBuffer();
+	void writeHeader();
+	void stopLogging(const MSXException& e);
+
+	File file;
+	CliComm& cliComm;
+	Clock<44100> clock; // time of the last logged sample
+	uint32_t samples;   // total number of logged samples
+	uint32_t bytes;     // size of the command stream (excluding header)
+	std::vector<uint8_t> buffer;
+
+	// First two instances of each chip type.
+	std::array<std::array<const SoundDevice*, 2>, NUM_CHIPS> devices;
+	bool sccPlus;
+	bool failed; // a write error occurred, logging stopped
+};
+
+} // namespace openmsx
+
+#endif
@@ -18,6 +18,22 @@ class WavData
 	};
 
 public:
+	/** Format of the sample data in a .wav file. */
+	struct Format {
+		size_t dataOffset; // start of the sample data in the file
+		unsigned freq;
+		unsigned channels;
+		unsigned bits;     // 8 or 16
+		unsigned length;   // number of samples (per channel)
+	};
+	/** Parse and check the header of a .wav file.
+	  * @throws MSXException when the file is invalid or unsupported. */
+	static Format parseHeader(span<uint8_t> raw);
+
+	/** Convert sample 'i' (only the first channel) to 16-bit signed. */
+	static int16_t convertSample(span<uint8_t> raw, const Format& format,
+	                             unsigned i);
+
 	/** Construct empty wav. */
 	WavData() = default;
 
@@ -56,11 +72,9 @@ inline const T* WavData::read(span<uint8_t> raw, size_t offset, size_t count)
 	return reinterpret_cast<const T*>(raw.data() + offset);
 }
 
-template<typename Filter>
-inline WavData::WavData(File file, Filter filter)
+inline WavData::Format WavData::parseHeader(span<uint8_t> raw)
 {
 	// Read and check header
-	auto raw = file.mmap();
 	struct WavHeader {
 		char riffID[4];
 		Endian::L32 riffSize;
@@ -84,8 +98,13 @@ inline WavData::WavData(File file, Filter filter)
 	if ((header->wFormatTag != 1) || ((bits != 8) && (bits != 16))) {
 		throw MSXException("WAV format unsupported, must be 8 or 16 bit PCM.");
 	}
-	freq = header->dwSamplesPerSec;
-	unsigned channels = header->wChannels;
+	Format format;
+	format.bits = bits;
+	format.freq = header->dwSamplesPerSec;
+	format.channels = header->wChannels;
+	if (format.channels == 0) {
+		throw MSXException("Invalid WAV file.");
+	}
 
 	// Skip any extra format bytes
 	size_t pos = 20 + header->fmtSize;
@@ -105,22 +124,39 @@ inline WavData::WavData(File file, Filter filter)
 		pos += dataHeader->chunkSize;
 	}
 
+	format.dataOffset = pos;
+	format.length = dataHeader->chunkSize / ((bits / 8) * format.channels);
+	// check that all sample data is present
+	read<uint8_t>(raw, pos, size_t(format.length) * (bits / 8) * format.channels);
+	return format;
+}
+
+inline int16_t WavData::convertSample(
+	span<uint8_t> raw, const Format& format, unsigned i)
+{
+	// discard all but the first channel
+	size_t idx = size_t(i) * format.channels;
+	const uint8_t* data = raw.data() + format.dataOffset;
+	if (format.bits == 8) {
+		return int16_t((int16_t(data[idx]) - 0x80) << 8);
+	} else {
+		return int16_t(reinterpret_cast<const Endian::L16*>(data)[idx]);
+	}
+}
+
+template<typename Filter>
+inline WavData::WavData(File file, Filter filter)
+{
+	auto raw = file.mmap();
+	auto format = parseHeader(raw);
+	freq = format.freq;
+	length = format.length;
+
 	// Read and convert sample data
-	length = dataHeader->chunkSize / ((bits / 8) * channels);
 	buffer.resize(length);
 	filter.setFreq(freq);
-	auto convertLoop = [&](const auto* in, auto convertFunc) {
-		for (unsigned i = 0; i < length; ++i) {
-			buffer[i] = filter(convertFunc(*in));
-			in += channels; // discard all but the first channel
-		}
-	};
-	if (bits == 8) {
-		convertLoop(read<uint8_t>(raw, pos, length * channels),
-		            [](uint8_t u8) { return (int16_t(u8) - 0x80) << 8; });
-	} else {
-		convertLoop(read<Endian::L16>(raw, pos, length * channels),
-		            [](Endian::L16 s16) { return int16_t(s16); });
+	for (unsigned i = 0; i < length; ++i) {
+		buffer[i] = filter(convertSample(raw, format, i));
 	}
 }
 
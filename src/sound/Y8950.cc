@@ -944,6 +944,7 @@ void Y8950::writeReg(byte rg, byte data, EmuTime::param time)
 		// update the output buffer before changing the register
 		updateStream(time);
 	//}
+	logRegister(VGMWriter::Y8950, 0, rg, data, time);
 
 	switch (rg & 0xe0) {
 	case 0x00: {
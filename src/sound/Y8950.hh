@@ -20,7 +20,7 @@ class MSXAudio;
 class DeviceConfig;
 class Y8950Periphery;
 
-class Y8950 final : private ResampledSoundDevice, private EmuTimerCallback
+class Y8950 final : public ResampledSoundDevice, private EmuTimerCallback
 {
 public:
 	static constexpr int CLOCK_FREQ     = 3579545;
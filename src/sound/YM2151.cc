@@ -617,6 +617,7 @@ void YM2151::refreshEG(YM2151Operator* op)
 void YM2151::writeReg(byte r, byte v, EmuTime::param time)
 {
 	updateStream(time);
+	logRegister(VGMWriter::YM2151, 0, r, v, time);
 
 	YM2151Operator* op = &oper[(r & 0x07) * 4 + ((r & 0x18) >> 3)];
 
@@ -66,6 +66,7 @@ void YM2413::reset(EmuTime::param time)
 void YM2413::writeReg(byte reg, byte value, EmuTime::param time)
 {
 	updateStream(time);
+	logRegister(VGMWriter::YM2413, 0, reg, value, time);
 	core->writeReg(reg, value);
 }
 
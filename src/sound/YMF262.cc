@@ -1064,6 +1064,8 @@ void YMF262::writeReg(unsigned r, byte v, EmuTime::param time)
 void YMF262::writeReg512(unsigned r, byte v, EmuTime::param time)
 {
 	updateStream(time); // TODO optimize only for regs that directly influence sound
+	logRegister(isYMF278 ? VGMWriter::YMF278B_FM : VGMWriter::YMF262,
+	            r >> 8, r & 0xFF, v, time);
 	writeRegDirect(r, v, time);
 }
 void YMF262::writeRegDirect(unsigned r, byte v, EmuTime::param time)
@@ -16,7 +16,7 @@ namespace openmsx {
 
 class DeviceConfig;
 
-class YMF262 final : private ResampledSoundDevice, private EmuTimerCallback
+class YMF262 final : public ResampledSoundDevice, private EmuTimerCallback
 {
 public:
 	YMF262(const std::string& name, const DeviceConfig& config,
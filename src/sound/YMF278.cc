@@ -250,7 +250,9 @@ int YMF278::Slot::compute_rate(int val) const
 	return Math::clip<0, 63>(res);
 }
 
-int YMF278::Slot::compute_decay_rate(int val) const
+// Adjust the rate of the decay/sustain/release phases for damping and
+// pseudo-reverb. 'rate' is the result of compute_rate() for D1R/D2R/RR.
+int YMF278::Slot::adjust_decay_rate(int rate) const
 {
 	if (DAMP) {
 		// damping
@@ -285,7 +287,7 @@ int YMF278::Slot::compute_decay_rate(int val) const
 			return 20;
 		}
 	}
-	return compute_rate(val);
+	return rate;
 }
 
 int16_t YMF278::Slot::compute_vib() const
@@ -319,138 +321,166 @@ uint16_t YMF278::Slot::compute_am() const
 }
 
 
-void YMF278::advance()
+// Volume interpolation, called once per sample while TL != TLdest.
+inline void YMF278::Slot::interpolate_tl(unsigned cnt)
 {
-	eg_cnt++;
-
 	// modulo counters for volume interpolation
-	int tl_int_cnt  =  eg_cnt % 9;      // 0 .. 8
-	int tl_int_step = (eg_cnt / 9) % 3; // 0 .. 2
-
-	for (auto& op : slots) {
-		// volume interpolation
-		if (tl_int_cnt == 0) {
-			if (tl_int_step == 0) {
-				// decrease volume by one step every 27 samples
-				if (op.TL < op.TLdest) ++op.TL;
-			} else {
-				// increase volume by one step every 13.5 samples
-				if (op.TL > op.TLdest) --op.TL;
-			}
+	if ((cnt % 9) == 0) {
+		if (((cnt / 9) % 3) == 0) {
+			// decrease volume by one step every 27 samples
+			if (TL < TLdest) ++TL;
+		} else {
+			// increase volume by one step every 13.5 samples
+			if (TL > TLdest) --TL;
 		}
+	}
+}
 
-		if (op.lfo_active) {
-			op.lfo_cnt = (op.lfo_cnt + lfo_period[op.lfo]) & (LFO_PERIOD - 1);
-		}
+// Advance this slot by one sample. 'cnt' is the (already incremented) global
+// envelope generator counter and 'rates' are the precalculated rates (see
+// compute_rate()) for each envelope phase.
+inline void YMF278::Slot::advance(unsigned cnt, const uint8_t* rates)
+{
+	if (TL != TLdest) interpolate_tl(cnt);
 
-		// Envelope Generator
-		switch (op.state) {
-		case EG_ATT: { // attack phase
-			uint8_t rate = op.compute_rate(op.AR);
-			// Verified by HW recording (and matches Nemesis' tests of the YM2612):
-			// AR = 0xF during KeyOn results in instant switch to EG_DEC. (see keyOnHelper)
-			// Setting AR = 0xF while the attack phase is in progress freezes the envelope.
-			if (rate >= 63) {
-				break;
-			}
-			uint8_t shift = eg_rate_shift[rate];
-			if (!(eg_cnt & ((1 << shift) - 1))) {
-				uint8_t select = eg_rate_select[rate];
-				// >>4 makes the attack phase's shape match the actual chip -Valley Bell
-				op.env_vol += (~op.env_vol * eg_inc[select + ((eg_cnt >> shift) & 7)]) >> 4;
-				if (op.env_vol <= MIN_ATT_INDEX) {
-					op.env_vol = MIN_ATT_INDEX;
-					// TODO does the real HW skip EG_DEC completely,
-					//      or is it active for 1 sample?
-					op.state = op.DL ? EG_DEC : EG_SUS;
-				}
-			}
+	if (lfo_active) {
+		lfo_cnt = (lfo_cnt + lfo_period[lfo]) & (LFO_PERIOD - 1);
+	}
+
+	// Envelope Generator
+	switch (state) {
+	case EG_ATT: { // attack phase
+		uint8_t rate = rates[EG_ATT];
+		// Verified by HW recording (and matches Nemesis' tests of the YM2612):
+		// AR = 0xF during KeyOn results in instant switch to EG_DEC. (see keyOnHelper)
+		// Setting AR = 0xF while the attack phase is in progress freezes the envelope.
+		if (rate >= 63) {
 			break;
 		}
-		case EG_DEC: { // decay phase
-			uint8_t rate = op.compute_decay_rate(op.D1R);
-			uint8_t shift = eg_rate_shift[rate];
-			if (!(eg_cnt & ((1 << shift) - 1))) {
-				uint8_t select = eg_rate_select[rate];
-				op.env_vol += eg_inc[select + ((eg_cnt >> shift) & 7)];
-				if (op.env_vol >= op.DL) {
-					op.state = (op.env_vol < MAX_ATT_INDEX) ? EG_SUS : EG_OFF;
-				}
+		uint8_t shift = eg_rate_shift[rate];
+		if (!(cnt & ((1 << shift) - 1))) {
+			uint8_t select = eg_rate_select[rate];
+			// >>4 makes the attack phase's shape match the actual chip -Valley Bell
+			env_vol += (~env_vol * eg_inc[select + ((cnt >> shift) & 7)]) >> 4;
+			if (env_vol <= MIN_ATT_INDEX) {
+				env_vol = MIN_ATT_INDEX;
+				// TODO does the real HW skip EG_DEC completely,
+				//      or is it active for 1 sample?
+				state = DL ? EG_DEC : EG_SUS;
 			}
-			break;
 		}
-		case EG_SUS: { // sustain phase
-			uint8_t rate = op.compute_decay_rate(op.D2R);
-			uint8_t shift = eg_rate_shift[rate];
-			if (!(eg_cnt & ((1 << shift) - 1))) {
-				uint8_t select = eg_rate_select[rate];
-				op.env_vol += eg_inc[select + ((eg_cnt >> shift) & 7)];
-				if (op.env_vol >= MAX_ATT_INDEX) {
-					op.env_vol = MAX_ATT_INDEX;
-					op.state = EG_OFF;
-				}
+		break;
+	}
+	case EG_DEC: { // decay phase
+		uint8_t rate = adjust_decay_rate(rates[EG_DEC]);
+		uint8_t shift = eg_rate_shift[rate];
+		if (!(cnt & ((1 << shift) - 1))) {
+			uint8_t select = eg_rate_select[rate];
+			env_vol += eg_inc[select + ((cnt >> shift) & 7)];
+			if (env_vol >= DL) {
+				state = (env_vol < MAX_ATT_INDEX) ? EG_SUS : EG_OFF;
 			}
-			break;
 		}
-		case EG_REL: { // release phase
-			uint8_t rate = op.compute_decay_rate(op.RR);
-			uint8_t shift = eg_rate_shift[rate];
-			if (!(eg_cnt & ((1 << shift) - 1))) {
-				uint8_t select = eg_rate_select[rate];
-				op.env_vol += eg_inc[select + ((eg_cnt >> shift) & 7)];
-				if (op.env_vol >= MAX_ATT_INDEX) {
-					op.env_vol = MAX_ATT_INDEX;
-					op.state = EG_OFF;
-				}
+		break;
+	}
+	case EG_SUS:   // sustain phase
+	case EG_REL: { // release phase
+		uint8_t rate = adjust_decay_rate(rates[state]);
+		uint8_t shift = eg_rate_shift[rate];
+		if (!(cnt & ((1 << shift) - 1))) {
+			uint8_t select = eg_rate_select[rate];
+			env_vol += eg_inc[select + ((cnt >> shift) & 7)];
+			if (env_vol >= MAX_ATT_INDEX) {
+				env_vol = MAX_ATT_INDEX;
+				state = EG_OFF;
 			}
-			break;
 		}
-		case EG_OFF:
-			// nothing
-			break;
+		break;
+	}
+	case EG_OFF:
+		// nothing
+		break;
 
-		default:
-			UNREACHABLE;
-		}
+	default:
+		UNREACHABLE;
 	}
 }
 
-int16_t YMF278::getSample(Slot& op)
+// Advance a slot that is (or became) inactive by 'num' samples. Only the
+// volume interpolation and the LFO still make progress.
+void YMF278::Slot::advance_idle(unsigned cnt, unsigned num)
 {
-	// TODO How does this behave when R#2 bit 0 = 1?
-	//      As-if read returns 0xff? (Like for CPU memory reads.) Or is
-	//      sound generation blocked at some higher level?
-	int16_t sample;
-	switch (op.bits) {
-	case 0: {
-		// 8 bit
-		sample = readMem(op.startaddr + op.pos) << 8;
-		break;
+	assert(state == EG_OFF);
+	if (lfo_active) {
+		lfo_cnt = (lfo_cnt + num * lfo_period[lfo]) & (LFO_PERIOD - 1);
+	}
+	for (unsigned i = 1; (i <= num) && (TL != TLdest); ++i) {
+		interpolate_tl(cnt + i);
 	}
-	case 1: {
-		// 12 bit
-		unsigned addr = op.startaddr + ((op.pos / 2) * 3);
-		if (op.pos & 1) {
-			sample = (readMem(addr + 2) << 8) |
-				 ((readMem(addr + 1) << 4) & 0xF0);
+}
+
+// Read the sample at position 'pos' (relative to the start of the sample
+// data). 'read' returns the memory content at a given offset (again relative
+// to the start of the sample data).
+template<typename Read>
+static int16_t readSample(uint8_t bits, uint16_t pos, Read read)
+{
+	switch (bits) {
+	case 0: // 8 bit
+		return read(pos) << 8;
+	case 1: { // 12 bit
+		unsigned addr = (pos / 2) * 3;
+		if (pos & 1) {
+			return (read(addr + 2) << 8) |
+			       ((read(addr + 1) << 4) & 0xF0);
 		} else {
-			sample = (readMem(addr + 0) << 8) |
-				 (readMem(addr + 1) & 0xF0);
+			return (read(addr + 0) << 8) |
+			       (read(addr + 1) & 0xF0);
 		}
-		break;
 	}
-	case 2: {
-		// 16 bit
-		unsigned addr = op.startaddr + (op.pos * 2);
-		sample = (readMem(addr + 0) << 8) |
-			 (readMem(addr + 1));
-		break;
+	case 2: { // 16 bit
+		unsigned addr = pos * 2;
+		return (read(addr + 0) << 8) |
+		       (read(addr + 1));
 	}
 	default:
 		// TODO unspecified
-		sample = 0;
+		return 0;
 	}
-	return sample;
+}
+
+int16_t YMF278::getSample(const Slot& op) const
+{
+	// TODO How does this behave when R#2 bit 0 = 1?
+	//      As-if read returns 0xff? (Like for CPU memory reads.) Or is
+	//      sound generation blocked at some higher level?
+	return readSample(op.bits, op.pos, [&](unsigned offset) {
+		return readMem(op.startaddr + offset);
+	});
+}
+
+// Returns a pointer to the sample data of the given slot, but only when all
+// positions that can be reached by this slot map to a contiguous block of
+// ROM or RAM. Otherwise returns nullptr, and readMem() must be used to handle
+// wrapping, mirroring and unmapped regions.
+const byte* YMF278::getSampleData(const Slot& op) const
+{
+	// 'pos' is 16 bit, this is the size needed for 65536 samples
+	static constexpr unsigned MAX_SIZE[4] = { 0x10000, 0x18000, 0x20000, 0 };
+	unsigned size = MAX_SIZE[op.bits & 3];
+	if (size == 0) return nullptr;
+	unsigned start = op.startaddr;
+	if ((start + size) <= 0x200000) {
+		return &rom[start];
+	}
+	if ((start >= 0x200000) && !(regs[2] & 2) &&
+	    (ram.getSize() != 640 * 1024)) {
+		unsigned ramStart = start - 0x200000;
+		if ((ramStart + size) <= ram.getSize()) {
+			return &ram[ramStart];
+		}
+	}
+	return nullptr;
 }
 
 bool YMF278::anyActive()
@@ -489,65 +519,105 @@ void YMF278::generateChannels(float** bufs, unsigned num)
 {
 	if (!anyActive()) {
 		// TODO update internal state, even if muted
-		// TODO also mute individual channels
 		for (int i = 0; i < 24; ++i) {
 			bufs[i] = nullptr;
 		}
 		return;
 	}
 
+	// The slots don't influence each other, so instead of calculating one
+	// sample for all slots at a time, calculate all samples for one slot
+	// at a time. This keeps the state of that slot in registers (or at
+	// least in L1) and allows to hoist a lot of calculations out of the
+	// inner loop.
+	for (int i = 0; i < 24; ++i) {
+		auto& sl = slots[i];
+		if (sl.state == EG_OFF) {
+			bufs[i] = nullptr;
+			sl.advance_idle(eg_cnt, num);
+		} else {
+			generateSlot(sl, bufs[i], num);
+		}
+	}
+	eg_cnt += num;
+}
+
+void YMF278::generateSlot(Slot& sl, float* buf, unsigned num)
+{
+	// All of the following stays constant during this batch.
+	uint8_t rates[5];
+	rates[EG_OFF] = 0; // unused
+	rates[EG_REL] = sl.compute_rate(sl.RR);
+	rates[EG_SUS] = sl.compute_rate(sl.D2R);
+	rates[EG_DEC] = sl.compute_rate(sl.D1R);
+	rates[EG_ATT] = sl.compute_rate(sl.AR);
+
+	const byte* data = getSampleData(sl);
+
+	// Panning is also done separately. (low-volume TL + low-volume panning goes below -60dB)
+	// I'll be taking wild guess and assume that -3dB is approximated with 75%. (same as with TL and envelope levels)
+	// The same applies to the PCM mix level.
+	int32_t volLeft  = pan_left [sl.pan]; // note: register 0xF9 is handled externally
+	int32_t volRight = pan_right[sl.pan];
+	// 0 -> 0x20, 8 -> 0x18, 16 -> 0x10, 24 -> 0x0C, etc. (not using vol_factor here saves array boundary checks)
+	volLeft  = (0x20 - (volLeft  & 0x0f)) >> (volLeft  >> 4);
+	volRight = (0x20 - (volRight & 0x0f)) >> (volRight >> 4);
+
+	// The vibrato step only changes 64 times per LFO period, so cache it.
+	bool vibrato = sl.lfo_active && sl.vib;
+	int vibIdx = -1;
+	unsigned vibStep = sl.step;
+
 	for (unsigned j = 0; j < num; ++j) {
-		for (int i = 0; i < 24; ++i) {
-			auto& sl = slots[i];
-			if (sl.state == EG_OFF) {
-				//bufs[i][2 * j + 0] += 0;
-				//bufs[i][2 * j + 1] += 0;
-				continue;
-			}
+		if (sl.state == EG_OFF) {
+			// remaining part of the buffer stays silent
+			sl.advance_idle(eg_cnt + j, num - j);
+			return;
+		}
 
-			int16_t sample = (sl.sample1 * (0x10000 - sl.stepptr) +
-			                  sl.sample2 * sl.stepptr) >> 16;
-			// TL levels are 00..FF internally (TL register value 7F is mapped to TL level FF)
-			// Envelope levels have 4x the resolution (000..3FF)
-			// Volume levels are approximate logarithmic. -6dB result in half volume. Steps in between use linear interpolation.
-			// A volume of -60dB or lower results in silence. (value 0x280..0x3FF).
-			// Recordings from actual hardware indicate that TL level and envelope level are applied separarely.
-			// Each of them is clipped to silence below -60dB, but TL+envelope might result in a lower volume. -Valley Bell
-			uint16_t envVol = std::min(sl.env_vol + ((sl.lfo_active && sl.AM) ? sl.compute_am() : 0),
-			                           MAX_ATT_INDEX);
-			int smplOut = vol_factor(vol_factor(sample, envVol), sl.TL << TL_SHIFT);
-
-			// Panning is also done separately. (low-volume TL + low-volume panning goes below -60dB)
-			// I'll be taking wild guess and assume that -3dB is approximated with 75%. (same as with TL and envelope levels)
-			// The same applies to the PCM mix level.
-			int32_t volLeft  = pan_left [sl.pan]; // note: register 0xF9 is handled externally
-			int32_t volRight = pan_right[sl.pan];
-			// 0 -> 0x20, 8 -> 0x18, 16 -> 0x10, 24 -> 0x0C, etc. (not using vol_factor here saves array boundary checks)
-			volLeft  = (0x20 - (volLeft  & 0x0f)) >> (volLeft  >> 4);
-			volRight = (0x20 - (volRight & 0x0f)) >> (volRight >> 4);
-
-			bufs[i][2 * j + 0] += (smplOut * volLeft ) >> 5;
-			bufs[i][2 * j + 1] += (smplOut * volRight) >> 5;
-
-			unsigned step = (sl.lfo_active && sl.vib)
-			              ? calcStep(sl.OCT, sl.FN, sl.compute_vib())
-			              : sl.step;
-			sl.stepptr += step;
-
-			// If there is a 4-sample loop and you advance 12 samples per step,
-			// it may exceed the end offset.
-			// This is abused by the "Lizard Star" song to generate noise at 0:52. -Valley Bell
-			if (sl.stepptr >= 0x10000) {
-				sl.sample1 = sl.sample2;
-				sl.sample2 = getSample(sl);
-				sl.pos += (sl.stepptr >> 16);
-				sl.stepptr &= 0xffff;
-				if ((uint32_t(sl.pos) + sl.endaddr) >= 0x10000) { // check position >= (negated) end address
-					sl.pos += sl.endaddr + sl.loopaddr; // This is how the actual chip does it.
-				}
+		int16_t sample = (sl.sample1 * (0x10000 - sl.stepptr) +
+		                  sl.sample2 * sl.stepptr) >> 16;
+		// TL levels are 00..FF internally (TL register value 7F is mapped to TL level FF)
+		// Envelope levels have 4x the resolution (000..3FF)
+		// Volume levels are approximate logarithmic. -6dB result in half volume. Steps in between use linear interpolation.
+		// A volume of -60dB or lower results in silence. (value 0x280..0x3FF).
+		// Recordings from actual hardware indicate that TL level and envelope level are applied separarely.
+		// Each of them is clipped to silence below -60dB, but TL+envelope might result in a lower volume. -Valley Bell
+		uint16_t envVol = std::min(sl.env_vol + ((sl.lfo_active && sl.AM) ? sl.compute_am() : 0),
+		                           MAX_ATT_INDEX);
+		int smplOut = vol_factor(vol_factor(sample, envVol), sl.TL << TL_SHIFT);
+
+		buf[2 * j + 0] += (smplOut * volLeft ) >> 5;
+		buf[2 * j + 1] += (smplOut * volRight) >> 5;
+
+		unsigned step = sl.step;
+		if (vibrato) {
+			int idx = sl.lfo_cnt / (LFO_PERIOD / 0x40);
+			if (idx != vibIdx) {
+				vibIdx = idx;
+				vibStep = calcStep(sl.OCT, sl.FN, sl.compute_vib());
+			}
+			step = vibStep;
+		}
+		sl.stepptr += step;
+
+		// If there is a 4-sample loop and you advance 12 samples per step,
+		// it may exceed the end offset.
+		// This is abused by the "Lizard Star" song to generate noise at 0:52. -Valley Bell
+		if (sl.stepptr >= 0x10000) {
+			sl.sample1 = sl.sample2;
+			sl.sample2 = data
+			           ? readSample(sl.bits, sl.pos, [&](unsigned offset) {
+			                     return data[offset];
+			             })
+			           : getSample(sl);
+			sl.pos += (sl.stepptr >> 16);
+			sl.stepptr &= 0xffff;
+			if ((uint32_t(sl.pos) + sl.endaddr) >= 0x10000) { // check position >= (negated) end address
+				sl.pos += sl.endaddr + sl.loopaddr; // This is how the actual chip does it.
 			}
 		}
-		advance();
+		sl.advance(eg_cnt + j + 1, rates);
 	}
 }
 
@@ -561,7 +631,7 @@ void YMF278::keyOnHelper(YMF278::Slot& slot)
 		// Nuke.YKT verified that the FM part does it exactly this way,
 		// and the OPL4 manual says it's instant as well.
 		slot.env_vol = MIN_ATT_INDEX;
-		// see comment in 'case EG_ATT' in YMF278::advance()
+		// see comment in 'case EG_ATT' in YMF278::Slot::advance()
 		slot.state = slot.DL ? EG_DEC : EG_SUS;
 	}
 	slot.stepptr = 0;
@@ -574,6 +644,7 @@ void YMF278::keyOnHelper(YMF278::Slot& slot)
 void YMF278::writeReg(byte reg, byte data, EmuTime::param time)
 {
 	updateStream(time); // TODO optimize only for regs that directly influence sound
+	logRegister(VGMWriter::YMF278B_WAVE, 2, reg, data, time);
 	writeRegDirect(reg, data, time);
 }
 
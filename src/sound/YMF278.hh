@@ -40,11 +40,12 @@ private:
 		Slot();
 		void reset();
 		int compute_rate(int val) const;
-		int compute_decay_rate(int val) const;
-		unsigned decay_rate(int num, int sample_rate);
-		void envelope_next(int sample_rate);
+		int adjust_decay_rate(int rate) const;
 		int16_t compute_vib() const;
 		uint16_t compute_am() const;
+		inline void interpolate_tl(unsigned cnt);
+		inline void advance(unsigned cnt, const uint8_t* rates);
+		void advance_idle(unsigned cnt, unsigned num);
 
 		template<typename Archive>
 		void serialize(Archive& ar, unsigned version);
@@ -92,8 +93,9 @@ private:
 
 	void writeRegDirect(byte reg, byte data, EmuTime::param time);
 	unsigned getRamAddress(unsigned addr) const;
-	int16_t getSample(Slot& op);
-	void advance();
+	void generateSlot(Slot& sl, float* buf, unsigned num);
+	int16_t getSample(const Slot& op) const;
+	const byte* getSampleData(const Slot& op) const;
 	bool anyActive();
 	void keyOnHelper(Slot& slot);
 
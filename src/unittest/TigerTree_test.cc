@@ -2,6 +2,7 @@
 #include "TigerTree.hh"
 #include "tiger.hh"
 #include <cstring>
+#include <vector>
 
 using namespace openmsx;
 
@@ -79,3 +80,30 @@ TEST_CASE("TigerTree")
 		       "SJUYB3QVIJXNKZMSQZGIMHA7GA2MYU2UECDA26A");
 	}
 }
+
+TEST_CASE("TigerTree, many blocks (parallel leaf hashing)")
+{
+	size_t size = 300 * 1024 + 100; // many full blocks + 1 partial block
+	std::vector<uint8_t> buffer(size + 1);
+	for (size_t i = 0; i < size; ++i) {
+		buffer[i + 1] = uint8_t(i * 7 + (i >> 10));
+	}
+	TTTestData data;
+	data.buffer = buffer.data() + 1;
+
+	std::string dummyName;
+	time_t dummyTime = 0;
+	auto dummyCallback = [](size_t, size_t) {};
+
+	TigerTree tt(data, size, dummyName);
+	CHECK(tt.calcHash(dummyCallback).toString() ==
+	      "UKVTPYLUVJSDMFLYS7CBQOWR3TKFTP74ILT7JEI");
+	data.buffer[150000] ^= 0xff;
+	tt.notifyChange(150000, 1, dummyTime); // single block
+	CHECK(tt.calcHash(dummyCallback).toString() ==
+	      "KKARSPZTVMTRWPJPR7CZFZT6GFIVNJF6KDPMTWQ");
+	memset(data.buffer, 0, size);
+	tt.notifyChange(0, size, dummyTime); // all blocks
+	CHECK(tt.calcHash(dummyCallback).toString() ==
+	      "6B3L5T7NAQWPQJMD4HCI7RB4QZU3MUWQKXFNTBA");
+}
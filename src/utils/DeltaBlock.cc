@@ -182,10 +182,10 @@ static std::pair<const uint8_t*, const uint8_t*> scan_match(
 //   n2 number of bytes are different, and here are the bytes
 //   n3 number of bytes are equal
 //   ...
-static vector<uint8_t> calcDelta(const uint8_t* oldBuf, const uint8_t* newBuf, size_t size)
+// The result is appended to the given vector.
+static void calcDelta(vector<uint8_t>& result,
+                      const uint8_t* oldBuf, const uint8_t* newBuf, size_t size)
 {
-	vector<uint8_t> result;
-
 	auto* p = oldBuf;
 	auto* q = newBuf;
 	auto* p_end = p + size;
@@ -215,9 +215,6 @@ static vector<uint8_t> calcDelta(const uint8_t* oldBuf, const uint8_t* newBuf, s
 
 		if (n3 != 0) storeUleb(result, n3);
 	}
-
-	result.shrink_to_fit();
-	return result;
 }
 
 // Apply a previously calculated 'delta' to 'oldBuf' to get 'newbuf'.
@@ -237,23 +234,35 @@ static void applyDeltaInPlace(uint8_t* buf, size_t size, const uint8_t* delta)
 	}
 }
 
-#if STATISTICS
-
 // class DeltaBlock
 
 DeltaBlock::~DeltaBlock()
 {
+	*totalAllocSize -= allocSize;
+#if STATISTICS
 	globalAllocSize -= allocSize;
 	std::cout << "stat: ~DeltaBlock " << globalAllocSize
 	          << " (-" << allocSize << ")\n";
+#endif
 }
 
+void DeltaBlock::setAllocSize(size_t size)
+{
+	*totalAllocSize += size - allocSize; // (modulo arithmetic) also ok when shrinking
+#if STATISTICS
+	globalAllocSize += size - allocSize;
+	std::cout << "stat: DeltaBlock " << globalAllocSize
+	          << " (" << ptrdiff_t(size - allocSize) << ")\n";
 #endif
+	allocSize = size;
+}
 
 // class DeltaBlockCopy
 
-DeltaBlockCopy::DeltaBlockCopy(const uint8_t* data, size_t size)
-	: block(size)
+DeltaBlockCopy::DeltaBlockCopy(std::shared_ptr<size_t> totalAllocSize_,
+                               const uint8_t* data, size_t size)
+	: DeltaBlock(std::move(totalAllocSize_))
+	, block(size)
 	, compressedSize(0)
 {
 #ifdef DEBUG
@@ -261,12 +270,7 @@ DeltaBlockCopy::DeltaBlockCopy(const uint8_t* data, size_t size)
 #endif
 	memcpy(block.data(), data, size);
 	assert(!compressed());
-#if STATISTICS
-	allocSize = size;
-	globalAllocSize += allocSize;
-	std::cout << "stat: DeltaBlockCopy " << globalAllocSize
-	          << " (+" << allocSize << ")\n";
-#endif
+	setAllocSize(size);
 }
 
 void DeltaBlockCopy::apply(uint8_t* dst, size_t size) const
@@ -285,30 +289,29 @@ void DeltaBlockCopy::compress(size_t size)
 {
 	if (compressed()) return;
 
+	// Compress into a (reused) scratch buffer, and only then allocate a
+	// block of the exact size. Allocating a worst-case sized block and
+	// shrinking it afterwards fragments the heap.
+	static vector<uint8_t> scratch;
 	size_t dstLen = LZ4::compressBound(size);
-	MemBuffer<uint8_t> buf2(dstLen);
-	dstLen = LZ4::compress(block.data(), buf2.data(), int(size));
+	if (scratch.size() < dstLen) scratch.resize(dstLen);
+	dstLen = LZ4::compress(block.data(), scratch.data(), int(size));
 
 	if (dstLen >= size) {
 		// compression isn't beneficial
 		return;
 	}
 	compressedSize = dstLen;
+	MemBuffer<uint8_t> buf2(compressedSize);
+	memcpy(buf2.data(), scratch.data(), compressedSize);
 	block.swap(buf2);
-	block.resize(compressedSize); // shrink to fit
 	assert(compressed());
 #ifdef DEBUG
 	MemBuffer<uint8_t> buf3(size);
 	apply(buf3.data(), size);
 	assert(memcmp(buf3.data(), buf2.data(), size) == 0);
 #endif
-#if STATISTICS
-	int delta = compressedSize - allocSize;
-	allocSize = compressedSize;
-	globalAllocSize += delta;
-	std::cout << "stat: compress " << globalAllocSize
-	          << " (" << delta << ")\n";
-#endif
+	setAllocSize(compressedSize);
 }
 
 const uint8_t* DeltaBlockCopy::getData()
@@ -321,30 +324,22 @@ const uint8_t* DeltaBlockCopy::getData()
 // class DeltaBlockDiff
 
 DeltaBlockDiff::DeltaBlockDiff(
+		std::shared_ptr<size_t> totalAllocSize_,
 		std::shared_ptr<DeltaBlockCopy> prev_,
-		const uint8_t* data, size_t size)
-	: prev(std::move(prev_))
-	, delta(calcDelta(prev->getData(), data, size))
+		size_t deltaSize_)
+	: DeltaBlock(std::move(totalAllocSize_))
+	, prev(std::move(prev_))
+	, deltaSize(deltaSize_)
 {
-#ifdef DEBUG
-	sha1 = SHA1::calc(data, size);
-
-	MemBuffer<uint8_t> buf(size);
-	apply(buf.data(), size);
-	assert(memcmp(buf.data(), data, size) == 0);
-#endif
-#if STATISTICS
-	allocSize = delta.size();
-	globalAllocSize += allocSize;
-	std::cout << "stat: DeltaBlockDiff " << globalAllocSize
-	          << " (+" << allocSize << ")\n";
-#endif
+	// The delta itself is counted with the memory it's stored in, see
+	// LastDeltaBlocks::finishSnapshot().
 }
 
 void DeltaBlockDiff::apply(uint8_t* dst, size_t size) const
 {
+	assert(delta); // LastDeltaBlocks::finishSnapshot() was called
 	prev->apply(dst, size);
-	applyDeltaInPlace(dst, size, delta.data());
+	applyDeltaInPlace(dst, size, delta.get());
 #ifdef DEBUG
 	assert(SHA1::calc(dst, size) == sha1);
 #endif
@@ -352,7 +347,7 @@ void DeltaBlockDiff::apply(uint8_t* dst, size_t size) const
 
 size_t DeltaBlockDiff::getDeltaSize() const
 {
-	return delta.size();
+	return deltaSize;
 }
 
 
@@ -380,7 +375,7 @@ std::shared_ptr<DeltaBlock> LastDeltaBlocks::createNew(
 		}
 		// Heuristic: create a new block when too many small
 		// differences have accumulated.
-		auto b = std::make_shared<DeltaBlockCopy>(data, size);
+		auto b = std::make_shared<DeltaBlockCopy>(totalAllocSize, data, size);
 		it->ref = b;
 		it->last = b;
 		it->accSize = 0;
@@ -388,7 +383,16 @@ std::shared_ptr<DeltaBlock> LastDeltaBlocks::createNew(
 	} else {
 		// Create diff based on earlier reference block.
 		// Reference remains unchanged.
-		auto b = std::make_shared<DeltaBlockDiff>(ref, data, size);
+		size_t offset = pendingData.size();
+		calcDelta(pendingData, ref->getData(), data, size);
+		auto b = std::make_shared<DeltaBlockDiff>(
+			totalAllocSize, ref, pendingData.size() - offset);
+#ifdef DEBUG
+		b->sha1 = SHA1::calc(data, size);
+		pendingDiffs.push_back({b, offset, size});
+#else
+		pendingDiffs.push_back({b, offset});
+#endif
 		it->last = b;
 		it->accSize += b->getDeltaSize();
 		return b;
@@ -409,7 +413,7 @@ std::shared_ptr<DeltaBlock> LastDeltaBlocks::createNullDiff(
 
 	auto last = it->last.lock();
 	if (!last) {
-		auto b = std::make_shared<DeltaBlockCopy>(data, size);
+		auto b = std::make_shared<DeltaBlockCopy>(totalAllocSize, data, size);
 		it->ref = b;
 		it->last = b;
 		it->accSize = 0;
@@ -422,8 +426,40 @@ std::shared_ptr<DeltaBlock> LastDeltaBlocks::createNullDiff(
 	}
 }
 
+void LastDeltaBlocks::finishSnapshot()
+{
+	if (pendingDiffs.empty()) return;
+
+	// A block that didn't change in later snapshots is shared with those
+	// (see createNullDiff()), and keeps this whole arena alive. So charge
+	// the arena itself (once) for as long as it exists, not the parts of
+	// it that the blocks of this snapshot use.
+	auto size = pendingData.size();
+	auto arena = std::shared_ptr<MemBuffer<uint8_t>>(
+		new MemBuffer<uint8_t>(size),
+		[total = totalAllocSize, size](MemBuffer<uint8_t>* p) {
+			*total -= size;
+			delete p;
+		});
+	*totalAllocSize += size;
+	memcpy(arena->data(), pendingData.data(), size);
+	for (auto& p : pendingDiffs) {
+		// shares ownership of the whole arena, points to its own part
+		p.diff->delta = std::shared_ptr<const uint8_t>(arena, arena->data() + p.offset);
+#ifdef DEBUG
+		MemBuffer<uint8_t> buf(p.size);
+		p.diff->apply(buf.data(), p.size); // checks sha1
+#endif
+	}
+	pendingDiffs.clear();
+	pendingData.clear(); // keeps the capacity
+}
+
 void LastDeltaBlocks::clear()
 {
+	// only non-empty when creating a snapshot was aborted
+	pendingDiffs.clear();
+	pendingData.clear();
 	for (const Info& info : infos) {
 		if (auto ref = info.ref.lock()) {
 			ref->compress(info.size);
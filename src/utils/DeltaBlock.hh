@@ -6,6 +6,7 @@
 #include "MemBuffer.hh"
 #include <cstdint>
 #include <memory>
+#include <utility>
 #include <vector>
 #ifdef DEBUG
 #include "sha1.hh"
@@ -16,25 +17,31 @@ namespace openmsx {
 class DeltaBlock
 {
 public:
-#if STATISTICS
 	virtual ~DeltaBlock();
-#else
-	virtual ~DeltaBlock() = default;
-#endif
 	virtual void apply(uint8_t* dst, size_t size) const = 0;
 
+	/** Number of bytes allocated for the data of this block (not
+	  * including the blocks it refers to). Zero for a DeltaBlockDiff,
+	  * its data is counted with the memory of its snapshot.
+	  */
+	[[nodiscard]] size_t getAllocSize() const { return allocSize; }
+
 protected:
-	DeltaBlock() = default;
+	explicit DeltaBlock(std::shared_ptr<size_t> totalAllocSize_)
+		: totalAllocSize(std::move(totalAllocSize_)) {}
+	void setAllocSize(size_t size);
 
 #ifdef DEBUG
 public:
 	Sha1Sum sha1;
 #endif
 
+private:
+	// Sum of the allocSize of all blocks created by one LastDeltaBlocks.
+	std::shared_ptr<size_t> totalAllocSize;
+	size_t allocSize = 0;
 #if STATISTICS
-protected:
 	static inline size_t globalAllocSize = 0;
-	size_t allocSize;
 #endif
 };
 
@@ -42,7 +49,8 @@ protected:
 class DeltaBlockCopy final : public DeltaBlock
 {
 public:
-	DeltaBlockCopy(const uint8_t* data, size_t size);
+	DeltaBlockCopy(std::shared_ptr<size_t> totalAllocSize,
+	               const uint8_t* data, size_t size);
 	void apply(uint8_t* dst, size_t size) const override;
 	void compress(size_t size);
 	[[nodiscard]] const uint8_t* getData();
@@ -58,14 +66,20 @@ private:
 class DeltaBlockDiff final : public DeltaBlock
 {
 public:
-	DeltaBlockDiff(std::shared_ptr<DeltaBlockCopy> prev_,
-	               const uint8_t* data, size_t size);
+	DeltaBlockDiff(std::shared_ptr<size_t> totalAllocSize,
+	               std::shared_ptr<DeltaBlockCopy> prev_,
+	               size_t deltaSize_);
 	void apply(uint8_t* dst, size_t size) const override;
 	[[nodiscard]] size_t getDeltaSize() const;
 
 private:
 	const std::shared_ptr<DeltaBlockCopy> prev;
-	const std::vector<uint8_t> delta; // TODO could be tweaked to use OutputBuffer
+	// Points into memory that's shared with the other blocks of the same
+	// snapshot, filled in by LastDeltaBlocks::finishSnapshot().
+	std::shared_ptr<const uint8_t> delta;
+	const size_t deltaSize;
+
+	friend class LastDeltaBlocks;
 };
 
 
@@ -78,6 +92,28 @@ public:
 		const void* id, const uint8_t* data, size_t size);
 	void clear();
 
+	/** Are there no blocks yet to compare with? Then the next snapshot
+	  * stores all blocks in full.
+	  */
+	[[nodiscard]] bool empty() const { return infos.empty(); }
+
+	/** The data of all DeltaBlockDiff objects that are created for one
+	  * snapshot (typically many small blocks) is stored in one memory
+	  * allocation. That memory is freed at once when the last of those
+	  * blocks is destroyed, typically when the snapshot is dropped. This
+	  * avoids many small allocations and the heap fragmentation they cause
+	  * during long sessions.
+	  * Must be called after all blocks of a snapshot are created, before
+	  * they are used.
+	  */
+	void finishSnapshot();
+
+	/** Total size of all blocks created by this object that are still
+	  * alive (see DeltaBlock::getAllocSize()), plus the memory of the
+	  * snapshots that still holds the data of such blocks.
+	  */
+	[[nodiscard]] size_t getTotalAllocSize() const { return *totalAllocSize; }
+
 private:
 	struct Info {
 		Info(const void* id_, size_t size_)
@@ -90,7 +126,19 @@ private:
 		size_t accSize;
 	};
 
+	struct PendingDiff {
+		std::shared_ptr<DeltaBlockDiff> diff;
+		size_t offset; // in 'pendingData'
+#ifdef DEBUG
+		size_t size;
+#endif
+	};
+
 	std::vector<Info> infos;
+	std::vector<PendingDiff> pendingDiffs;
+	std::vector<uint8_t> pendingData; // reused, so it rarely reallocates
+	// Shared with the blocks, those can outlive this object.
+	std::shared_ptr<size_t> totalAllocSize = std::make_shared<size_t>(0);
 };
 
 } // namespace openmsx
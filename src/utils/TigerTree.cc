@@ -1,8 +1,15 @@
 #include "TigerTree.hh"
 #include "tiger.hh"
+#include "File.hh"
+#include "FileOperations.hh"
+#include "MSXException.hh"
 #include "Math.hh"
 #include "MemBuffer.hh"
+#include "Timer.hh"
+#include <algorithm>
+#include <future>
 #include <map>
+#include <thread>
 #include <cstring>
 #include <cassert>
 
@@ -10,6 +17,19 @@ namespace openmsx {
 
 constexpr size_t BLOCK_SIZE = 1024;
 
+// Only use multiple threads when at least this many leafs must be hashed.
+constexpr size_t MIN_PARALLEL_BLOCKS = 256;
+// Number of leafs that are fetched (and then hashed in parallel) in one go.
+constexpr size_t CHUNK_BLOCKS = 1024;
+// Each block in a chunk buffer is preceded by some room for tiger_leaf().
+constexpr size_t CHUNK_STRIDE = BLOCK_SIZE + 64;
+
+// Don't bother with a cache file for small inputs (e.g. disk images).
+constexpr size_t MIN_PERSIST_SIZE = 16 * 1024 * 1024;
+// Write the cache file of an input at most once per this period (in us),
+// except for the final write when the input is closed.
+constexpr uint64_t MIN_PERSIST_INTERVAL = 60 * 1000000;
+
 struct TTCacheEntry
 {
 	MemBuffer<TigerHash> hash;
@@ -17,12 +37,48 @@ struct TTCacheEntry
 	size_t numNodes;
 	time_t time = -1;
 	size_t numNodesValid;
+	bool persisted = false;    // cache file matches this entry
+	bool persistDirty = false; // changed since loaded from/saved to file
+	uint64_t lastPersist = 0;  // Timer::getTime() of the last save
+	unsigned users = 0;        // number of TigerTree objects
+	std::future<void> saving;  // save in progress (in the background)
+	std::string persistDir;    // location of the cache file, only
+	std::string persistFile;   //   set when it may have one
+};
+
+// Cache file format: this header, the name of the data, the hashes of all
+// nodes and finally the valid flags of all nodes (1 byte per node). All in
+// native endianness (endianCheck detects a mismatch).
+struct PersistentHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t endianCheck;
+	uint64_t dataSize;
+	int64_t time;
+	uint64_t numNodes;
+	uint64_t nameLen;
 };
+constexpr char PERSIST_MAGIC[8] = {'o', 'M', 'S', 'X', '-', 'T', 'T', 'H'};
+constexpr uint32_t PERSIST_VERSION = 1;
+constexpr uint32_t PERSIST_ENDIAN_CHECK = 0x01020304;
 // Typically contains 0 or 1 element, and only rarely 2 or more. But we need
 // the address of existing elements to remain stable when new elements are
 // inserted. So still use std::map instead of std::vector.
 static std::map<std::pair<size_t, std::string>, TTCacheEntry> ttCache;
 
+// A copy of a cache entry, so that it can be written to the cache file
+// in a background thread.
+struct PersistentData
+{
+	std::string dir;
+	std::string filename;
+	PersistentHeader header;
+	std::string name;
+	MemBuffer<TigerHash> hash;
+	MemBuffer<bool> valid;
+};
+
 static size_t calcNumNodes(size_t dataSize)
 {
 	auto numBlocks = (dataSize + BLOCK_SIZE - 1) / BLOCK_SIZE;
@@ -44,25 +100,133 @@ static TTCacheEntry& getCacheEntry(
 	return result;
 }
 
-TigerTree::TigerTree(TTData& data_, size_t dataSize_, const std::string& name)
+static std::string getPersistentDir()
+{
+	return FileOperations::join(FileOperations::getUserDataDir(), "tigertree");
+}
+
+static std::string getPersistentFilename(const std::string& name)
+{
+	TigerHash h;
+	tiger(reinterpret_cast<const uint8_t*>(name.data()), name.size(), h);
+	return FileOperations::join(getPersistentDir(), h.toString());
+}
+
+static bool canPersist(size_t dataSize, const std::string& name, const TTCacheEntry& entry)
+{
+	return !name.empty() && (dataSize >= MIN_PERSIST_SIZE) &&
+	       (entry.time != time_t(-1)) && !entry.persistFile.empty();
+}
+
+static PersistentData getPersistentData(
+	size_t dataSize, const std::string& name, const TTCacheEntry& entry)
+{
+	PersistentData result;
+	result.dir = entry.persistDir;
+	result.filename = entry.persistFile;
+	auto& header = result.header;
+	memcpy(header.magic, PERSIST_MAGIC, sizeof(PERSIST_MAGIC));
+	header.version = PERSIST_VERSION;
+	header.endianCheck = PERSIST_ENDIAN_CHECK;
+	header.dataSize = dataSize;
+	header.time = entry.time;
+	header.numNodes = entry.numNodes;
+	header.nameLen = name.size();
+	result.name = name;
+	result.hash.resize(entry.numNodes);
+	memcpy(result.hash.data(), entry.hash.data(), entry.numNodes * sizeof(TigerHash));
+	result.valid.resize(entry.numNodes);
+	memcpy(result.valid.data(), entry.valid.data(), entry.numNodes * sizeof(bool));
+	return result;
+}
+
+static void writePersistentData(const PersistentData& d)
+{
+	try {
+		FileOperations::mkdirp(d.dir);
+		File file(d.filename, File::TRUNCATE);
+		file.write(&d.header, sizeof(d.header));
+		file.write(d.name.data(), d.name.size());
+		file.write(d.hash.data(), d.header.numNodes * sizeof(TigerHash));
+		file.write(d.valid.data(), d.header.numNodes * sizeof(bool));
+	} catch (MSXException&) {
+		// ignore, the cache file is only an optimization
+	}
+}
+
+// Wait for the background saves that are still in progress when openMSX
+// exits. Defined after 'ttCache', so that it's destroyed before it.
+static struct WaitForSaves
+{
+	~WaitForSaves() {
+		for (auto& [key, entry] : ttCache) {
+			if (entry.saving.valid()) entry.saving.wait();
+		}
+	}
+} waitForSaves;
+
+TigerTree::TigerTree(TTData& data_, size_t dataSize_, const std::string& name_)
 	: data(data_)
 	, dataSize(dataSize_)
+	, name(name_)
 	, entry(getCacheEntry(data, dataSize, name))
 {
+	if (!name.empty() && (dataSize >= MIN_PERSIST_SIZE) && entry.persistFile.empty()) {
+		// (computed only once, the background saves use these too)
+		entry.persistDir = getPersistentDir();
+		entry.persistFile = getPersistentFilename(name);
+	}
+	if ((entry.numNodesValid == 0) && canPersist()) {
+		loadPersistent();
+	}
+	++entry.users;
+}
+
+TigerTree::~TigerTree()
+{
+	// When the data is only temporarily destroyed (e.g. by reverse), the
+	// new TigerTree is created before the old one is destroyed.
+	if ((--entry.users == 0) && entry.persistDirty && canPersist()) {
+		if (entry.saving.valid()) entry.saving.wait();
+		savePersistent();
+	}
 }
 
 const TigerHash& TigerTree::calcHash(const std::function<void(size_t, size_t)>& progressCallback)
 {
-	return calcHash(getTop(), progressCallback);
+	auto top = getTop();
+	if (!entry.valid[top.n]) {
+		entry.persistDirty = true;
+		std::vector<size_t> blocks;
+		collectInvalidLeafs(top, blocks);
+		if (blocks.size() >= MIN_PARALLEL_BLOCKS) {
+			calcLeafHashes(blocks, progressCallback);
+		}
+	}
+	// (remaining) leafs and all internal nodes
+	return calcHash(top, progressCallback);
 }
 
 void TigerTree::notifyChange(size_t offset, size_t len, time_t time)
 {
+	if ((len != 0) || (time != entry.time)) {
+		entry.persistDirty = true;
+	}
 	entry.time = time;
 
 	assert((offset + len) <= dataSize);
 	if (len == 0) return;
 
+	if (entry.persisted) {
+		// The content changed, but the modification time possibly
+		// didn't (it only has a resolution of 1s). Remove the cache
+		// file, so that it can't be wrongly reused if we don't get the
+		// chance to update it.
+		if (entry.saving.valid()) entry.saving.wait();
+		FileOperations::unlink(entry.persistFile);
+		entry.persisted = false;
+	}
+
 	if (entry.valid[getTop().n]) {
 		entry.valid[getTop().n] = false; // set sentinel
 		entry.numNodesValid--;
@@ -117,6 +281,139 @@ const TigerHash& TigerTree::calcHash(Node node, const std::function<void(size_t,
 	return entry.hash[n];
 }
 
+void TigerTree::collectInvalidLeafs(Node node, std::vector<size_t>& blocks) const
+{
+	if (entry.valid[node.n]) return;
+	if (node.n & 1) {
+		collectInvalidLeafs(getLeftChild (node), blocks);
+		collectInvalidLeafs(getRightChild(node), blocks);
+	} else {
+		// partial last block is left for calcHash(Node)
+		size_t b = node.n / 2;
+		if ((dataSize - b * BLOCK_SIZE) >= BLOCK_SIZE) {
+			blocks.push_back(b);
+		}
+	}
+}
+
+void TigerTree::calcLeafHashes(const std::vector<size_t>& blocks, const std::function<void(size_t, size_t)>& progressCallback)
+{
+	auto numThreads = std::clamp(std::thread::hardware_concurrency(), 1u, 16u);
+
+	// Fetching the data (e.g. from a file) is only done from this thread.
+	// While the worker threads hash one chunk, this thread already
+	// fetches the next one.
+	MemBuffer<uint8_t> bufs[2] = {
+		MemBuffer<uint8_t>(CHUNK_BLOCKS * CHUNK_STRIDE),
+		MemBuffer<uint8_t>(CHUNK_BLOCKS * CHUNK_STRIDE),
+	};
+	auto fetch = [&](size_t first, uint8_t* buf) {
+		auto num = std::min(CHUNK_BLOCKS, blocks.size() - first);
+		for (size_t i = 0; i < num; ++i) {
+			auto* d = data.getData(blocks[first + i] * BLOCK_SIZE, BLOCK_SIZE);
+			memcpy(buf + i * CHUNK_STRIDE + 64, d, BLOCK_SIZE);
+		}
+	};
+	auto hash = [&](size_t first, uint8_t* buf, size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i) {
+			tiger_leaf(buf + i * CHUNK_STRIDE + 64,
+			           entry.hash[2 * blocks[first + i]]);
+		}
+	};
+
+	fetch(0, bufs[0].data());
+	unsigned cur = 0;
+	for (size_t first = 0; first < blocks.size(); first += CHUNK_BLOCKS) {
+		auto num = std::min(CHUNK_BLOCKS, blocks.size() - first);
+		auto* buf = bufs[cur].data();
+		{
+			// Note: the destructor of a future returned by std::async
+			// waits for the task. So also when fetch() throws.
+			std::vector<std::future<void>> workers;
+			for (unsigned t = 0; t < numThreads; ++t) {
+				workers.push_back(std::async(std::launch::async, hash,
+					first, buf,
+					(num * t) / numThreads, (num * (t + 1)) / numThreads));
+			}
+			auto next = first + CHUNK_BLOCKS;
+			if (next < blocks.size()) fetch(next, bufs[cur ^ 1].data());
+			for (auto& w : workers) w.get();
+		}
+		cur ^= 1;
+
+		for (size_t i = 0; i < num; ++i) {
+			entry.valid[2 * blocks[first + i]] = true;
+		}
+		entry.numNodesValid += num;
+		if (progressCallback) {
+			progressCallback(entry.numNodesValid, entry.numNodes);
+		}
+	}
+}
+
+bool TigerTree::canPersist() const
+{
+	return openmsx::canPersist(dataSize, name, entry);
+}
+
+void TigerTree::loadPersistent()
+{
+	try {
+		File file(entry.persistFile);
+		PersistentHeader header;
+		file.read(&header, sizeof(header));
+		if ((memcmp(header.magic, PERSIST_MAGIC, sizeof(PERSIST_MAGIC)) != 0) ||
+		    (header.version != PERSIST_VERSION) ||
+		    (header.endianCheck != PERSIST_ENDIAN_CHECK) ||
+		    (header.dataSize != dataSize) ||
+		    (header.time != int64_t(entry.time)) ||
+		    (header.numNodes != entry.numNodes) ||
+		    (header.nameLen != name.size())) {
+			return;
+		}
+		std::string storedName(header.nameLen, '\0');
+		file.read(storedName.data(), header.nameLen);
+		if (storedName != name) return;
+
+		file.read(entry.hash.data(), entry.numNodes * sizeof(TigerHash));
+		file.read(entry.valid.data(), entry.numNodes * sizeof(bool));
+		entry.numNodesValid = std::count(
+			entry.valid.data(), entry.valid.data() + entry.numNodes, true);
+		entry.persisted = true;
+		entry.persistDirty = false;
+	} catch (MSXException&) {
+		// no (usable) cache file, start from scratch
+		memset(entry.valid.data(), 0, entry.numNodes);
+		entry.numNodesValid = 0;
+	}
+}
+
+void TigerTree::persist()
+{
+	if (!entry.persistDirty || !canPersist()) return;
+	if (entry.saving.valid()) {
+		// previous save still in progress
+		if (entry.saving.wait_for(std::chrono::seconds(0)) != std::future_status::ready) return;
+		entry.saving.get();
+	}
+	if ((entry.lastPersist != 0) &&
+	    ((Timer::getTime() - entry.lastPersist) < MIN_PERSIST_INTERVAL)) {
+		// throttled, stays dirty (so it's written when closed at the latest)
+		return;
+	}
+	savePersistent();
+}
+
+void TigerTree::savePersistent()
+{
+	// Only the copy is made in this thread, writing it can take a while.
+	entry.saving = std::async(std::launch::async,
+		[d = getPersistentData(dataSize, name, entry)] { writePersistentData(d); });
+	entry.lastPersist = Timer::getTime();
+	entry.persisted = true;
+	entry.persistDirty = false;
+}
+
 
 // The TigerTree::nodes member variable stores a linearized binary tree. The
 // linearization is done like in this example:
@@ -32,6 +32,7 @@
 #include <cstdint>
 #include <ctime>
 #include <functional>
+#include <vector>
 
 namespace openmsx {
 
@@ -68,6 +69,18 @@ struct TTCacheEntry;
 /** Calculate a tiger-tree-hash.
  * Calculation can be done incrementally, so recalculating the hash after a
  * (small) modification of the input is efficient.
+ *
+ * When many leaf nodes need to be (re)calculated (e.g. the first time the
+ * hash of a large harddisk image is requested) these are hashed in parallel
+ * on multiple threads. The input data is still fetched (only) from the
+ * calling thread.
+ *
+ * For large inputs the (partially) calculated tree is also stored in a
+ * cache file in the user data directory, so that a later openMSX session
+ * can reuse it. Like the in-memory cache, this is keyed by the name, the
+ * size and the modification time of the data. The cache file is written
+ * (in a background thread) when the last TigerTree for the data is
+ * destroyed, e.g. when the image is closed, or earlier via persist().
  */
 class TigerTree
 {
@@ -76,6 +89,9 @@ public:
 	 * of given size.
 	 */
 	TigerTree(TTData& data, size_t dataSize, const std::string& name);
+	TigerTree(const TigerTree&) = delete;
+	TigerTree& operator=(const TigerTree&) = delete;
+	~TigerTree();
 
 	/** Calculate the hash value.
 	 */
@@ -88,6 +104,13 @@ public:
 	 */
 	void notifyChange(size_t offset, size_t len, time_t time);
 
+	/** Write the cache file (if needed) in a background thread, e.g.
+	 * when a savestate is made. At most one write per minute, the final
+	 * state is written anyway when the last TigerTree for this data is
+	 * destroyed.
+	 */
+	void persist();
+
 private:
 	// functions to navigate in binary tree
 	struct Node {
@@ -102,9 +125,16 @@ private:
 	[[nodiscard]] Node getRightChild(Node node) const;
 
 	[[nodiscard]] const TigerHash& calcHash(Node node, const std::function<void(size_t, size_t)>& progressCallback);
+	void collectInvalidLeafs(Node node, std::vector<size_t>& blocks) const;
+	void calcLeafHashes(const std::vector<size_t>& blocks, const std::function<void(size_t, size_t)>& progressCallback);
+
+	[[nodiscard]] bool canPersist() const;
+	void loadPersistent();
+	void savePersistent();
 
 	TTData& data;
 	const size_t dataSize;
+	const std::string name;
 	TTCacheEntry& entry;
 };
 
@@ -29,6 +29,7 @@ TODO:
 #include "EnumSetting.hh"
 #include "TclObject.hh"
 #include "MSXCPU.hh"
+#include "MSXCPUInterface.hh"
 #include "MSXMotherBoard.hh"
 #include "Reactor.hh"
 #include "MSXException.hh"
@@ -211,10 +212,13 @@ VDP::VDP(const DeviceConfig& config)
 	cmdTiming    .attach(*this);
 	tooFastAccess.attach(*this);
 	update(tooFastAccess); // handles both cmdTiming and tooFastAccess
+
+	getCPUInterface().registerFastIO(*this);
 }
 
 VDP::~VDP()
 {
+	getCPUInterface().unregisterFastIO(*this);
 	tooFastAccess.detach(*this);
 	cmdTiming    .detach(*this);
 	display      .detach(*this);
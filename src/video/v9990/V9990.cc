@@ -1,5 +1,6 @@
 #include "V9990.hh"
 #include "Display.hh"
+#include "MSXCPUInterface.hh"
 #include "RendererFactory.hh"
 #include "V9990VRAM.hh"
 #include "V9990CmdEngine.hh"
@@ -102,10 +103,13 @@ V9990::V9990(const DeviceConfig& config)
 
 	powerUp(time);
 	display.attach(*this);
+
+	getCPUInterface().registerFastIO(*this);
 }
 
 V9990::~V9990()
 {
+	getCPUInterface().unregisterFastIO(*this);
 	display.detach(*this);
 }
 